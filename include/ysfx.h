@@ -67,6 +67,7 @@ typedef void (ysfx_log_reporter)(intptr_t userdata, ysfx_log_level level, const
 
 typedef struct ysfx_config_s ysfx_config_t;
 typedef struct ysfx_audio_format_s ysfx_audio_format_t;
+typedef struct ysfx_audio_cache_s ysfx_audio_cache_t;
 
 // create a new configuration
 YSFX_API ysfx_config_t *ysfx_config_new();
@@ -86,11 +87,47 @@ YSFX_API void ysfx_guess_file_roots(ysfx_config_t *config, const char *sourcepat
 YSFX_API void ysfx_register_audio_format(ysfx_config_t *config, ysfx_audio_format_t *afmt);
 // register the builtin audio formats (at least WAV file support)
 YSFX_API void ysfx_register_builtin_audio_formats(ysfx_config_t *config);
-// set the log reporting function
+// set the log reporting function; it can be invoked from multiple threads at once
 YSFX_API void ysfx_set_log_reporter(ysfx_config_t *config, ysfx_log_reporter *reporter);
+// make logging asynchronous, so the reporter is never invoked by the thread which logs
+//     the messages wait in a queue of the given capacity, which does not block or allocate,
+//     and they are reported by `ysfx_drain_logs`, and by a background thread if requested;
+//     a capacity of 0 restores synchronous logging, after reporting the waiting messages.
+//     it must not be called while effects of this configuration are in use.
+YSFX_API void ysfx_set_async_logging(ysfx_config_t *config, uint32_t capacity, bool background);
+// report the messages which are waiting, on the calling thread, and return their number
+YSFX_API uint32_t ysfx_drain_logs(ysfx_config_t *config);
+// get the number of messages which were lost, because the queue was full
+YSFX_API uint64_t ysfx_get_dropped_logs(ysfx_config_t *config);
+// open the files of effects on a background thread, which also reads ahead the
+//     given number of bytes at the start of each file (decoded, for audio files).
+//     `file_open` returns at once, but the file is ready later: until then,
+//     `file_avail` returns -1 and the other functions read nothing. if the file
+//     cannot be opened, `file_avail` returns -2 from then on.
+//     the reads past the part read ahead still access the disk, on the thread
+//     which runs the code.
+//     a size of 0 restores synchronous file access.
+//     it must not be called while effects of this configuration are in use.
+YSFX_API void ysfx_set_file_prefetch(ysfx_config_t *config, uint64_t readahead);
+// wait until the files being opened in the background are ready
+YSFX_API void ysfx_wait_file_prefetch(ysfx_config_t *config);
+// make the effects decode audio files through the cache, which can be shared by multiple configurations;
+//     null disables it. it must not be called while effects of this configuration are in use.
+//     a file missing from the cache is decoded whole by `file_open`, on the thread which runs
+//     the code, unless the files are prefetched (see `ysfx_set_file_prefetch`).
+YSFX_API void ysfx_set_audio_cache(ysfx_config_t *config, ysfx_audio_cache_t *cache);
 // set the callback user data
 YSFX_API void ysfx_set_user_data(ysfx_config_t *config, intptr_t userdata);
 
+// The effects which declare `options:gmem=NAME` share `gmem[]` with the other
+// effects of the process which declare the same name, whatever configuration
+// they use. Effects without this option share the default `gmem[]` of the process.
+//
+// Reads and writes of `gmem[]` are plain memory accesses. An effect running on
+// another thread may observe them late, and in a different order.
+// The functions `atomic_*()` are atomic and sequentially consistent across all
+// effects; use them for the values which publish data to other effects.
+
 // get a string which textually represents the log level
 YSFX_API const char *ysfx_log_level_string(ysfx_log_level level);
 
@@ -188,12 +225,47 @@ typedef enum ysfx_compile_option_e {
     ysfx_compile_no_serialize = 1 << 0,
     // skip compiling the @gfx section
     ysfx_compile_no_gfx = 1 << 1,
+    // reserve the memory in a single region, whose pages are allocated on first use
+    ysfx_compile_ram_arena = 1 << 2,
+    // reserve the memory in a single region, backed by huge pages if the system permits
+    ysfx_compile_ram_huge_pages = 1 << 3,
 } ysfx_compile_option_t;
 
 // compile the previously loaded source
 YSFX_API bool ysfx_compile(ysfx_t *fx, uint32_t compileopts);
 // check whether the effect is compiled
 YSFX_API bool ysfx_is_compiled(ysfx_t *fx);
+// create a copy of the effect, which has the same code and the same current state
+//     the state consists of the variables, the memory, the strings and the slider visibility;
+//     it excludes the open files, the pending MIDI and the graphics.
+//     it must not run concurrently with other uses of the original effect.
+YSFX_API ysfx_t *ysfx_clone(ysfx_t *fx);
+
+// Loading and compiling distinct effects concurrently on different threads is
+// safe, whether or not they share the same configuration. A given effect must
+// not be used by several threads at once, except where documented otherwise.
+//
+// The global state of EEL2 is guarded by process-wide mutexes. Compilation takes
+// one of them briefly, which processing never takes. Processing takes the other
+// when the code touches a block of memory for the first time, so that can wait
+// for the memory allocations of other effects, but not for a compilation; see
+// `ysfx_set_ram_options` to allocate the memory before processing.
+
+typedef struct ysfx_load_request_s {
+    // the effect which receives the code
+    ysfx_t *fx;
+    // the path of the file to load
+    const char *filepath;
+    // the options of the load and of the compilation
+    uint32_t loadopts;
+    uint32_t compileopts;
+    // whether the effect was loaded and compiled, set on return
+    bool success;
+} ysfx_load_request_t;
+
+// load and compile several effects in parallel, using at most the given number of threads (0=automatic)
+//     it returns the number of effects which succeeded
+YSFX_API uint32_t ysfx_load_many(ysfx_load_request_t *requests, uint32_t count, uint32_t max_threads);
 
 // get the block size
 YSFX_API uint32_t ysfx_get_block_size(ysfx_t *fx);
@@ -210,6 +282,78 @@ YSFX_API void ysfx_set_midi_capacity(ysfx_t *fx, uint32_t capacity, bool extensi
 // activate and invoke @init
 YSFX_API void ysfx_init(ysfx_t *fx);
 
+typedef enum ysfx_ram_option_e {
+    // after @init, write to the allocated memory, so its pages are resident
+    ysfx_ram_option_prefault = 1 << 0,
+    // after @init, lock the allocated memory into physical memory; implies prefault
+    ysfx_ram_option_lock = 1 << 1,
+} ysfx_ram_option_t;
+
+// set how the memory is prepared at @init, to keep page faults off the audio thread
+//     `prealloc` is a number of memory slots which @init allocates, like `options:prealloc`
+//     prefault and lock duplicate the memory that a clone shares with its model
+YSFX_API void ysfx_set_ram_options(ysfx_t *fx, uint32_t options, uint32_t prealloc);
+// get the number of memory blocks which processing has allocated, excluding @init
+//     the allocations of @gfx, @serialize and of the host are not counted
+//     the blocks taken from a memory arena are not allocations, and are not counted
+YSFX_API uint64_t ysfx_get_late_ram_allocations(ysfx_t *fx);
+
+typedef struct ysfx_memory_stats_s {
+    // the allocated blocks of the VM memory, in bytes
+    //     it counts the whole blocks, even if some of their pages are shared or not yet touched
+    uint64_t ram;
+    // the contents of the strings, in bytes
+    //     it's measured at @init and on request by the next cycle, excluding the copy used by @gfx
+    uint64_t strings;
+    // the compiled code and its data, in bytes
+    uint64_t code;
+    // the images of the graphics, as of the last run of @gfx, in bytes
+    uint64_t gfx_images;
+    // the MIDI buffers, as of the last cycle of processing, in bytes
+    uint64_t midi;
+    // the number of open files
+    uint32_t num_files;
+    // the sum of the above sizes, in bytes
+    uint64_t total;
+} ysfx_memory_stats_t;
+
+// get the memory used by the effect, excluding what it shares with others (gmem)
+//     it's cheap to call repeatedly, and can run concurrently with processing
+//     (the figures are approximate then), but it must not be called on the audio thread,
+//     as it can wait for the processing to access the list of files
+YSFX_API void ysfx_get_memory_usage(ysfx_t *fx, ysfx_memory_stats_t *stats);
+
+typedef struct ysfx_counters_s {
+    // the runs of @init, whether requested or automatic
+    uint64_t init;
+    // the transport restarts which requested to run @init (see `ext_noinit`)
+    uint64_t transport_restarts;
+    // the runs of @slider
+    uint64_t slider;
+    // the processing cycles
+    uint64_t blocks;
+    // the MIDI events which the effect received, and which it sent
+    uint64_t midi_in;
+    uint64_t midi_out;
+    // the MIDI events which did not fit in the buffers, and were lost
+    uint64_t midi_in_dropped;
+    uint64_t midi_out_dropped;
+    // the most MIDI events which the effect received, or sent, in a cycle
+    uint32_t midi_in_peak;
+    uint32_t midi_out_peak;
+    // the files which are open, and the most which were open at once
+    uint32_t open_files;
+    uint32_t open_files_peak;
+    // the number of files which can be open at once
+    uint32_t open_files_limit;
+    // the files which could not be opened, because there were too many
+    uint64_t file_handle_failures;
+} ysfx_counters_t;
+
+// get the counters of the activity of the effect, since it was created
+//     it's cheap, and can run concurrently with processing
+YSFX_API void ysfx_get_counters(ysfx_t *fx, ysfx_counters_t *counters);
+
 typedef enum ysfx_playback_state_e {
     ysfx_playback_error = 0,
     ysfx_playback_playing = 1,
@@ -298,10 +442,63 @@ typedef struct ysfx_state_s {
 YSFX_API bool ysfx_load_state(ysfx_t *fx, ysfx_state_t *state);
 // save current state; release this object when done
 YSFX_API ysfx_state_t *ysfx_save_state(ysfx_t *fx);
-// release a saved state object
+// save current state into a state object, reusing its memory
+//     the object must be created by this library (not assembled by the caller)
+YSFX_API bool ysfx_save_state_into(ysfx_t *fx, ysfx_state_t *state);
+// release a saved state object, or give it back to its pool
 YSFX_API void ysfx_state_free(ysfx_state_t *state);
 // duplicate a state object
 YSFX_API ysfx_state_t *ysfx_state_dup(ysfx_state_t *state);
+// copy a state into a state object, reusing its memory; the same requirement as `ysfx_save_state_into` applies
+YSFX_API void ysfx_state_copy(ysfx_state_t *dst, ysfx_state_t *src);
+
+// A state pool keeps released state objects with their memory, so they are
+// reused rather than allocated again, such as when switching presets often.
+
+typedef struct ysfx_state_pool_s ysfx_state_pool_t;
+
+// create a pool which keeps up to `capacity` state objects
+YSFX_API ysfx_state_pool_t *ysfx_state_pool_new(uint32_t capacity);
+// delete a pool; the state objects which are taken from it remain valid
+YSFX_API void ysfx_state_pool_free(ysfx_state_pool_t *pool);
+// take an empty state object out of the pool; `ysfx_state_free` gives it back
+YSFX_API ysfx_state_t *ysfx_state_pool_acquire(ysfx_state_pool_t *pool);
+
+typedef struct ysfx_state_range_s {
+    // position in the serialized data
+    size_t offset;
+    // size of the range
+    size_t size;
+    // contents of the range
+    uint8_t *data;
+} ysfx_state_range_t;
+
+typedef struct ysfx_state_delta_s {
+    // size of the serialized data of the state it applies to
+    size_t base_size;
+    // checksum of the serialized data of the state it applies to
+    uint64_t base_checksum;
+    // values of the sliders, which are all present, not only the changed ones
+    ysfx_state_slider_t *sliders;
+    // number of sliders
+    uint32_t slider_count;
+    // size of the serialized data which results
+    size_t data_size;
+    // ranges of the serialized data which differ, in increasing order
+    ysfx_state_range_t *ranges;
+    // number of ranges
+    uint32_t range_count;
+} ysfx_state_delta_t;
+
+// compute the changes from a state to another; release this object when done
+//     the data are compared in chunks of the given size in bytes, or a default if 0;
+//     for undo and autosave, it's cheaper to store than a whole state
+YSFX_API ysfx_state_delta_t *ysfx_state_diff(ysfx_state_t *base, ysfx_state_t *state, uint32_t chunk_size);
+// apply changes to a state, producing the state they were computed from;
+//     null if the base is not the one of the diff, or if the changes do not fit
+YSFX_API ysfx_state_t *ysfx_state_apply_delta(ysfx_state_t *base, ysfx_state_delta_t *delta);
+// release a state delta object
+YSFX_API void ysfx_state_delta_free(ysfx_state_delta_t *delta);
 
 // type of a function which can enumerate VM variables; returning 0 ends the search
 typedef int (ysfx_enum_vars_callback_t)(const char *name, ysfx_real *var, void *userdata);
@@ -309,8 +506,84 @@ typedef int (ysfx_enum_vars_callback_t)(const char *name, ysfx_real *var, void *
 YSFX_API void ysfx_enum_vars(ysfx_t *fx, ysfx_enum_vars_callback_t *callback, void *userdata);
 // find a single variable in the VM
 YSFX_API ysfx_real *ysfx_find_var(ysfx_t *fx, const char *name);
+// find several variables in the VM, storing null for those which do not exist
+//     it returns the number of variables found
+YSFX_API uint32_t ysfx_find_vars(ysfx_t *fx, const char *const *names, ysfx_real **vars, uint32_t count);
 // read a chunk of virtual memory from the VM
 YSFX_API void ysfx_read_vmem(ysfx_t *fx, uint32_t addr, ysfx_real *dest, uint32_t count);
+// write a chunk of virtual memory into the VM, and return the number of values written
+//     it stops writing at the end of the memory of the effect
+YSFX_API uint32_t ysfx_write_vmem(ysfx_t *fx, uint32_t addr, const ysfx_real *src, uint32_t count);
+
+typedef struct ysfx_vmem_span_s {
+    // the address of the first value in the VM
+    uint32_t addr;
+    // the number of values
+    uint32_t count;
+    // the values, or null if the memory is unallocated (the values are zero)
+    const ysfx_real *data;
+} ysfx_vmem_span_t;
+
+// map a chunk of virtual memory from the VM, as a list of contiguous spans
+//     it returns the number of spans, of which it stores at most `max_spans`
+//     the range is cut at the end of the 32-bit address space
+//     the pointers are valid until the effect is freed, compiled, or cloned;
+//     the memory is not synchronized with processing, which may be writing it
+YSFX_API uint32_t ysfx_map_vmem_range(ysfx_t *fx, uint32_t addr, uint32_t count, ysfx_vmem_span_t *spans, uint32_t max_spans);
+
+//------------------------------------------------------------------------------
+// YSFX pool
+
+// A pool keeps a number of clones of an effect ready, for instant creation.
+
+typedef struct ysfx_pool_s ysfx_pool_t;
+
+// create a pool of clones of the effect, and fill it up to capacity; the effect is not retained
+YSFX_API ysfx_pool_t *ysfx_pool_new(ysfx_t *fx, uint32_t capacity);
+// delete a pool and the clones it holds
+YSFX_API void ysfx_pool_free(ysfx_pool_t *pool);
+// create clones until the pool is full, and get how many are available; call it outside of real-time threads
+YSFX_API uint32_t ysfx_pool_fill(ysfx_pool_t *pool);
+// take one of the clones out of the pool, or null if the pool is empty; it must be deleted by `ysfx_free`
+YSFX_API ysfx_t *ysfx_pool_acquire(ysfx_pool_t *pool);
+// get the number of clones which are available
+YSFX_API uint32_t ysfx_pool_get_available(ysfx_pool_t *pool);
+
+//------------------------------------------------------------------------------
+// YSFX snapshot
+
+// A snapshot saves the state of an effect on another thread, so @serialize does
+// not delay processing. It's a copy of the effect, into which the state is
+// captured between cycles, and which runs @serialize afterwards.
+
+typedef struct ysfx_snapshot_s ysfx_snapshot_t;
+
+// create a snapshot of a compiled effect, which must outlive it; it does not capture yet
+//     it compiles a copy of the code, so call it outside of real-time threads,
+//     and not concurrently with processing
+YSFX_API ysfx_snapshot_t *ysfx_snapshot_new(ysfx_t *fx);
+// delete a snapshot
+YSFX_API void ysfx_snapshot_free(ysfx_snapshot_t *snapshot);
+// copy the current state of the effect into the snapshot, without running any code
+//     it must not run concurrently with processing, so call it between cycles.
+//     where the system can tell which pages are written (Linux), the snapshot keeps
+//     its copy of the memory, and a capture copies the pages written since the
+//     previous one, or since `ysfx_snapshot_prepare`; for this, the memory of the
+//     effect is moved into an arena if it's not (see `ysfx_compile_ram_arena`), and
+//     the first write to a page after a capture takes a minor fault, without waiting.
+//     otherwise, the memory is copied whole.
+//     it fails if the effect was compiled again since the creation of the snapshot,
+//     or if its memory is larger than the limit.
+YSFX_API bool ysfx_snapshot_capture(ysfx_snapshot_t *snapshot);
+// copy the pages which the effect wrote since the previous capture, so the next one
+// has only those written afterwards to copy
+//     it can run concurrently with anything on the effect, including processing,
+//     but not with the other functions of the snapshot
+YSFX_API void ysfx_snapshot_prepare(ysfx_snapshot_t *snapshot);
+// set the size of the memory which the snapshot may copy, in bytes; the default is 64 MiB
+YSFX_API void ysfx_snapshot_set_memory_limit(ysfx_snapshot_t *snapshot, uint64_t limit);
+// save the captured state; it can run concurrently with the effect, but not with a capture
+YSFX_API ysfx_state_t *ysfx_snapshot_save_state(ysfx_snapshot_t *snapshot);
 
 //------------------------------------------------------------------------------
 // YSFX graphics
@@ -366,6 +639,22 @@ typedef struct ysfx_audio_format_s {
     uint64_t (*read)(ysfx_audio_reader_t *reader, ysfx_real *samples, uint64_t count);
 } ysfx_audio_format_t;
 
+//------------------------------------------------------------------------------
+// YSFX audio cache
+
+// The effects which open the same audio file share a single decoded copy,
+// if their configurations share a cache. An effect which opens a file while
+// another decodes it does not wait, it reads the file by itself. A file is
+// decoded again if it's modified. The least recently used files are dropped from the cache to keep
+// it within its capacity, and the files larger than it are never cached.
+
+// create a cache of decoded audio files, with a capacity in bytes
+YSFX_API ysfx_audio_cache_t *ysfx_audio_cache_new(uint64_t capacity);
+// release a reference to the cache, and delete it if it was the last
+YSFX_API void ysfx_audio_cache_free(ysfx_audio_cache_t *cache);
+// get the size in bytes of the files in the cache
+YSFX_API uint64_t ysfx_audio_cache_get_size(ysfx_audio_cache_t *cache);
+
 //------------------------------------------------------------------------------
 
 #ifdef __cplusplus
@@ -387,6 +676,11 @@ typedef struct ysfx_audio_format_s {
 YSFX_DEFINE_AUTO_PTR(ysfx_config_u, ysfx_config_t, ysfx_config_free);
 YSFX_DEFINE_AUTO_PTR(ysfx_u, ysfx_t, ysfx_free);
 YSFX_DEFINE_AUTO_PTR(ysfx_state_u, ysfx_state_t, ysfx_state_free);
+YSFX_DEFINE_AUTO_PTR(ysfx_state_pool_u, ysfx_state_pool_t, ysfx_state_pool_free);
+YSFX_DEFINE_AUTO_PTR(ysfx_state_delta_u, ysfx_state_delta_t, ysfx_state_delta_free);
+YSFX_DEFINE_AUTO_PTR(ysfx_pool_u, ysfx_pool_t, ysfx_pool_free);
+YSFX_DEFINE_AUTO_PTR(ysfx_snapshot_u, ysfx_snapshot_t, ysfx_snapshot_free);
+YSFX_DEFINE_AUTO_PTR(ysfx_audio_cache_u, ysfx_audio_cache_t, ysfx_audio_cache_free);
 #endif // defined(__cplusplus) && (__cplusplus >= 201103L || defined(_MSC_VER) && _MSVC_LANG >= 201103L)
 
 //------------------------------------------------------------------------------
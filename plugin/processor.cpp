@@ -20,15 +20,23 @@
 #include "parameter.h"
 #include "info.h"
 #include "utility/rt_semaphore.h"
+#include "utility/lz_codec.h"
 #include "ysfx.h"
+#include <vector>
 #include <atomic>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <cstring>
 
 struct YsfxProcessor::Impl : public juce::AudioProcessorListener {
     YsfxProcessor *m_self = nullptr;
     ysfx_u m_fx;
+    // saves the state without holding the callback lock during @serialize
+    ysfx_snapshot_u m_snapshot;
+    std::mutex m_snapshotMutex;
+    // reuses the memory of the states which pass through the loader
+    ysfx_state_pool_u m_statePool{ysfx_state_pool_new(2)};
     ysfx_time_info_t m_timeInfo{};
     int m_sliderParamOffset = 0;
     std::atomic<bool> m_sliderParametersChanged{false};
@@ -148,7 +156,10 @@ void YsfxProcessor::loadJsfxFile(const juce::String &filePath, ysfx_state_t *ini
 {
     Impl::LoadRequest::Ptr loadRequest{new Impl::LoadRequest};
     loadRequest->filePath = filePath;
-    loadRequest->initialState.reset(ysfx_state_dup(initialState));
+    if (initialState) {
+        loadRequest->initialState.reset(ysfx_state_pool_acquire(m_impl->m_statePool.get()));
+        ysfx_state_copy(loadRequest->initialState.get(), initialState);
+    }
     std::atomic_store(&m_impl->m_loadRequest, loadRequest);
     m_impl->m_background->wakeUp();
     if (!async) {
@@ -171,6 +182,8 @@ void YsfxProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
     ysfx_set_sample_rate(fx, sampleRate);
     ysfx_set_block_size(fx, (uint32_t)samplesPerBlock);
 
+    // fault the memory in here, so that the first cycles don't
+    ysfx_set_ram_options(fx, ysfx_ram_option_prefault, 0);
     ysfx_init(fx);
 }
 
@@ -291,79 +304,224 @@ void YsfxProcessor::changeProgramName(int index, const juce::String &newName)
 }
 
 //==============================================================================
-void YsfxProcessor::getStateInformation(juce::MemoryBlock &destData)
+// The state is a binary chunk, in little-endian order:
+//     "YSFX", version (int32), flags (int32), path (int32 size, UTF-8 bytes),
+//     and if the flags indicate a state:
+//     slider count (int32), sliders (int32 index, double value),
+//     data size (int64), stored size (int64), stored data (raw or compressed)
+//
+// Version 1 was a `juce::ValueTree`, with the data in Base64; it's still read.
+
+static const char stateMagic[4] = {'Y', 'S', 'F', 'X'};
+
+enum {
+    stateVersion = 2,
+    stateHasState = 1 << 0,
+    stateCompressed = 1 << 1,
+    // the data which is smaller is not worth compressing
+    stateMinCompressedSize = 256,
+};
+
+struct SavedState {
+    juce::String path;
+    bool hasState = false;
+    juce::Array<ysfx_state_slider_t> sliders;
+    juce::MemoryBlock data;
+};
+
+static void writeBinaryState(juce::MemoryBlock &destData, const juce::String &path, ysfx_state_t *state)
 {
-    juce::File path;
-    ysfx_state_u state;
+    uint32_t flags = 0;
+    std::vector<uint8_t> compressed;
 
-    {
-        const juce::ScopedLock lock(getCallbackLock());
-        ysfx_t *fx = m_impl->m_fx.get();
-        path = juce::CharPointer_UTF8(ysfx_get_file_path(fx));
-        state.reset(ysfx_save_state(fx));
+    if (state) {
+        flags |= stateHasState;
+        if (state->data_size >= stateMinCompressedSize) {
+            compressed.resize(lz_compress_bound(state->data_size));
+            size_t compressedSize = lz_compress(state->data, state->data_size, compressed.data(), compressed.size());
+            // keep it only if it saves at least an eighth
+            if (compressedSize > 0 && compressedSize < state->data_size - state->data_size / 8) {
+                compressed.resize(compressedSize);
+                flags |= stateCompressed;
+            }
+            else
+                compressed = std::vector<uint8_t>{};
+        }
+    }
+
+    const uint8_t *storedData = state ? state->data : nullptr;
+    size_t storedSize = state ? state->data_size : 0;
+    if (flags & stateCompressed) {
+        storedData = compressed.data();
+        storedSize = compressed.size();
     }
 
-    juce::ValueTree root("ysfx");
-    root.setProperty("version", 1, nullptr);
-    root.setProperty("path", path.getFullPathName(), nullptr);
+    size_t pathSize = path.getNumBytesAsUTF8();
+    size_t sliderCount = state ? state->slider_count : 0;
+
+    juce::MemoryOutputStream stream(destData, false);
+    stream.preallocate(28 + pathSize + sliderCount * 12 + storedSize);
+
+    stream.write(stateMagic, sizeof(stateMagic));
+    stream.writeInt(stateVersion);
+    stream.writeInt((int)flags);
+    stream.writeInt((int)pathSize);
+    if (pathSize > 0)
+        stream.write(path.toRawUTF8(), pathSize);
 
     if (state) {
-        juce::ValueTree stateTree("state");
+        stream.writeInt((int)state->slider_count);
+        for (uint32_t i = 0; i < state->slider_count; ++i) {
+            stream.writeInt((int)state->sliders[i].index);
+            stream.writeDouble(state->sliders[i].value);
+        }
+        stream.writeInt64((juce::int64)state->data_size);
+        stream.writeInt64((juce::int64)storedSize);
+        if (storedSize > 0)
+            stream.write(storedData, storedSize);
+    }
+}
+
+static bool readBinaryState(const void *data, size_t size, SavedState &saved)
+{
+    juce::MemoryInputStream stream(data, size, false);
+
+    stream.skipNextBytes(sizeof(stateMagic));
+    if (stream.readInt() != stateVersion)
+        return false;
 
-        juce::ValueTree sliderTree("sliders");
-        for (uint32_t i = 0; i < state->slider_count; ++i)
-            sliderTree.setProperty(juce::String(state->sliders[i].index), state->sliders[i].value, nullptr);
-        stateTree.addChild(sliderTree, -1, nullptr);
+    uint32_t flags = (uint32_t)stream.readInt();
 
-        stateTree.setProperty("data", juce::Base64::toBase64(state->data, state->data_size), nullptr);
+    int pathSize = stream.readInt();
+    if (pathSize < 0 || pathSize > stream.getNumBytesRemaining())
+        return false;
+    saved.path = juce::String::fromUTF8((const char *)data + stream.getPosition(), pathSize);
+    stream.skipNextBytes(pathSize);
 
-        root.addChild(stateTree, -1, nullptr);
+    saved.hasState = (flags & stateHasState) != 0;
+    if (!saved.hasState)
+        return true;
+
+    int sliderCount = stream.readInt();
+    if (sliderCount < 0 || sliderCount > ysfx_max_sliders)
+        return false;
+    for (int i = 0; i < sliderCount; ++i) {
+        ysfx_state_slider_t item{};
+        int index = stream.readInt();
+        item.value = stream.readDouble();
+        if (index < 0 || index >= ysfx_max_sliders)
+            return false;
+        item.index = (uint32_t)index;
+        saved.sliders.add(item);
     }
 
-    juce::MemoryOutputStream stream(destData, false);
-    root.writeToStream(stream);
+    juce::int64 dataSize = stream.readInt64();
+    juce::int64 storedSize = stream.readInt64();
+    if (storedSize < 0 || storedSize > stream.getNumBytesRemaining())
+        return false;
+    const uint8_t *storedData = (const uint8_t *)data + stream.getPosition();
+
+    if (flags & stateCompressed) {
+        // a byte of input expands to at most 255 bytes of output, in a long match
+        if (dataSize < 0 || dataSize / 256 > storedSize)
+            return false;
+        saved.data.setSize((size_t)dataSize);
+        if (!lz_decompress(storedData, (size_t)storedSize, (uint8_t *)saved.data.getData(), (size_t)dataSize))
+            return false;
+    }
+    else {
+        if (dataSize != storedSize)
+            return false;
+        saved.data.replaceAll(storedData, (size_t)storedSize);
+    }
+
+    return true;
 }
 
-void YsfxProcessor::setStateInformation(const void *data, int sizeInBytes)
+static bool readValueTreeState(const void *data, size_t size, SavedState &saved)
 {
-    juce::File path;
-
-    juce::MemoryInputStream stream(data, (size_t)sizeInBytes, false);
+    juce::MemoryInputStream stream(data, size, false);
     juce::ValueTree root = juce::ValueTree::readFromStream(stream);
 
     if (root.getType().getCharPointer().compare(juce::CharPointer_UTF8("ysfx")) != 0)
-        return;
+        return false;
     if ((int)root.getProperty("version") != 1)
-        return;
+        return false;
 
-    path = root.getProperty("path").toString();
+    saved.path = root.getProperty("path").toString();
 
     juce::ValueTree stateTree = root.getChildWithName("state");
-    if (stateTree != juce::ValueTree{}) {
-        ysfx_state_t state{};
-        juce::Array<ysfx_state_slider_t> sliders;
-        juce::MemoryBlock dataBlock;
-
-        {
-            juce::ValueTree sliderTree = stateTree.getChildWithName("sliders");
-            for (uint32_t i = 0; i < ysfx_max_sliders; ++i) {
-                if (const juce::var *v = sliderTree.getPropertyPointer(juce::String(i))) {
-                    ysfx_state_slider_t item{};
-                    item.index = i;
-                    item.value = (double)*v;
-                    sliders.add(item);
-                }
+    saved.hasState = stateTree != juce::ValueTree{};
+    if (!saved.hasState)
+        return true;
+
+    {
+        juce::ValueTree sliderTree = stateTree.getChildWithName("sliders");
+        for (uint32_t i = 0; i < ysfx_max_sliders; ++i) {
+            if (const juce::var *v = sliderTree.getPropertyPointer(juce::String(i))) {
+                ysfx_state_slider_t item{};
+                item.index = i;
+                item.value = (double)*v;
+                saved.sliders.add(item);
             }
         }
-        {
-            juce::MemoryOutputStream base64Result(dataBlock, false);
-            juce::Base64::convertFromBase64(base64Result, stateTree.getProperty("data").toString());
+    }
+    {
+        juce::MemoryOutputStream base64Result(saved.data, false);
+        juce::Base64::convertFromBase64(base64Result, stateTree.getProperty("data").toString());
+    }
+
+    return true;
+}
+
+//==============================================================================
+void YsfxProcessor::getStateInformation(juce::MemoryBlock &destData)
+{
+    juce::File path;
+    ysfx_state_u state;
+
+    std::lock_guard<std::mutex> snapshotLock(m_impl->m_snapshotMutex);
+    ysfx_snapshot_t *snapshot = m_impl->m_snapshot.get();
+    bool captured = false;
+
+    // most of the memory is copied here, so the capture has little left to do
+    if (snapshot)
+        ysfx_snapshot_prepare(snapshot);
+
+    {
+        const juce::ScopedLock lock(getCallbackLock());
+        ysfx_t *fx = m_impl->m_fx.get();
+        path = juce::CharPointer_UTF8(ysfx_get_file_path(fx));
+        captured = snapshot && ysfx_snapshot_capture(snapshot);
+        if (!captured) {
+            state.reset(ysfx_state_pool_acquire(m_impl->m_statePool.get()));
+            if (!ysfx_save_state_into(fx, state.get()))
+                state.reset();
         }
+    }
+
+    if (captured)
+        state.reset(ysfx_snapshot_save_state(snapshot));
+
+    writeBinaryState(destData, path.getFullPathName(), state.get());
+}
 
-        state.sliders = sliders.data();
-        state.slider_count = (uint32_t)sliders.size();
-        state.data = (uint8_t *)dataBlock.getData();
-        state.data_size = dataBlock.getSize();
+void YsfxProcessor::setStateInformation(const void *data, int sizeInBytes)
+{
+    SavedState saved;
+
+    bool isBinary = sizeInBytes >= (int)sizeof(stateMagic) && memcmp(data, stateMagic, sizeof(stateMagic)) == 0;
+    if (!(isBinary ? readBinaryState(data, (size_t)sizeInBytes, saved) : readValueTreeState(data, (size_t)sizeInBytes, saved)))
+        return;
+
+    juce::File path = saved.path;
+
+    if (saved.hasState) {
+        ysfx_state_t state{};
+        state.sliders = saved.sliders.data();
+        state.slider_count = (uint32_t)saved.sliders.size();
+        state.data = (uint8_t *)saved.data.getData();
+        state.data_size = saved.data.getSize();
         loadJsfxFile(path.getFullPathName(), &state, false);
     }
     else {
@@ -492,9 +650,14 @@ void YsfxProcessor::Impl::Background::run()
     while (m_sema.wait(), m_running.load(std::memory_order_relaxed)) {
         if (LoadRequest::Ptr loadRequest = std::atomic_exchange(&m_impl->m_loadRequest, LoadRequest::Ptr{})) {
             {
+                // the saver takes the snapshot mutex before the callback lock, as this does
+                std::lock_guard<std::mutex> snapshotLock(m_impl->m_snapshotMutex);
                 Suspender sus(*m_impl->m_self);
                 juce::ScopedLock lock(m_impl->m_self->getCallbackLock());
                 //
+                // the previous snapshot stops tracking the memory before the next one starts
+                m_impl->m_snapshot.reset();
+                //
                 ysfx_t *fx = m_impl->m_fx.get();
                 ysfx_config_t *config = ysfx_get_config(fx);
                 ysfx_set_import_root(config, "");
@@ -502,7 +665,7 @@ void YsfxProcessor::Impl::Background::run()
                 ysfx_guess_file_roots(config, loadRequest->filePath.toRawUTF8());
                 //
                 uint32_t loadopts = 0;
-                uint32_t compileopts = 0;
+                uint32_t compileopts = ysfx_compile_ram_arena;
                 ysfx_load_file(fx, loadRequest->filePath.toRawUTF8(), loadopts);
                 ysfx_compile(fx, compileopts);
                 //
@@ -516,6 +679,8 @@ void YsfxProcessor::Impl::Background::run()
                     m_impl->m_self->getYsfxParameter((int)i)->setInfo(*info->sliders[i]);
                 //
                 m_impl->syncSlidersToParameters();
+                //
+                m_impl->m_snapshot.reset(ysfx_snapshot_new(fx));
             }
             std::lock_guard<std::mutex> lock(loadRequest->completionMutex);
             loadRequest->completion = true;
@@ -0,0 +1,214 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "lz_codec.h"
+#include <vector>
+#include <cstring>
+
+namespace {
+
+enum {
+    min_match = 4,
+    max_offset = 65535,
+    hash_bits = 14,
+};
+
+uint32_t read32(const uint8_t *p)
+{
+    uint32_t value;
+    memcpy(&value, p, 4);
+    return value;
+}
+
+uint32_t hash32(uint32_t value)
+{
+    return (value * 2654435761u) >> (32 - hash_bits);
+}
+
+struct writer {
+    uint8_t *dst;
+    size_t capacity;
+    size_t pos;
+
+    bool put(uint8_t byte)
+    {
+        if (pos >= capacity)
+            return false;
+        dst[pos++] = byte;
+        return true;
+    }
+    bool put(const uint8_t *data, size_t size)
+    {
+        if (size > capacity - pos)
+            return false;
+        if (size > 0)
+            memcpy(&dst[pos], data, size);
+        pos += size;
+        return true;
+    }
+    // the continuation of a length which does not fit in its 4 bits
+    bool put_length(size_t length)
+    {
+        for (; length >= 255; length -= 255) {
+            if (!put(255))
+                return false;
+        }
+        return put((uint8_t)length);
+    }
+};
+
+struct reader {
+    const uint8_t *src;
+    size_t size;
+    size_t pos;
+
+    bool get(uint8_t &byte)
+    {
+        if (pos >= size)
+            return false;
+        byte = src[pos++];
+        return true;
+    }
+    bool get_length(size_t &length)
+    {
+        uint8_t byte;
+        do {
+            if (!get(byte))
+                return false;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+};
+
+// a sequence of literals, then a match unless it's the last sequence
+bool put_sequence(writer &out, const uint8_t *literals, size_t literal_count, size_t offset, size_t match_length)
+{
+    size_t match_code = match_length ? (match_length - min_match) : 0;
+    uint8_t token = (uint8_t)(((literal_count < 15) ? literal_count : 15) << 4);
+    token |= (uint8_t)((match_code < 15) ? match_code : 15);
+
+    if (!out.put(token))
+        return false;
+    if (literal_count >= 15 && !out.put_length(literal_count - 15))
+        return false;
+    if (!out.put(literals, literal_count))
+        return false;
+    if (match_length == 0)
+        return true;
+
+    if (!out.put((uint8_t)(offset & 0xff)) || !out.put((uint8_t)(offset >> 8)))
+        return false;
+    if (match_code >= 15 && !out.put_length(match_code - 15))
+        return false;
+    return true;
+}
+
+} // namespace
+
+size_t lz_compress_bound(size_t size)
+{
+    // the worst case is a single sequence of literals
+    return 1 + size / 255 + 1 + size;
+}
+
+size_t lz_compress(const uint8_t *src, size_t size, uint8_t *dst, size_t capacity)
+{
+    writer out{dst, capacity, 0};
+
+    // positions of the last occurrences of 4-byte sequences, by hash
+    std::vector<uint32_t> table((size_t)1 << hash_bits);
+
+    size_t anchor = 0;
+    size_t pos = 0;
+
+    if (size >= min_match && size <= UINT32_MAX) {
+        while (pos + min_match <= size) {
+            uint32_t sequence = read32(&src[pos]);
+            uint32_t &entry = table[hash32(sequence)];
+            size_t candidate = entry;
+            entry = (uint32_t)pos;
+
+            if (candidate >= pos || pos - candidate > max_offset || read32(&src[candidate]) != sequence) {
+                // go faster over the data which does not compress
+                pos += 1 + ((pos - anchor) >> 6);
+                continue;
+            }
+
+            size_t length = min_match;
+            while (pos + length < size && src[candidate + length] == src[pos + length])
+                ++length;
+
+            if (!put_sequence(out, &src[anchor], pos - anchor, pos - candidate, length))
+                return 0;
+
+            pos += length;
+            anchor = pos;
+        }
+    }
+
+    if (!put_sequence(out, &src[anchor], size - anchor, 0, 0))
+        return 0;
+
+    return out.pos;
+}
+
+bool lz_decompress(const uint8_t *src, size_t size, uint8_t *dst, size_t expected_size)
+{
+    reader in{src, size, 0};
+    size_t pos = 0;
+
+    for (;;) {
+        uint8_t token;
+        if (!in.get(token))
+            return false;
+
+        size_t literal_count = token >> 4;
+        if (literal_count == 15 && !in.get_length(literal_count))
+            return false;
+        if (literal_count > size - in.pos || literal_count > expected_size - pos)
+            return false;
+        if (literal_count > 0)
+            memcpy(&dst[pos], &src[in.pos], literal_count);
+        in.pos += literal_count;
+        pos += literal_count;
+
+        // the last sequence has no match
+        if (in.pos == size)
+            return pos == expected_size;
+
+        uint8_t lo, hi;
+        if (!in.get(lo) || !in.get(hi))
+            return false;
+        size_t offset = lo | ((size_t)hi << 8);
+        if (offset == 0 || offset > pos)
+            return false;
+
+        size_t match_length = token & 15;
+        if (match_length == 15 && !in.get_length(match_length))
+            return false;
+        match_length += min_match;
+        if (match_length > expected_size - pos)
+            return false;
+
+        // the source and destination may overlap, which repeats a pattern
+        const uint8_t *match = &dst[pos - offset];
+        for (size_t i = 0; i < match_length; ++i)
+            dst[pos + i] = match[i];
+        pos += match_length;
+    }
+}
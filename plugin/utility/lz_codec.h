@@ -0,0 +1,31 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// A byte-oriented compressor of the LZ77 family, in the manner of the LZ4
+// block format: sequences of literals, each followed by a back-reference of
+// at least 4 bytes within the previous 64 KiB. It favors speed over ratio.
+
+// get the largest size which the compression of the given size can produce
+size_t lz_compress_bound(size_t size);
+// compress, returning the compressed size, or 0 if it exceeds the capacity
+size_t lz_compress(const uint8_t *src, size_t size, uint8_t *dst, size_t capacity);
+// decompress, returning false unless it produces exactly the expected size
+bool lz_decompress(const uint8_t *src, size_t size, uint8_t *dst, size_t expected_size);
@@ -18,13 +18,16 @@
 #include "ysfx.hpp"
 #include "ysfx_config.hpp"
 #include "ysfx_eel_utils.hpp"
+#include "ysfx_state.hpp"
 #include <type_traits>
 #include <algorithm>
 #include <functional>
 #include <deque>
 #include <set>
+#include <thread>
 #include <new>
 #include <stdexcept>
+#include <system_error>
 #include <cstring>
 #include <cassert>
 
@@ -74,6 +77,7 @@ ysfx_t *ysfx_new(ysfx_config_t *config)
     fx->config.reset(config);
 
     fx->string_ctx.reset(ysfx_eel_string_context_new());
+    fx->string_sync.reset(ysfx_string_sync_new());
 
     ysfx_api_initializer::init_once();
 
@@ -83,6 +87,7 @@ ysfx_t *ysfx_new(ysfx_config_t *config)
     fx->vm.reset(vm);
 
     NSEEL_VM_SetCustomFuncThis(vm, fx.get());
+    ysfx_ram_allocator_attach(fx->ram.allocator, vm);
 
     ysfx_eel_string_initvm(vm);
 
@@ -94,8 +99,8 @@ ysfx_t *ysfx_new(ysfx_config_t *config)
         ysfx_t *fx = (ysfx_t *)userdata;
         auto it = fx->source.slider_alias.find(name);
         if (it != fx->source.slider_alias.end())
-            return fx->var.slider[it->second];
-        return nullptr;
+            return &fx->var.slider[it->second];
+        return ysfx_find_slider_var(fx, name);
     };
     NSEEL_VM_set_var_resolver(vm, var_resolver, fx.get());
 
@@ -104,12 +109,6 @@ ysfx_t *ysfx_new(ysfx_config_t *config)
         EEL_F *var = NSEEL_VM_regvar(vm, name.c_str());
         *(fx->var.spl[i] = var) = 0;
     }
-    for (uint32_t i = 0; i < ysfx_max_sliders; ++i) {
-        std::string name = "slider" + std::to_string(i + 1);
-        EEL_F *var = NSEEL_VM_regvar(vm, name.c_str());
-        *(fx->var.slider[i] = var) = 0;
-        fx->slider_of_var[var] = i;
-    }
 
     #define AUTOVAR(name, value) *(fx->var.name = NSEEL_VM_regvar(vm, #name)) = (value)
     AUTOVAR(srate, fx->sample_rate);
@@ -302,7 +301,7 @@ bool ysfx_load_file(ysfx_t *fx, const char *filepath, uint32_t loadopts)
     // initialize the sliders to defaults
 
     for (uint32_t i = 0; i < ysfx_max_sliders; ++i)
-        *fx->var.slider[i] = fx->source.main->header.sliders[i].def;
+        fx->var.slider[i] = fx->source.main->header.sliders[i].def;
 
     //--------------------------------------------------------------------------
 
@@ -312,6 +311,8 @@ bool ysfx_load_file(ysfx_t *fx, const char *filepath, uint32_t loadopts)
 
 bool ysfx_compile(ysfx_t *fx, uint32_t compileopts)
 {
+    // hold the named memory across recompilation, so it's not lost
+    ysfx_gmem_u old_gmem{fx->code.gmem.release()};
     ysfx_unload_code(fx);
 
     if (!fx->source.main) {
@@ -336,7 +337,24 @@ bool ysfx_compile(ysfx_t *fx, uint32_t compileopts)
         if (maxmem > 32 * 1024 * 1024)
             maxmem = 32 * 1024 * 1024;
 
-        NSEEL_VM_setramsize(vm, (int)maxmem);
+        uint32_t num_blocks = (uint32_t)NSEEL_VM_setramsize(vm, (int)maxmem) / NSEEL_RAM_ITEMSPERBLOCK;
+
+        bool huge_pages = (compileopts & ysfx_compile_ram_huge_pages) != 0;
+        bool want_arena = huge_pages || (compileopts & ysfx_compile_ram_arena);
+        ysfx_ram_arena_t &arena = fx->ram.arena;
+
+        if (!want_arena)
+            ysfx_ram_arena_detach(arena, true);
+        else if (arena.size != (uint64_t)num_blocks * NSEEL_RAM_ITEMSPERBLOCK * sizeof(EEL_F)) {
+            if (!ysfx_ram_arena_attach(arena, fx->ram.allocator, num_blocks, huge_pages))
+                ysfx_logf(*fx->config, ysfx_log_warning, "%s: cannot reserve the memory arena", ysfx_get_name(fx));
+        }
+    }
+
+    // without a name, gmem is the default buffer of EEL2, shared by all
+    if (!fx->source.main->header.options.gmem.empty()) {
+        fx->code.gmem.reset(ysfx_gmem_acquire(fx->source.main->header.options.gmem));
+        NSEEL_VM_SetGRAM(vm, &fx->code.gmem->gram);
     }
 
     //--------------------------------------------------------------------------
@@ -403,11 +421,28 @@ bool ysfx_compile(ysfx_t *fx, uint32_t compileopts)
         return false;
 
     fx->code.compiled = true;
+    fx->code.compileopts = compileopts;
+    ysfx_publish_code_memory(fx);
+#if !defined(YSFX_NO_GFX)
+    fx->code.shares_strings = fx->code.gfx != nullptr;
+#endif
     fx->is_freshly_compiled = true;
     fx->must_compute_init = true;
 
     ///
     ysfx_eel_string_context_update_named_vars(fx->string_ctx.get(), vm);
+    if (fx->code.shares_strings)
+        ysfx_string_sync_reset(fx);
+
+    // compilation has created all the variables which the code uses
+    auto index_var = [](const char *name, EEL_F *var, void *userdata) -> int {
+        auto *index = (std::unordered_map<std::string, ysfx_real *> *)userdata;
+        index->emplace(name, var);
+        return 1;
+    };
+    NSEEL_VM_enumallvars(vm, +index_var, &fx->code.var_index);
+
+    ++fx->compile_count;
 
     fail_guard.disarm();
     return true;
@@ -418,6 +453,283 @@ bool ysfx_is_compiled(ysfx_t *fx)
     return fx->code.compiled;
 }
 
+ysfx_t *ysfx_clone(ysfx_t *fx)
+{
+    ysfx_u clone{ysfx_new_sibling(fx)};
+    if (!clone)
+        return nullptr;
+
+    if (fx->code.compiled)
+        ysfx_copy_runtime_state(clone.get(), fx);
+    else if (fx->source.main) {
+        for (uint32_t i = 0; i < ysfx_max_sliders; ++i)
+            clone->var.slider[i] = fx->var.slider[i];
+    }
+
+    return clone.release();
+}
+
+ysfx_t *ysfx_new_sibling(ysfx_t *fx)
+{
+    ysfx_u sibling{ysfx_new(fx->config.get())};
+
+    sibling->block_size = fx->block_size;
+    sibling->sample_rate = fx->sample_rate;
+    sibling->valid_input_channels = fx->valid_input_channels;
+
+    sibling->source = fx->source;
+
+    // the machine code refers to the variables of its own VM by address, so
+    // it must be generated again, but the source is already loaded
+    if (fx->code.compiled) {
+        if (!ysfx_compile(sibling.get(), fx->code.compileopts))
+            return nullptr;
+    }
+
+    return sibling.release();
+}
+
+void ysfx_copy_runtime_state(ysfx_t *dst, ysfx_t *src)
+{
+    assert(dst->code.compiled);
+    assert(src->code.compiled);
+
+    NSEEL_VMCTX dst_vm = dst->vm.get();
+    NSEEL_VMCTX src_vm = src->vm.get();
+
+    // variables
+    auto copy_var = [](const char *name, EEL_F *src_var, void *userdata) -> int {
+        NSEEL_VMCTX dst_vm = (NSEEL_VMCTX)userdata;
+        EEL_F *dst_var = NSEEL_VM_getvar(dst_vm, name);
+        if (dst_var)
+            *dst_var = *src_var;
+        return 1;
+    };
+    NSEEL_VM_enumallvars(src_vm, +copy_var, dst_vm);
+
+    // memory
+    dst->ram.options = src->ram.options;
+    dst->ram.prealloc = src->ram.prealloc;
+    if (!ysfx_share_ram(dst, src))
+        ysfx_eel_ram_copy(dst_vm, src_vm);
+    if (dst->ram.options != 0)
+        ysfx_prepare_ram(dst);
+
+    ysfx_copy_strings_and_sliders(dst, src);
+}
+
+void ysfx_copy_strings_and_sliders(ysfx_t *dst, ysfx_t *src)
+{
+    // strings, as the processing has them; the main side of the exchange with
+    // @gfx belongs to the thread which processes, so the modifications of @gfx
+    // which it has not taken yet reach the source only, on its next cycle
+    ysfx_eel_string_context_copy(dst->string_ctx.get(), src->string_ctx.get());
+    if (dst->code.shares_strings)
+        ysfx_string_sync_reset(dst);
+
+    // sliders
+    memcpy(dst->var.slider, src->var.slider, sizeof(src->var.slider));
+    dst->slider.visible_mask = src->slider.visible_mask;
+    dst->slider.old_visible_mask = src->slider.old_visible_mask;
+
+    dst->is_freshly_compiled = src->is_freshly_compiled;
+    dst->must_compute_init = src->must_compute_init;
+    dst->must_compute_slider = src->must_compute_slider;
+}
+
+bool ysfx_share_ram(ysfx_t *dst, ysfx_t *src)
+{
+    // take an image of the source memory, unless the one taken previously is
+    // still current; then both source and destination map it copy-on-write
+    std::shared_ptr<ysfx_ram_image_t> image = src->ram.image;
+    uint64_t generation = src->ram.generation.load(std::memory_order_relaxed);
+
+    if (!image || src->ram.image_generation != generation) {
+        image.reset(ysfx_ram_image_create(src->vm.get()));
+        if (!image)
+            return false;
+        // the blocks which the view replaces get released
+        ysfx_ram_unlock(src->ram.lock);
+        if (!ysfx_ram_view_attach(src->ram.view, src->vm.get(), *image, &src->ram.arena))
+            return false;
+        ysfx_ram_arena_detach(src->ram.arena, true);
+        src->ram.image = image;
+        src->ram.image_generation = generation;
+        if (src->ram.options != 0)
+            ysfx_prepare_ram(src);
+    }
+
+    ysfx_ram_unlock(dst->ram.lock);
+    if (!ysfx_ram_view_attach(dst->ram.view, dst->vm.get(), *image, &dst->ram.arena))
+        return false;
+    ysfx_ram_arena_detach(dst->ram.arena, true);
+    return true;
+}
+
+void ysfx_ram_modified(ysfx_t *fx)
+{
+    fx->ram.generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ysfx_prepare_ram(ysfx_t *fx)
+{
+    NSEEL_VMCTX vm = fx->vm.get();
+
+    uint32_t prealloc = fx->source.main->header.options.prealloc;
+    if (prealloc < fx->ram.prealloc)
+        prealloc = fx->ram.prealloc;
+    if (prealloc > 0)
+        ysfx_ram_preallocate(vm, prealloc);
+
+    uint32_t options = fx->ram.options;
+    if (options & (ysfx_ram_option_prefault|ysfx_ram_option_lock))
+        ysfx_ram_prefault(vm);
+    if (options & ysfx_ram_option_lock) {
+        if (!ysfx_ram_lock(fx->ram.lock, vm))
+            ysfx_logf(*fx->config, ysfx_log_warning, "%s: cannot lock the memory", ysfx_get_name(fx));
+    }
+}
+
+void ysfx_set_ram_options(ysfx_t *fx, uint32_t options, uint32_t prealloc)
+{
+    fx->ram.options = options;
+    fx->ram.prealloc = prealloc;
+    if (!(options & ysfx_ram_option_lock))
+        ysfx_ram_unlock(fx->ram.lock);
+}
+
+uint64_t ysfx_get_late_ram_allocations(ysfx_t *fx)
+{
+    return fx->ram.allocator.counted_allocations.load(std::memory_order_relaxed);
+}
+
+void ysfx_publish_string_memory(ysfx_t *fx)
+{
+    fx->string_memory.store(ysfx_eel_string_context_memory(fx->string_ctx.get()), std::memory_order_relaxed);
+}
+
+void ysfx_publish_code_memory(ysfx_t *fx)
+{
+    uint64_t memory = 0;
+    auto add_code = [&memory](NSEEL_CODEHANDLE code) {
+        // source bytes, static code bytes, call code bytes, data bytes
+        const int *code_stats = code ? NSEEL_code_getstats(code) : nullptr;
+        if (code_stats)
+            memory += (uint64_t)code_stats[1] + (uint64_t)code_stats[2] + (uint64_t)code_stats[3];
+    };
+    for (const NSEEL_CODEHANDLE_u &code : fx->code.init)
+        add_code(code.get());
+    add_code(fx->code.slider.get());
+    add_code(fx->code.block.get());
+    add_code(fx->code.sample.get());
+    add_code(fx->code.gfx.get());
+    add_code(fx->code.serialize.get());
+    fx->code_memory.store(memory, std::memory_order_relaxed);
+}
+
+void ysfx_publish_midi_memory(ysfx_t *fx)
+{
+    uint64_t memory = fx->midi.in->data.capacity() + fx->midi.out->data.capacity();
+    fx->midi_memory.store(memory, std::memory_order_relaxed);
+}
+
+void ysfx_get_memory_usage(ysfx_t *fx, ysfx_memory_stats_t *stats)
+{
+    *stats = ysfx_memory_stats_t{};
+
+    stats->ram = (uint64_t)fx->ram.allocator.num_blocks.load(std::memory_order_relaxed) * NSEEL_RAM_ITEMSPERBLOCK * sizeof(EEL_F);
+
+    // only the thread which runs the code can read the strings, so it's
+    // requested to measure them on its next cycle
+    fx->string_memory_wanted.store(true, std::memory_order_relaxed);
+    stats->strings = fx->string_memory.load(std::memory_order_relaxed);
+
+    stats->code = fx->code_memory.load(std::memory_order_relaxed);
+
+#if !defined(YSFX_NO_GFX)
+    stats->gfx_images = ysfx_gfx_state_get_image_memory(fx->gfx.state.get());
+#endif
+
+    stats->midi = fx->midi_memory.load(std::memory_order_relaxed);
+
+    {
+        std::lock_guard<ysfx::mutex> lock{fx->file.list_mutex};
+        // the first is the serializer, which is not a file
+        for (size_t i = 1; i < fx->file.list.size(); ++i)
+            stats->num_files += fx->file.list[i] != nullptr;
+    }
+
+    stats->total = stats->ram + stats->strings + stats->code + stats->gfx_images + stats->midi;
+}
+
+void ysfx_get_counters(ysfx_t *fx, ysfx_counters_t *counters)
+{
+    const std::memory_order relaxed = std::memory_order_relaxed;
+
+    counters->init = fx->counters.init.load(relaxed);
+    counters->transport_restarts = fx->counters.transport_restarts.load(relaxed);
+    counters->slider = fx->counters.slider.load(relaxed);
+    counters->blocks = fx->counters.blocks.load(relaxed);
+    counters->midi_in = fx->counters.midi_in.load(relaxed);
+    counters->midi_out = fx->counters.midi_out.load(relaxed);
+    counters->midi_in_dropped = fx->counters.midi_in_dropped.load(relaxed);
+    counters->midi_out_dropped = fx->counters.midi_out_dropped.load(relaxed);
+    counters->midi_in_peak = fx->counters.midi_in_peak.load(relaxed);
+    counters->midi_out_peak = fx->counters.midi_out_peak.load(relaxed);
+    counters->open_files = fx->counters.open_files.load(relaxed);
+    counters->open_files_peak = fx->counters.open_files_peak.load(relaxed);
+    // the first handle is the serializer, which is not a file
+    counters->open_files_limit = ysfx_max_file_handles - 1;
+    counters->file_handle_failures = fx->counters.file_handle_failures.load(relaxed);
+}
+
+uint32_t ysfx_load_many(ysfx_load_request_t *requests, uint32_t count, uint32_t max_threads)
+{
+    if (count == 0)
+        return 0;
+
+    // the API must be initialized before the workers start using it
+    ysfx_api_initializer::init_once();
+
+    std::atomic<uint32_t> next_index{0};
+    std::atomic<uint32_t> num_successes{0};
+
+    auto work = [requests, count, &next_index, &num_successes]() {
+        uint32_t index;
+        while ((index = next_index.fetch_add(1, std::memory_order_relaxed)) < count) {
+            ysfx_load_request_t &req = requests[index];
+            req.success = ysfx_load_file(req.fx, req.filepath, req.loadopts) &&
+                ysfx_compile(req.fx, req.compileopts);
+            if (req.success)
+                num_successes.fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+
+    uint32_t num_threads = max_threads;
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    num_threads = std::min(num_threads, count);
+
+    // the calling thread is one of the workers
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads - 1);
+    for (uint32_t i = 0; i + 1 < num_threads; ++i) {
+        try {
+            threads.emplace_back(work);
+        }
+        catch (const std::system_error &) {
+            break;
+        }
+    }
+
+    work();
+
+    for (std::thread &thread : threads)
+        thread.join();
+
+    return num_successes.load(std::memory_order_relaxed);
+}
+
 void ysfx_unload_source(ysfx_t *fx)
 {
     fx->source = {};
@@ -436,7 +748,9 @@ void ysfx_unload_code(ysfx_t *fx)
     }
 #endif
 
+    NSEEL_VM_SetGRAM(fx->vm.get(), nullptr);
     fx->code = {};
+    ysfx_publish_code_memory(fx);
 
     fx->is_freshly_compiled = false;
     fx->must_compute_init = false;
@@ -752,15 +1066,15 @@ ysfx_real ysfx_slider_get_value(ysfx_t *fx, uint32_t index)
 {
     if (index >= ysfx_max_sliders)
         return 0;
-    return *fx->var.slider[index];
+    return fx->var.slider[index];
 }
 
 void ysfx_slider_set_value(ysfx_t *fx, uint32_t index, ysfx_real value)
 {
     if (index >= ysfx_max_sliders)
         return;
-    if (*fx->var.slider[index] != value) {
-        *fx->var.slider[index] = value;
+    if (fx->var.slider[index] != value) {
+        fx->var.slider[index] = value;
         fx->must_compute_slider = true;
     }
 }
@@ -868,6 +1182,7 @@ void ysfx_set_midi_capacity(ysfx_t *fx, uint32_t capacity, bool extensible)
 {
     ysfx_midi_reserve(fx->midi.in.get(), capacity, extensible);
     ysfx_midi_reserve(fx->midi.out.get(), capacity, extensible);
+    ysfx_publish_midi_memory(fx);
 }
 
 void ysfx_init(ysfx_t *fx)
@@ -881,13 +1196,21 @@ void ysfx_init(ysfx_t *fx)
     }
 
     ysfx_clear_files(fx);
+    ysfx_ram_modified(fx);
+    ysfx_string_sync_receive(fx);
 
     for (size_t i = 0; i < fx->code.init.size(); ++i)
         NSEEL_code_execute(fx->code.init[i].get());
+    ysfx_count<uint64_t>(fx->counters.init);
+    ysfx_string_sync_send(fx);
+
+    ysfx_prepare_ram(fx);
 
     fx->must_compute_init = false;
     fx->must_compute_slider = true;
 
+    ysfx_publish_string_memory(fx);
+
 #if !defined(YSFX_NO_GFX)
     // do initializations on next @gfx, on the gfx thread
     // release-acquire order is for VM `gfx_*` variables and `wants_retina`
@@ -925,8 +1248,10 @@ void ysfx_set_time_info(ysfx_t *fx, const ysfx_time_info_t *info)
             return state == ysfx_playback_playing ||
                 state == ysfx_playback_recording;
         };
-        if (!is_running(prev_state) && is_running(new_state))
+        if (!is_running(prev_state) && is_running(new_state)) {
             fx->must_compute_init = true;
+            ysfx_count<uint64_t>(fx->counters.transport_restarts);
+        }
     }
 
     *fx->var.tempo = info->tempo;
@@ -1018,6 +1343,12 @@ void ysfx_process_generic(ysfx_t *fx, const Real *const *ins, Real *const *outs,
         if (fx->must_compute_init)
             ysfx_init(fx);
 
+        ysfx_ram_modified(fx);
+        ysfx_string_sync_receive(fx);
+
+        // count the memory which the processing has to allocate
+        ysfx_ram_count_scope ram_count_scope{fx->ram.allocator};
+
         const uint32_t orig_num_outs = num_outs;
         const uint32_t num_code_ins = (uint32_t)fx->source.main->header.in_pins.size();
         const uint32_t num_code_outs = (uint32_t)fx->source.main->header.out_pins.size();
@@ -1035,6 +1366,7 @@ void ysfx_process_generic(ysfx_t *fx, const Real *const *ins, Real *const *outs,
         if (fx->must_compute_slider) {
             NSEEL_code_execute(fx->code.slider.get());
             fx->must_compute_slider = false;
+            ysfx_count<uint64_t>(fx->counters.slider);
         }
 
         // compute @block
@@ -1057,8 +1389,25 @@ void ysfx_process_generic(ysfx_t *fx, const Real *const *ins, Real *const *outs,
         // clear any output channels above the maximum count
         for (uint32_t ch = num_outs; ch < orig_num_outs; ++ch)
             memset(outs[ch], 0, num_frames * sizeof(Real));
+
+        ysfx_string_sync_send(fx);
+
+        if (fx->string_memory_wanted.exchange(false, std::memory_order_relaxed))
+            ysfx_publish_string_memory(fx);
     }
 
+    // count the MIDI traffic, including what the host sent to an effect which is not compiled
+    ysfx_midi_buffer_t *midi_in = fx->midi.in.get();
+    ysfx_midi_buffer_t *midi_out = fx->midi.out.get();
+    ysfx_count<uint64_t>(fx->counters.blocks);
+    ysfx_count<uint64_t>(fx->counters.midi_in, midi_in->count);
+    ysfx_count<uint64_t>(fx->counters.midi_out, midi_out->count);
+    ysfx_count<uint64_t>(fx->counters.midi_in_dropped, midi_in->dropped);
+    ysfx_count<uint64_t>(fx->counters.midi_out_dropped, midi_out->dropped);
+    ysfx_count_peak<uint32_t>(fx->counters.midi_in_peak, midi_in->count);
+    ysfx_count_peak<uint32_t>(fx->counters.midi_out_peak, midi_out->count);
+    ysfx_publish_midi_memory(fx);
+
     // prepare MIDI input for writing, output for reading
     assert(fx->midi.out->read_pos == 0);
     ysfx_midi_clear(fx->midi.in.get());
@@ -1089,6 +1438,8 @@ void ysfx_clear_files(ysfx_t *fx)
         }
         fx->file.list.pop_back();
     }
+
+    fx->counters.open_files.store(0, std::memory_order_relaxed);
 }
 
 ysfx_file_t *ysfx_get_file(ysfx_t *fx, uint32_t handle, std::unique_lock<ysfx::mutex> &lock, std::unique_lock<ysfx::mutex> *list_lock)
@@ -1119,37 +1470,52 @@ int32_t ysfx_insert_file(ysfx_t *fx, ysfx_file_t *file)
         if (!fx->file.list[i])
             freeidx = i;
     }
-    if (freeidx != noneidx) {
-        fx->file.list[freeidx].reset(file);
-        return (uint32_t)freeidx;
+    size_t pos = freeidx;
+    if (pos != noneidx)
+        fx->file.list[pos].reset(file);
+    else {
+        pos = fx->file.list.size();
+        if (pos >= ysfx_max_file_handles) {
+            ysfx_count<uint64_t>(fx->counters.file_handle_failures);
+            return -1;
+        }
+        fx->file.list.emplace_back(file);
     }
 
-    enum { max_file_handles = 64 };
-
-    size_t pos = fx->file.list.size();
-    if (pos >= max_file_handles)
-        return -1;
-
-    fx->file.list.emplace_back(file);
+    ysfx_count<uint32_t>(fx->counters.open_files);
+    ysfx_count_peak<uint32_t>(fx->counters.open_files_peak, fx->counters.open_files.load(std::memory_order_relaxed));
     return (uint32_t)pos;
 }
 
+// keep the capacity of the serialization buffer for the next save, unless it's
+// much larger than the state last serialized, which happens after a peak
+static void ysfx_trim_serialization_buffer(ysfx_t *fx, size_t size)
+{
+    std::string &buffer = fx->serialization_buffer;
+    if (buffer.capacity() <= 2 * size + 4096)
+        return;
+    std::string trimmed;
+    trimmed.reserve(size);
+    buffer.swap(trimmed);
+}
+
 bool ysfx_load_state(ysfx_t *fx, ysfx_state_t *state)
 {
     if (!fx->code.compiled)
         return false;
 
     // restore the serialization
-    std::string buffer((char *)state->data, state->data_size);
+    std::string &buffer = fx->serialization_buffer;
+    buffer.assign((char *)state->data, state->data_size);
 
     // restore the sliders
     for (uint32_t i = 0; i < ysfx_max_sliders; ++i)
-        *fx->var.slider[i] = fx->source.main->header.sliders[i].def;
+        fx->var.slider[i] = fx->source.main->header.sliders[i].def;
 
     for (uint32_t i = 0, n = state->slider_count; i < n; ++i) {
         uint32_t j = state->sliders[i].index;
         if (j < ysfx_max_sliders && fx->source.main->header.sliders[j].exists)
-            *fx->var.slider[j] = state->sliders[i].value;
+            fx->var.slider[j] = state->sliders[i].value;
     }
     fx->must_compute_slider = true;
 
@@ -1165,15 +1531,26 @@ bool ysfx_load_state(ysfx_t *fx, ysfx_state_t *state)
         serializer->end();
     }
 
+    ysfx_trim_serialization_buffer(fx, state->data_size);
     return true;
 }
 
 ysfx_state_t *ysfx_save_state(ysfx_t *fx)
 {
-    if (!fx->code.compiled)
+    ysfx_state_u state{ysfx_state_alloc()};
+    if (!ysfx_save_state_into(fx, state.get()))
         return nullptr;
+    return state.release();
+}
+
+bool ysfx_save_state_into(ysfx_t *fx, ysfx_state_t *state)
+{
+    if (!fx->code.compiled)
+        return false;
 
-    std::string buffer;
+    // the buffer keeps its capacity from one save to the next, within a limit
+    std::string &buffer = fx->serialization_buffer;
+    buffer.clear();
 
     // invoke @serialize
     {
@@ -1187,59 +1564,114 @@ ysfx_state_t *ysfx_save_state(ysfx_t *fx)
         serializer->end();
     }
 
-    // save the sliders
-    ysfx_state_u state{new ysfx_state_t};
     uint32_t slider_count = 0;
     for (uint32_t i = 0; i < ysfx_max_sliders; ++i)
         slider_count += fx->source.main->header.sliders[i].exists;
 
-    state->sliders = new ysfx_state_slider_t[slider_count]{};
-    state->slider_count = slider_count;
+    ysfx_state_resize(state, slider_count, buffer.size());
 
-    for (uint32_t i = 0, j = 0; i < slider_count; ++i) {
+    // save the sliders
+    for (uint32_t i = 0, j = 0; i < ysfx_max_sliders; ++i) {
         if (fx->source.main->header.sliders[i].exists) {
             state->sliders[j].index = i;
-            state->sliders[j].value = *fx->var.slider[i];
+            state->sliders[j].value = fx->var.slider[i];
             ++j;
         }
     }
 
     // save the serialization
-    state->data_size = buffer.size();
-    state->data = new uint8_t[state->data_size];
-    memcpy(state->data, buffer.data(), state->data_size);
+    if (!buffer.empty())
+        memcpy(state->data, buffer.data(), buffer.size());
 
-    //
-    return state.release();
+    ysfx_trim_serialization_buffer(fx, buffer.size());
+    return true;
 }
 
-void ysfx_state_free(ysfx_state_t *state)
+ysfx_state_delta_t *ysfx_state_diff(ysfx_state_t *base, ysfx_state_t *state, uint32_t chunk_size)
 {
-    if (!state)
-        return;
+    if (!base || !state)
+        return nullptr;
+
+    if (chunk_size == 0)
+        chunk_size = 4096;
+
+    ysfx_state_delta_u delta{new ysfx_state_delta_t{}};
+    delta->base_size = base->data_size;
+    delta->base_checksum = ysfx::hash64(base->data, base->data_size);
+
+    uint32_t slider_count = delta->slider_count = state->slider_count;
+    delta->sliders = new ysfx_state_slider_t[slider_count];
+    memcpy(delta->sliders, state->sliders, slider_count * sizeof(ysfx_state_slider_t));
+
+    // find the changed chunks, and merge the adjacent ones into ranges
+    const size_t size = delta->data_size = state->data_size;
+    std::vector<std::pair<size_t, size_t>> ranges;
+    for (size_t offset = 0; offset < size; offset += chunk_size) {
+        size_t count = std::min<size_t>(chunk_size, size - offset);
+        bool changed = offset + count > base->data_size ||
+            memcmp(&base->data[offset], &state->data[offset], count) != 0;
+        if (!changed)
+            continue;
+        if (!ranges.empty() && ranges.back().first + ranges.back().second == offset)
+            ranges.back().second += count;
+        else
+            ranges.emplace_back(offset, count);
+    }
+
+    uint32_t range_count = (uint32_t)ranges.size();
+    delta->ranges = new ysfx_state_range_t[range_count]{};
+    delta->range_count = range_count;
+    for (uint32_t i = 0; i < range_count; ++i) {
+        ysfx_state_range_t &range = delta->ranges[i];
+        range.offset = ranges[i].first;
+        range.size = ranges[i].second;
+        range.data = new uint8_t[range.size];
+        memcpy(range.data, &state->data[range.offset], range.size);
+    }
 
-    delete[] state->sliders;
-    delete[] state->data;
-    delete state;
+    return delta.release();
 }
 
-ysfx_state_t *ysfx_state_dup(ysfx_state_t *state_in)
+ysfx_state_t *ysfx_state_apply_delta(ysfx_state_t *base, ysfx_state_delta_t *delta)
 {
-    if (!state_in)
+    if (!base || !delta)
         return nullptr;
 
-    ysfx_state_u state_out{new ysfx_state_t};
+    // the unchanged data come from the base, so it must be the one of the diff
+    if (base->data_size != delta->base_size || ysfx::hash64(base->data, base->data_size) != delta->base_checksum)
+        return nullptr;
+
+    const size_t size = delta->data_size;
+    for (uint32_t i = 0; i < delta->range_count; ++i) {
+        const ysfx_state_range_t &range = delta->ranges[i];
+        if (range.offset > size || range.size > size - range.offset)
+            return nullptr;
+    }
+
+    ysfx_state_u state{ysfx_state_alloc()};
+    ysfx_state_resize(state.get(), delta->slider_count, size);
+    memcpy(state->sliders, delta->sliders, delta->slider_count * sizeof(ysfx_state_slider_t));
 
-    uint32_t slider_count = state_out->slider_count = state_in->slider_count;
-    uint32_t data_size = state_out->data_size = state_in->data_size;
+    size_t common = std::min(size, base->data_size);
+    memcpy(state->data, base->data, common);
+    for (uint32_t i = 0; i < delta->range_count; ++i) {
+        const ysfx_state_range_t &range = delta->ranges[i];
+        memcpy(&state->data[range.offset], range.data, range.size);
+    }
 
-    state_out->sliders = new ysfx_state_slider_t[slider_count];
-    memcpy(state_out->sliders, state_in->sliders, slider_count * sizeof(ysfx_state_slider_t));
+    return state.release();
+}
 
-    state_out->data = new uint8_t[data_size];
-    memcpy(state_out->data, state_in->data, data_size);
+void ysfx_state_delta_free(ysfx_state_delta_t *delta)
+{
+    if (!delta)
+        return;
 
-    return state_out.release();
+    for (uint32_t i = 0; i < delta->range_count; ++i)
+        delete[] delta->ranges[i].data;
+    delete[] delta->ranges;
+    delete[] delta->sliders;
+    delete delta;
 }
 
 void ysfx_serialize(ysfx_t *fx)
@@ -1247,25 +1679,65 @@ void ysfx_serialize(ysfx_t *fx)
     if (fx->code.serialize) {
         if (fx->must_compute_init)
             ysfx_init(fx);
+        ysfx_ram_modified(fx);
+        ysfx_string_sync_receive(fx);
         NSEEL_code_execute(fx->code.serialize.get());
+        ysfx_string_sync_send(fx);
     }
 }
 
 uint32_t ysfx_get_slider_of_var(ysfx_t *fx, EEL_F *var)
 {
-    auto it = fx->slider_of_var.find(var);
-    if (it == fx->slider_of_var.end())
+    uintptr_t offset = (uintptr_t)var - (uintptr_t)fx->var.slider;
+    if (offset >= sizeof(fx->var.slider))
         return ~(uint32_t)0;
-    return it->second;
+    return (uint32_t)(offset / sizeof(EEL_F));
+}
+
+EEL_F *ysfx_find_slider_var(ysfx_t *fx, const char *name)
+{
+    // `sliderN`, in any case, without leading zeros
+    const char prefix[] = "slider";
+    for (size_t i = 0; i < sizeof(prefix) - 1; ++i) {
+        if (ysfx::ascii_tolower(name[i]) != prefix[i])
+            return nullptr;
+    }
+    const char *digits = name + sizeof(prefix) - 1;
+    if (digits[0] < '1' || digits[0] > '9')
+        return nullptr;
+    uint32_t number = 0;
+    for (const char *p = digits; *p; ++p) {
+        if (*p < '0' || *p > '9' || p - digits >= 2)
+            return nullptr;
+        number = 10 * number + (uint32_t)(*p - '0');
+    }
+    if (number > ysfx_max_sliders)
+        return nullptr;
+    return &fx->var.slider[number - 1];
 }
 
 void ysfx_enum_vars(ysfx_t *fx, ysfx_enum_vars_callback_t *callback, void *userdata)
 {
+    // the sliders are outside of the VM
+    for (uint32_t i = 0; i < ysfx_max_sliders; ++i) {
+        std::string name = "slider" + std::to_string(i + 1);
+        if (!callback(name.c_str(), &fx->var.slider[i], userdata))
+            return;
+    }
+
     NSEEL_VM_enumallvars(fx->vm.get(), callback, userdata);
 }
 
 ysfx_real *ysfx_find_var(ysfx_t *fx, const char *name)
 {
+    if (EEL_F *slider = ysfx_find_slider_var(fx, name))
+        return slider;
+
+    if (fx->code.compiled) {
+        auto it = fx->code.var_index.find(name);
+        return (it != fx->code.var_index.end()) ? it->second : nullptr;
+    }
+
     struct find_data {
         ysfx_real *var = nullptr;
         const char *name = nullptr;
@@ -1283,11 +1755,72 @@ ysfx_real *ysfx_find_var(ysfx_t *fx, const char *name)
     return fd.var;
 }
 
+uint32_t ysfx_find_vars(ysfx_t *fx, const char *const *names, ysfx_real **vars, uint32_t count)
+{
+    uint32_t num_found = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        vars[i] = ysfx_find_var(fx, names[i]);
+        num_found += vars[i] != nullptr;
+    }
+    return num_found;
+}
+
 void ysfx_read_vmem(ysfx_t *fx, uint32_t addr, ysfx_real *dest, uint32_t count)
 {
     ysfx_eel_ram_reader reader(fx->vm.get(), addr);
-    for (uint32_t i = 0; i < count; ++i)
-        dest[i] = reader.read_next();
+    reader.read_array(dest, count);
+}
+
+uint32_t ysfx_write_vmem(ysfx_t *fx, uint32_t addr, const ysfx_real *src, uint32_t count)
+{
+    ysfx_ram_modified(fx);
+    ysfx_eel_ram_writer writer(fx->vm.get(), addr);
+    return writer.write_array(src, count);
+}
+
+uint32_t ysfx_map_vmem_range(ysfx_t *fx, uint32_t addr, uint32_t count, ysfx_vmem_span_t *spans, uint32_t max_spans)
+{
+    NSEEL_VMCTX vm = fx->vm.get();
+    uint32_t num_spans = 0;
+    ysfx_vmem_span_t span{};
+
+    // the addresses stop at the top of the 32-bit space, rather than wrap
+    uint64_t pos = addr;
+    const uint64_t end = std::min<uint64_t>((uint64_t)addr + count, (uint64_t)1 << 32);
+
+    while (pos < end) {
+        int32_t avail = 0;
+        const EEL_F *data = NSEEL_VM_getramptr_noalloc(vm, (uint32_t)pos, &avail);
+        uint32_t n;
+        if (data)
+            n = (uint32_t)std::min<uint64_t>((uint64_t)avail, end - pos);
+        else {
+            // skip to the next block
+            uint64_t next = (pos / NSEEL_RAM_ITEMSPERBLOCK + 1) * NSEEL_RAM_ITEMSPERBLOCK;
+            n = (uint32_t)(std::min(next, end) - pos);
+        }
+
+        // blocks which are adjacent in memory, or both unallocated, make a single span
+        bool extends = num_spans > 0 &&
+            ((!span.data && !data) || (span.data && data && span.data + span.count == data));
+        if (extends)
+            span.count += n;
+        else {
+            if (num_spans > 0 && num_spans <= max_spans)
+                spans[num_spans - 1] = span;
+            span.addr = (uint32_t)pos;
+            span.count = n;
+            span.data = data;
+            ++num_spans;
+        }
+
+        pos += n;
+    }
+
+    if (num_spans > 0 && num_spans <= max_spans)
+        spans[num_spans - 1] = span;
+
+    return num_spans;
 }
 
 ysfx_file_type_t ysfx_detect_file_type(ysfx_t *fx, const char *path, void **fmtobj)
@@ -1341,7 +1874,12 @@ bool ysfx_gfx_run(ysfx_t *fx)
         return false;
 
     ysfx_gfx_prepare(fx);
-    NSEEL_code_execute(fx->code.gfx.get());
+    ysfx_ram_modified(fx);
+    {
+        ysfx_scoped_gfx_strings_t strings_scope{fx};
+        NSEEL_code_execute(fx->code.gfx.get());
+    }
+    ysfx_gfx_state_update_image_memory(fx->gfx.state.get());
 
     return ysfx_gfx_state_is_dirty(fx->gfx.state.get());
 #else
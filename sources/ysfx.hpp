@@ -17,6 +17,7 @@
 
 #pragma once
 #include "ysfx.h"
+#include "ysfx_config.hpp"
 #include "ysfx_midi.hpp"
 #include "ysfx_parse.hpp"
 #include "ysfx_api_eel.hpp"
@@ -24,6 +25,7 @@
 #include "ysfx_api_file.hpp"
 #include "ysfx_api_gfx.hpp"
 #include "ysfx_utils.hpp"
+#include "ysfx_ram.hpp"
 #include "WDL/eel2/ns-eel.h"
 #include "WDL/eel2/ns-eel-int.h"
 #include <unordered_map>
@@ -38,54 +40,83 @@ struct ysfx_source_unit_t {
 };
 using ysfx_source_unit_u = std::unique_ptr< ysfx_source_unit_t>;
 
-enum ysfx_file_type_t {
-    ysfx_file_type_none,
-    ysfx_file_type_txt,
-    ysfx_file_type_raw,
-    ysfx_file_type_audio,
-};
-
 struct ysfx_s {
     ysfx_config_u config;
     eel_string_context_state_u string_ctx;
-    ysfx::mutex string_mutex;
-    ysfx::mutex atomic_mutex;
+    // the strings of @gfx, and their exchange with the above
+    ysfx_string_sync_u string_sync;
+    // the size of the strings, as published by the thread which runs the code
+    std::atomic<bool> string_memory_wanted{false};
+    std::atomic<uint64_t> string_memory{0};
+    // the size of the code, as published by the compilation
+    std::atomic<uint64_t> code_memory{0};
+    // the capacity of the MIDI buffers, as published by the processing
+    std::atomic<uint64_t> midi_memory{0};
     NSEEL_VMCTX_u vm;
 
+    // memory which backs the VM, other than the heap blocks of EEL2
+    //     it's declared after the VM, so it's released before it
+    struct {
+        ysfx_ram_allocator_t allocator;
+        ysfx_ram_arena_t arena;
+        ysfx_ram_view_t view;
+        ysfx_ram_lock_t lock;
+        // the last image taken of the memory, reusable if generation has not changed
+        std::shared_ptr<ysfx_ram_image_t> image;
+        uint64_t image_generation = 0;
+        // counts the executions of code, which may modify the memory
+        std::atomic<uint64_t> generation{0};
+        // how the memory is prepared at @init (ysfx_ram_option_t)
+        uint32_t options = 0;
+        uint32_t prealloc = 0;
+    } ram;
+
     // some default values, these are not standard, just arbitrary
     uint32_t block_size = 128;
     ysfx_real sample_rate = 44100;
     uint32_t valid_input_channels = 2;
 
+    // the number of times it was compiled, which identifies the code
+    uint64_t compile_count = 0;
+
     bool is_freshly_compiled = false;
     bool must_compute_init = false;
     bool must_compute_slider = false;
 
-    std::unordered_map<ysfx_real *, uint32_t> slider_of_var;
-
     // source
+    //     the units are immutable once loaded, so clones can share them
     struct {
         std::string main_file_path;
-        ysfx_source_unit_u main;
-        std::vector<ysfx_source_unit_u> imports;
+        std::shared_ptr<ysfx_source_unit_t> main;
+        std::vector<std::shared_ptr<ysfx_source_unit_t>> imports;
         std::unordered_map<std::string, uint32_t> slider_alias;
     } source;
 
     // compilation
     struct {
         bool compiled = false;
+        uint32_t compileopts = 0;
         std::vector<NSEEL_CODEHANDLE_u> init;
         NSEEL_CODEHANDLE_u slider;
         NSEEL_CODEHANDLE_u block;
         NSEEL_CODEHANDLE_u sample;
         NSEEL_CODEHANDLE_u gfx;
         NSEEL_CODEHANDLE_u serialize;
+        // the variables of the VM by name, indexed once compiled
+        std::unordered_map<std::string, ysfx_real *> var_index;
+        // whether code runs on more than one thread and accesses the strings,
+        // which is when @gfx has its own strings (see ysfx_string_sync_t)
+        bool shares_strings = false;
+        // the named memory, released after the code
+        ysfx_gmem_u gmem;
     } code;
 
     // VM variables
     struct {
         EEL_F *spl[ysfx_max_channels] = {};
-        EEL_F *slider[ysfx_max_sliders] = {};
+        // the values of sliders are stored here, rather than in the VM, so they
+        // are contiguous, and a variable is recognized as a slider by address
+        EEL_F slider[ysfx_max_sliders] = {};
         EEL_F *srate = nullptr;
         EEL_F *num_ch = nullptr;
         EEL_F *samplesblock = nullptr;
@@ -142,6 +173,9 @@ struct ysfx_s {
     // Triggers
     uint32_t triggers = 0;
 
+    // Serialization, which reuses the buffer
+    std::string serialization_buffer;
+
     // Files
     struct {
         std::vector<ysfx_file_u> list;
@@ -158,11 +192,52 @@ struct ysfx_s {
         std::atomic<bool> must_init{false};
     } gfx;
 #endif
+
+    // Counters, each written by one thread at a time, and readable by any
+    struct {
+        std::atomic<uint64_t> init{0};
+        std::atomic<uint64_t> transport_restarts{0};
+        std::atomic<uint64_t> slider{0};
+        std::atomic<uint64_t> blocks{0};
+        std::atomic<uint64_t> midi_in{0};
+        std::atomic<uint64_t> midi_out{0};
+        std::atomic<uint64_t> midi_in_dropped{0};
+        std::atomic<uint64_t> midi_out_dropped{0};
+        std::atomic<uint32_t> midi_in_peak{0};
+        std::atomic<uint32_t> midi_out_peak{0};
+        // these are written under the lock of the file list
+        std::atomic<uint32_t> open_files{0};
+        std::atomic<uint32_t> open_files_peak{0};
+        std::atomic<uint64_t> file_handle_failures{0};
+    } counters;
 };
 
+template <class T>
+inline void ysfx_count(std::atomic<T> &counter, T n = 1)
+{
+    // there is a single writer, so it does not need a read-modify-write
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+template <class T>
+inline void ysfx_count_peak(std::atomic<T> &counter, T value)
+{
+    if (value > counter.load(std::memory_order_relaxed))
+        counter.store(value, std::memory_order_relaxed);
+}
+
 void ysfx_unload_source(ysfx_t *fx);
 void ysfx_unload_code(ysfx_t *fx);
 void ysfx_first_init(ysfx_t *fx);
+ysfx_t *ysfx_new_sibling(ysfx_t *fx);
+void ysfx_copy_runtime_state(ysfx_t *dst, ysfx_t *src);
+void ysfx_copy_strings_and_sliders(ysfx_t *dst, ysfx_t *src);
+bool ysfx_share_ram(ysfx_t *dst, ysfx_t *src);
+void ysfx_ram_modified(ysfx_t *fx);
+void ysfx_prepare_ram(ysfx_t *fx);
+void ysfx_publish_string_memory(ysfx_t *fx);
+void ysfx_publish_code_memory(ysfx_t *fx);
+void ysfx_publish_midi_memory(ysfx_t *fx);
 void ysfx_fill_file_enums(ysfx_t *fx);
 void ysfx_fix_invalid_enums(ysfx_t *fx);
 ysfx_section_t *ysfx_search_section(ysfx_t *fx, uint32_t type, ysfx_toplevel_t **origin = nullptr);
@@ -173,4 +248,5 @@ ysfx_file_t *ysfx_get_file(ysfx_t *fx, uint32_t handle, std::unique_lock<ysfx::m
 int32_t ysfx_insert_file(ysfx_t *fx, ysfx_file_t *file);
 void ysfx_serialize(ysfx_t *fx);
 uint32_t ysfx_get_slider_of_var(ysfx_t *fx, EEL_F *var);
+EEL_F *ysfx_find_slider_var(ysfx_t *fx, const char *name);
 ysfx_file_type_t ysfx_detect_file_type(ysfx_t *fx, const char *path, void **fmtobj);
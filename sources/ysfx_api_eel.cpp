@@ -21,30 +21,172 @@
 #include <cstring>
 #include <cstdlib>
 #include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <atomic>
 
 #include "WDL/ptrlist.h"
 #include "WDL/assocarray.h"
 #include "WDL/mutex.h"
 
-#define EEL_STRING_GET_CONTEXT_POINTER(opaque) (((ysfx_t *)(opaque))->string_ctx.get())
+// The code which runs on the audio thread and @gfx each have their own strings,
+// so they never wait for each other. The strings which either side modifies
+// are passed to the other by the synchronization, which does not lock.
+static eel_string_context_state *ysfx_string_context(ysfx_t *fx);
+static const char *ysfx_string_for_index(ysfx_t *fx, EEL_F index, WDL_FastString **wr, bool for_write);
+
+#define EEL_STRING_GET_CONTEXT_POINTER(opaque) (ysfx_string_context((ysfx_t *)(opaque)))
+#define EEL_STRING_GET_FOR_INDEX(x, wr) (ysfx_string_for_index((ysfx_t *)(opaque), (x), (wr), false))
+#define EEL_STRING_GET_FOR_WRITE(x, wr) (ysfx_string_for_index((ysfx_t *)(opaque), (x), (wr), true))
 #ifndef EELSCRIPT_NO_STDIO
 #   define EEL_STRING_STDOUT_WRITE(x,len) { fwrite(x,len,1,stdout); fflush(stdout); }
 #endif
 
-//TODO: thread-safety considerations with strings
-#define EEL_STRING_MUTEXLOCK_SCOPE std::lock_guard<ysfx::mutex> lock{((ysfx_t *)(opaque))->string_mutex};
+#define EEL_STRING_MUTEXLOCK_SCOPE
 #define EEL_STRING_MAXUSERSTRING_LENGTH_HINT ysfx_string_max_length
 
-static ysfx::mutex atomic_mutex;
-#define EEL_ATOMIC_SET_SCOPE(opaque) ysfx::mutex *mutex = ((opaque) ? &((ysfx_t *)(opaque))->atomic_mutex : &atomic_mutex);
-#define EEL_ATOMIC_ENTER mutex->lock()
-#define EEL_ATOMIC_LEAVE mutex->unlock()
-
 #include "WDL/eel2/eel_strings.h"
 #include "WDL/eel2/eel_misc.h"
 #include "WDL/eel2/eel_fft.h"
 #include "WDL/eel2/eel_mdct.h"
-#include "WDL/eel2/eel_atomic.h"
+
+//------------------------------------------------------------------------------
+// The atomics must be atomic across the effects which share gmem. They use
+// the 64-bit atomic instructions of the processor on the value in place,
+// or a global mutex where these are not available.
+//
+// Only the first argument of `atomic_exch` is updated atomically; the second
+// one is read, then written, apart from it, as it's normally a local variable.
+
+#if defined(__GCC_ATOMIC_LLONG_LOCK_FREE) && __GCC_ATOMIC_LLONG_LOCK_FREE == 2
+#   define YSFX_ATOMIC_LOCK_FREE 1
+static inline EEL_F ysfx_atomic_load(EEL_F *a)
+{
+    EEL_F value;
+    __atomic_load(a, &value, __ATOMIC_SEQ_CST);
+    return value;
+}
+static inline void ysfx_atomic_store(EEL_F *a, EEL_F value)
+{
+    __atomic_store(a, &value, __ATOMIC_SEQ_CST);
+}
+static inline EEL_F ysfx_atomic_exchange(EEL_F *a, EEL_F value)
+{
+    EEL_F old;
+    __atomic_exchange(a, &value, &old, __ATOMIC_SEQ_CST);
+    return old;
+}
+// on failure, the current value is stored in `expected`
+static inline bool ysfx_atomic_compare_exchange(EEL_F *a, EEL_F &expected, EEL_F desired)
+{
+    return __atomic_compare_exchange(a, &expected, &desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+#   define YSFX_ATOMIC_LOCK_FREE 1
+#   include <intrin.h>
+static_assert(sizeof(EEL_F) == sizeof(__int64), "the value must have 64 bits");
+static inline __int64 ysfx_atomic_bits(EEL_F value)
+{
+    __int64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+static inline EEL_F ysfx_atomic_value(__int64 bits)
+{
+    EEL_F value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+static inline EEL_F ysfx_atomic_load(EEL_F *a)
+{
+    return ysfx_atomic_value(_InterlockedCompareExchange64((volatile __int64 *)a, 0, 0));
+}
+static inline EEL_F ysfx_atomic_exchange(EEL_F *a, EEL_F value)
+{
+    return ysfx_atomic_value(_InterlockedExchange64((volatile __int64 *)a, ysfx_atomic_bits(value)));
+}
+static inline void ysfx_atomic_store(EEL_F *a, EEL_F value)
+{
+    ysfx_atomic_exchange(a, value);
+}
+static inline bool ysfx_atomic_compare_exchange(EEL_F *a, EEL_F &expected, EEL_F desired)
+{
+    __int64 expected_bits = ysfx_atomic_bits(expected);
+    __int64 old_bits = _InterlockedCompareExchange64((volatile __int64 *)a, ysfx_atomic_bits(desired), expected_bits);
+    expected = ysfx_atomic_value(old_bits);
+    return old_bits == expected_bits;
+}
+#else
+#   define YSFX_ATOMIC_LOCK_FREE 0
+static ysfx::mutex atomic_mutex;
+#endif
+
+static EEL_F NSEEL_CGEN_CALL ysfx_api_atomic_setifequal(void *, EEL_F *a, EEL_F *cmp, EEL_F *nd)
+{
+#if YSFX_ATOMIC_LOCK_FREE
+    EEL_F old = ysfx_atomic_load(a);
+    while (fabs(old - *cmp) < NSEEL_CLOSEFACTOR && !ysfx_atomic_compare_exchange(a, old, *nd));
+    return old;
+#else
+    std::lock_guard<ysfx::mutex> lock{atomic_mutex};
+    EEL_F old = *a;
+    if (fabs(old - *cmp) < NSEEL_CLOSEFACTOR)
+        *a = *nd;
+    return old;
+#endif
+}
+
+static EEL_F NSEEL_CGEN_CALL ysfx_api_atomic_exch(void *, EEL_F *a, EEL_F *b)
+{
+#if YSFX_ATOMIC_LOCK_FREE
+    // like in EEL2, the result is the value which `b` had, now in `a`
+    EEL_F value = ysfx_atomic_load(b);
+    ysfx_atomic_store(b, ysfx_atomic_exchange(a, value));
+    return value;
+#else
+    std::lock_guard<ysfx::mutex> lock{atomic_mutex};
+    EEL_F old = *b;
+    *b = *a;
+    *a = old;
+    return old;
+#endif
+}
+
+static EEL_F NSEEL_CGEN_CALL ysfx_api_atomic_add(void *, EEL_F *a, EEL_F *b)
+{
+#if YSFX_ATOMIC_LOCK_FREE
+    EEL_F increment = ysfx_atomic_load(b);
+    EEL_F old = ysfx_atomic_load(a);
+    while (!ysfx_atomic_compare_exchange(a, old, old + increment));
+    return old + increment;
+#else
+    std::lock_guard<ysfx::mutex> lock{atomic_mutex};
+    return *a += *b;
+#endif
+}
+
+static EEL_F NSEEL_CGEN_CALL ysfx_api_atomic_set(void *, EEL_F *a, EEL_F *b)
+{
+#if YSFX_ATOMIC_LOCK_FREE
+    EEL_F value = ysfx_atomic_load(b);
+    ysfx_atomic_store(a, value);
+    return value;
+#else
+    std::lock_guard<ysfx::mutex> lock{atomic_mutex};
+    return *a = *b;
+#endif
+}
+
+static EEL_F NSEEL_CGEN_CALL ysfx_api_atomic_get(void *, EEL_F *a)
+{
+#if YSFX_ATOMIC_LOCK_FREE
+    return ysfx_atomic_load(a);
+#else
+    std::lock_guard<ysfx::mutex> lock{atomic_mutex};
+    return *a;
+#endif
+}
 
 //------------------------------------------------------------------------------
 void ysfx_api_init_eel()
@@ -54,7 +196,12 @@ void ysfx_api_init_eel()
     EEL_mdct_register();
     EEL_string_register();
     EEL_misc_register();
-    EEL_atomic_register();
+
+    NSEEL_addfunc_retval("atomic_setifequal", 3, NSEEL_PProc_THIS, &ysfx_api_atomic_setifequal);
+    NSEEL_addfunc_retval("atomic_exch", 2, NSEEL_PProc_THIS, &ysfx_api_atomic_exch);
+    NSEEL_addfunc_retval("atomic_add", 2, NSEEL_PProc_THIS, &ysfx_api_atomic_add);
+    NSEEL_addfunc_retval("atomic_set", 2, NSEEL_PProc_THIS, &ysfx_api_atomic_set);
+    NSEEL_addfunc_retval("atomic_get", 1, NSEEL_PProc_THIS, &ysfx_api_atomic_get);
 }
 
 //------------------------------------------------------------------------------
@@ -79,6 +226,423 @@ void ysfx_eel_string_context_update_named_vars(eel_string_context_state *state,
     state->update_named_vars(vm);
 }
 
+uint64_t ysfx_eel_string_context_memory(eel_string_context_state *state)
+{
+    uint64_t size = 0;
+
+    auto add_string = [&size](const WDL_FastString *str) {
+        if (str)
+            size += (uint64_t)str->GetLength() + 1;
+    };
+    auto add_list = [&add_string](const WDL_PtrList<WDL_FastString> &list) {
+        for (int i = 0, n = list.GetSize(); i < n; ++i)
+            add_string(list.Get(i));
+    };
+
+    for (int i = 0; i < EEL_STRING_MAX_USER_STRINGS; ++i)
+        add_string(state->m_user_strings[i]);
+    add_list(state->m_unnamed_strings);
+    add_list(state->m_named_strings);
+    add_list(state->m_literal_strings);
+
+    return size;
+}
+
+void ysfx_eel_string_context_copy(eel_string_context_state *dst, eel_string_context_state *src)
+{
+    // the destination is expected to be compiled from the same code as the
+    // source, which has created the same literal, named and unnamed strings
+
+    for (int i = 0; i < EEL_STRING_MAX_USER_STRINGS; ++i) {
+        WDL_FastString *src_str = src->m_user_strings[i];
+        WDL_FastString *&dst_str = dst->m_user_strings[i];
+        if (src_str) {
+            if (!dst_str)
+                dst_str = new WDL_FastString;
+            dst_str->Set(src_str);
+        }
+        else if (dst_str) {
+            delete dst_str;
+            dst_str = nullptr;
+        }
+    }
+
+    for (int i = 0, n = std::min(src->m_unnamed_strings.GetSize(), dst->m_unnamed_strings.GetSize()); i < n; ++i)
+        dst->m_unnamed_strings.Get(i)->Set(src->m_unnamed_strings.Get(i));
+
+    // named strings created at runtime are recreated in order of index
+    std::vector<const char *> src_names((size_t)src->m_named_strings.GetSize());
+    for (int i = 0, n = src->m_named_strings_names.GetSize(); i < n; ++i) {
+        const char *name = nullptr;
+        int index = src->m_named_strings_names.Enumerate(i, &name) - EEL_STRING_NAMED_BASE;
+        if (index >= 0 && (size_t)index < src_names.size())
+            src_names[(size_t)index] = name;
+    }
+    for (size_t i = 0; i < src_names.size(); ++i) {
+        const char *name = src_names[i];
+        if (!name)
+            continue;
+        int index = dst->m_named_strings_names.Get(name);
+        if (!index) {
+            index = dst->m_named_strings.GetSize() + EEL_STRING_NAMED_BASE;
+            dst->m_named_strings.Add(new WDL_FastString);
+            dst->m_named_strings_names.Insert(name, index);
+        }
+        if (index == (int)i + EEL_STRING_NAMED_BASE)
+            dst->m_named_strings.Get((int)i)->Set(src->m_named_strings.Get((int)i));
+    }
+}
+
+static void ysfx_eel_string_context_copy_all(eel_string_context_state *dst, eel_string_context_state *src)
+{
+    // unlike the above, it copies every string with its index, the literals too
+    dst->clear_state(true);
+
+    for (int i = 0; i < EEL_STRING_MAX_USER_STRINGS; ++i) {
+        if (WDL_FastString *str = src->m_user_strings[i])
+            dst->m_user_strings[i] = new WDL_FastString(str);
+    }
+
+    auto copy_list = [](WDL_PtrList<WDL_FastString> &dst, const WDL_PtrList<WDL_FastString> &src) {
+        for (int i = 0, n = src.GetSize(); i < n; ++i)
+            dst.Add(new WDL_FastString(src.Get(i)));
+    };
+    copy_list(dst->m_literal_strings, src->m_literal_strings);
+    copy_list(dst->m_unnamed_strings, src->m_unnamed_strings);
+    copy_list(dst->m_named_strings, src->m_named_strings);
+
+    for (int i = 0, n = src->m_named_strings_names.GetSize(); i < n; ++i) {
+        const char *name = nullptr;
+        int index = src->m_named_strings_names.Enumerate(i, &name);
+        dst->m_named_strings_names.Insert(name, index);
+    }
+}
+
+//------------------------------------------------------------------------------
+// When the effect has @gfx, the strings exist twice: the main side is for the
+// code which runs on the audio thread, and the other for @gfx. After running
+// code, a side sends the strings which it has modified in a batch, which the
+// other side applies before it runs code again. There is a batch for either
+// direction, and each goes back to its sender once applied, so the exchange
+// needs no lock.
+// While the other side has not taken the batch, the sender takes it back to
+// add to it, so the batch holds at most one entry per string.
+//
+// The functions which access a string for writing mark it, and it's sent if
+// its value differs from the last one exchanged. A side does not apply the
+// strings which it has modified but not sent yet; these prevail. The main
+// side sends back what it applies, so both sides agree even if they sent the
+// same string at the same time.
+//
+// The storage of the exchange is allocated when the code is compiled, and a
+// side keeps only a hash of the values exchanged, so the exchange itself does
+// not allocate: a batch has room for one entry per string and for a bounded
+// amount of text. A string which does not fit with the others stays marked
+// until the next time, and one which does not fit in an empty batch is not
+// sent. A string which receives a longer value grows, the same as when the
+// code writes it.
+
+// size of the text which a batch can hold
+enum { ysfx_string_batch_text_size = 2 * ysfx_string_max_length };
+
+struct ysfx_string_batch_t {
+    struct entry_t {
+        int index = 0;
+        // position of the value in the text
+        size_t offset = 0;
+        size_t length = 0;
+    };
+    // the entries which are in use come first
+    std::vector<entry_t> entries;
+    size_t count = 0;
+    // the values of the entries, and the part which is in use
+    std::vector<char> text;
+    size_t text_used = 0;
+};
+
+struct ysfx_string_side_t {
+    eel_string_context_state *ctx = nullptr;
+
+    struct track_t {
+        // the hash of the value of the last exchange
+        uint64_t shared = 0;
+        // accessed for writing since the last exchange
+        bool marked = false;
+        // to send even if it's unchanged
+        bool echo = false;
+        // the entry of the string in the batch being sent, if it's the same
+        uint64_t batch_serial = 0;
+        size_t batch_entry = 0;
+    };
+    // by index of user strings, of unnamed strings, and of named strings;
+    // the strings are all created by the compilation, except the user strings
+    std::vector<track_t> user;
+    std::vector<track_t> unnamed;
+    std::vector<track_t> named;
+    // the indices of the marked strings
+    std::vector<int> marked;
+    // identifies the batch being sent, which changes once the other side has applied it
+    uint64_t batch_serial = 0;
+
+    // the batch which this side fills, once the other side has given it back
+    std::atomic<ysfx_string_batch_t *> free{nullptr};
+    // the batch which the other side has filled for this side
+    std::atomic<ysfx_string_batch_t *> received{nullptr};
+};
+
+struct ysfx_string_sync_t {
+    eel_string_context_state_u gfx_ctx;
+    ysfx_string_side_t main;
+    ysfx_string_side_t gfx;
+    ysfx_string_batch_t batches[2];
+};
+
+// the effect whose @gfx runs on this thread, if any
+static thread_local ysfx_t *ysfx_string_gfx_fx = nullptr;
+
+ysfx_string_sync_t *ysfx_string_sync_new()
+{
+    ysfx_string_sync_t *sync = new ysfx_string_sync_t;
+    sync->gfx_ctx.reset(ysfx_eel_string_context_new());
+    return sync;
+}
+
+void ysfx_string_sync_free(ysfx_string_sync_t *sync)
+{
+    delete sync;
+}
+
+static ysfx_string_side_t::track_t *ysfx_string_track(ysfx_string_side_t &side, int index)
+{
+    std::vector<ysfx_string_side_t::track_t> *list;
+    if (index >= 0 && index < EEL_STRING_MAX_USER_STRINGS)
+        list = &side.user;
+    else if (index >= EEL_STRING_UNNAMED_BASE)
+        list = &side.unnamed, index -= EEL_STRING_UNNAMED_BASE;
+    else if (index >= EEL_STRING_NAMED_BASE)
+        list = &side.named, index -= EEL_STRING_NAMED_BASE;
+    else
+        return nullptr;
+
+    if ((size_t)index >= list->size())
+        return nullptr;
+    return &(*list)[(size_t)index];
+}
+
+static WDL_FastString *ysfx_string_slot(eel_string_context_state *ctx, int index)
+{
+    // unlike GetStringForIndex, it does not resolve literals
+    if (index >= 0 && index < EEL_STRING_MAX_USER_STRINGS) {
+        WDL_FastString *&str = ctx->m_user_strings[index];
+        if (!str)
+            str = new WDL_FastString;
+        return str;
+    }
+    if (index >= EEL_STRING_UNNAMED_BASE)
+        return ctx->m_unnamed_strings.Get(index - EEL_STRING_UNNAMED_BASE);
+    if (index >= EEL_STRING_NAMED_BASE)
+        return ctx->m_named_strings.Get(index - EEL_STRING_NAMED_BASE);
+    return nullptr;
+}
+
+static uint64_t ysfx_string_hash(const WDL_FastString *str)
+{
+    return str ? ysfx::hash64(str->Get(), (size_t)str->GetLength()) : ysfx::hash64(nullptr, 0);
+}
+
+static void ysfx_string_mark(ysfx_string_side_t &side, int index, bool echo = false)
+{
+    ysfx_string_side_t::track_t *track = ysfx_string_track(side, index);
+    if (!track)
+        return;
+    track->echo = track->echo || echo;
+    if (track->marked)
+        return;
+    track->marked = true;
+    side.marked.push_back(index);
+}
+
+static void ysfx_string_send(ysfx_string_side_t &side, ysfx_string_side_t &other)
+{
+    if (side.marked.empty())
+        return;
+
+    ysfx_string_batch_t *batch = side.free.exchange(nullptr, std::memory_order_acquire);
+    if (batch)
+        ++side.batch_serial;
+    else {
+        // the other side has not taken the last batch yet, so add to it; if
+        // it's applying it, the strings stay marked until the next time
+        batch = other.received.exchange(nullptr, std::memory_order_acquire);
+        if (!batch)
+            return;
+    }
+
+    // the strings which do not fit stay marked, and move to the front
+    size_t kept = 0;
+    for (int index : side.marked) {
+        ysfx_string_side_t::track_t *track = ysfx_string_track(side, index);
+        WDL_FastString *str = ysfx_string_slot(side.ctx, index);
+        size_t length = (size_t)str->GetLength();
+        uint64_t hash = ysfx_string_hash(str);
+        if ((!track->echo && hash == track->shared) || length > batch->text.size()) {
+            track->marked = false;
+            track->echo = false;
+            continue;
+        }
+        bool in_batch = track->batch_serial == side.batch_serial;
+        ysfx_string_batch_t::entry_t *entry = in_batch ? &batch->entries[track->batch_entry] : nullptr;
+        size_t offset;
+        if (entry && length <= entry->length)
+            offset = entry->offset;
+        else if (length <= batch->text.size() - batch->text_used) {
+            offset = batch->text_used;
+            batch->text_used += length;
+        }
+        else {
+            side.marked[kept++] = index;
+            continue;
+        }
+        if (!entry) {
+            track->batch_serial = side.batch_serial;
+            track->batch_entry = batch->count++;
+            entry = &batch->entries[track->batch_entry];
+        }
+        entry->index = index;
+        entry->offset = offset;
+        entry->length = length;
+        if (length > 0)
+            memcpy(&batch->text[offset], str->Get(), length);
+        track->shared = hash;
+        track->marked = false;
+        track->echo = false;
+    }
+    side.marked.resize(kept);
+
+    if (batch->count == 0)
+        side.free.store(batch, std::memory_order_relaxed);
+    else
+        other.received.store(batch, std::memory_order_release);
+}
+
+static void ysfx_string_receive(ysfx_string_side_t &side, ysfx_string_side_t &other, bool echo)
+{
+    ysfx_string_batch_t *batch = side.received.exchange(nullptr, std::memory_order_acquire);
+    if (!batch)
+        return;
+
+    for (size_t i = 0; i < batch->count; ++i) {
+        const ysfx_string_batch_t::entry_t &entry = batch->entries[i];
+        ysfx_string_side_t::track_t *track = ysfx_string_track(side, entry.index);
+        WDL_FastString *str = track ? ysfx_string_slot(side.ctx, entry.index) : nullptr;
+        if (!str)
+            continue;
+        // this side's own modification, which is yet to be sent, prevails
+        if (track->marked && ysfx_string_hash(str) != track->shared)
+            continue;
+        const char *value = entry.length ? &batch->text[entry.offset] : "";
+        str->SetRaw(value, (int)entry.length);
+        track->shared = ysfx::hash64(value, entry.length);
+        if (echo)
+            ysfx_string_mark(side, entry.index, true);
+    }
+
+    batch->count = 0;
+    batch->text_used = 0;
+    other.free.store(batch, std::memory_order_release);
+}
+
+void ysfx_string_sync_reset(ysfx_t *fx)
+{
+    ysfx_string_sync_t *sync = fx->string_sync.get();
+
+    ysfx_eel_string_context_copy_all(sync->gfx_ctx.get(), fx->string_ctx.get());
+    sync->gfx_ctx->update_named_vars(fx->vm.get());
+
+    ysfx_string_side_t *sides[] = {&sync->main, &sync->gfx};
+    eel_string_context_state *contexts[] = {fx->string_ctx.get(), sync->gfx_ctx.get()};
+    for (int i = 0; i < 2; ++i) {
+        ysfx_string_side_t &side = *sides[i];
+        eel_string_context_state *ctx = contexts[i];
+        side.ctx = ctx;
+        side.user.assign(EEL_STRING_MAX_USER_STRINGS, {});
+        side.unnamed.assign((size_t)ctx->m_unnamed_strings.GetSize(), {});
+        side.named.assign((size_t)ctx->m_named_strings.GetSize(), {});
+        // both sides start in agreement
+        for (int index = 0; index < EEL_STRING_MAX_USER_STRINGS; ++index)
+            side.user[(size_t)index].shared = ysfx_string_hash(ctx->m_user_strings[index]);
+        for (size_t index = 0; index < side.unnamed.size(); ++index)
+            side.unnamed[index].shared = ysfx_string_hash(ctx->m_unnamed_strings.Get((int)index));
+        for (size_t index = 0; index < side.named.size(); ++index)
+            side.named[index].shared = ysfx_string_hash(ctx->m_named_strings.Get((int)index));
+        size_t count = side.user.size() + side.unnamed.size() + side.named.size();
+        side.marked.clear();
+        side.marked.reserve(count);
+        side.received.store(nullptr, std::memory_order_relaxed);
+        // the batch which this side sends
+        ysfx_string_batch_t &batch = sync->batches[i];
+        batch.entries.resize(count);
+        batch.count = 0;
+        batch.text.resize(ysfx_string_batch_text_size);
+        batch.text_used = 0;
+        side.free.store(&batch, std::memory_order_relaxed);
+    }
+}
+
+void ysfx_string_sync_receive(ysfx_t *fx)
+{
+    if (!fx->code.shares_strings)
+        return;
+    ysfx_string_sync_t *sync = fx->string_sync.get();
+    ysfx_string_receive(sync->main, sync->gfx, true);
+}
+
+void ysfx_string_sync_send(ysfx_t *fx)
+{
+    if (!fx->code.shares_strings)
+        return;
+    ysfx_string_sync_t *sync = fx->string_sync.get();
+    ysfx_string_send(sync->main, sync->gfx);
+}
+
+void ysfx_string_gfx_enter(ysfx_t *fx)
+{
+    if (!fx->code.shares_strings)
+        return;
+    ysfx_string_sync_t *sync = fx->string_sync.get();
+    ysfx_string_receive(sync->gfx, sync->main, false);
+    ysfx_string_gfx_fx = fx;
+}
+
+void ysfx_string_gfx_leave(ysfx_t *fx)
+{
+    if (!fx->code.shares_strings)
+        return;
+    ysfx_string_sync_t *sync = fx->string_sync.get();
+    ysfx_string_gfx_fx = nullptr;
+    ysfx_string_send(sync->gfx, sync->main);
+}
+
+static eel_string_context_state *ysfx_string_context(ysfx_t *fx)
+{
+    if (ysfx_string_gfx_fx == fx)
+        return fx->string_sync->gfx_ctx.get();
+    return fx->string_ctx.get();
+}
+
+static const char *ysfx_string_for_index(ysfx_t *fx, EEL_F index, WDL_FastString **wr, bool for_write)
+{
+    bool is_gfx = ysfx_string_gfx_fx == fx;
+    eel_string_context_state *ctx = is_gfx ? fx->string_sync->gfx_ctx.get() : fx->string_ctx.get();
+
+    const char *str = ctx->GetStringForIndex(index, wr, for_write);
+    if (wr && *wr && fx->code.shares_strings) {
+        ysfx_string_sync_t *sync = fx->string_sync.get();
+        ysfx_string_mark(is_gfx ? sync->gfx : sync->main, (int)(index + 0.5));
+    }
+    return str;
+}
+
 //------------------------------------------------------------------------------
 static_assert(
     ysfx_string_max_length == EEL_STRING_MAXUSERSTRING_LENGTH_HINT,
@@ -86,12 +650,8 @@ static_assert(
 
 bool ysfx_string_access(ysfx_t *fx, ysfx_real id, bool for_write, void (*access)(void *, WDL_FastString &), void *userdata)
 {
-    void *opaque = fx;
-    eel_string_context_state *ctx = EEL_STRING_GET_CONTEXT_POINTER(opaque);
-    EEL_STRING_MUTEXLOCK_SCOPE
-
     EEL_STRING_STORAGECLASS *wr = nullptr;
-    ctx->GetStringForIndex(id, &wr, for_write);
+    ysfx_string_for_index(fx, id, &wr, for_write);
     if (!wr)
         return false;
 
@@ -118,15 +678,39 @@ bool ysfx_string_set(ysfx_t *fx, ysfx_real id, const std::string &txt)
 }
 
 //------------------------------------------------------------------------------
-// NOTE(jpc) implement this? I guess probably not.
-//     DSP and UI should not mutex each other.
+// EEL2 keeps some state globally, which these mutexes guard. It is what makes
+// the compilation of separate VMs safe to run in parallel.
+//
+// The first one guards what compilation uses: the sorting of the builtin
+// function table, the list of global variables and the statistics of the
+// compiled code. Running code never takes it.
+//
+// The second one guards the allocations which code makes as it runs: the RAM
+// blocks with their accounting, the gmem buffers and the MDCT tables. The DSP
+// takes it when code touches a block of memory for the first time, so that
+// waits only for the allocations of other effects, which are as short.
+
+static ysfx::mutex eel_compile_mutex;
+static ysfx::mutex eel_ram_mutex;
 
 void NSEEL_HOSTSTUB_EnterMutex()
 {
+    eel_compile_mutex.lock();
 }
 
 void NSEEL_HOSTSTUB_LeaveMutex()
 {
+    eel_compile_mutex.unlock();
+}
+
+void NSEEL_HOSTSTUB_EnterRAMMutex()
+{
+    eel_ram_mutex.lock();
+}
+
+void NSEEL_HOSTSTUB_LeaveRAMMutex()
+{
+    eel_ram_mutex.unlock();
 }
 
 //------------------------------------------------------------------------------
@@ -33,6 +33,8 @@ class eel_string_context_state;
 eel_string_context_state *ysfx_eel_string_context_new();
 void ysfx_eel_string_context_free(eel_string_context_state *state);
 void ysfx_eel_string_context_update_named_vars(eel_string_context_state *state, NSEEL_VMCTX vm);
+void ysfx_eel_string_context_copy(eel_string_context_state *dst, eel_string_context_state *src);
+uint64_t ysfx_eel_string_context_memory(eel_string_context_state *state);
 YSFX_DEFINE_AUTO_PTR(eel_string_context_state_u, eel_string_context_state, ysfx_eel_string_context_free);
 
 //------------------------------------------------------------------------------
@@ -40,3 +42,25 @@ enum { ysfx_string_max_length = 1 << 16 };
 bool ysfx_string_access(ysfx_t *fx, ysfx_real id, bool for_write, void (*access)(void *, WDL_FastString &), void *userdata);
 bool ysfx_string_get(ysfx_t *fx, ysfx_real id, std::string &txt);
 bool ysfx_string_set(ysfx_t *fx, ysfx_real id, const std::string &txt);
+
+//------------------------------------------------------------------------------
+struct ysfx_string_sync_t;
+ysfx_string_sync_t *ysfx_string_sync_new();
+void ysfx_string_sync_free(ysfx_string_sync_t *sync);
+YSFX_DEFINE_AUTO_PTR(ysfx_string_sync_u, ysfx_string_sync_t, ysfx_string_sync_free);
+// make the strings of @gfx a copy of the others, and drop the exchanges in progress
+//     it must not run concurrently with processing or with @gfx
+void ysfx_string_sync_reset(ysfx_t *fx);
+// take the strings which @gfx has modified, before running code
+void ysfx_string_sync_receive(ysfx_t *fx);
+// pass the strings which the code has modified to @gfx, after running code
+void ysfx_string_sync_send(ysfx_t *fx);
+// make the code which runs on this thread access the strings of @gfx
+void ysfx_string_gfx_enter(ysfx_t *fx);
+void ysfx_string_gfx_leave(ysfx_t *fx);
+
+struct ysfx_scoped_gfx_strings_t {
+    explicit ysfx_scoped_gfx_strings_t(ysfx_t *fx) : m_fx(fx) { ysfx_string_gfx_enter(fx); }
+    ~ysfx_scoped_gfx_strings_t() { ysfx_string_gfx_leave(m_fx); }
+    ysfx_t *m_fx = nullptr;
+};
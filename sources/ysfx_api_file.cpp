@@ -19,58 +19,144 @@
 #include "ysfx_config.hpp"
 #include "ysfx_api_file.hpp"
 #include "ysfx_eel_utils.hpp"
+#include "ysfx_prefetch.hpp"
+#include <algorithm>
 #include <cstring>
 #include <cstdio>
 #include <cassert>
 
-ysfx_raw_file_t::ysfx_raw_file_t(NSEEL_VMCTX vm, const char *filename)
-    : m_vm(vm),
-      m_stream(ysfx::fopen_utf8(filename, "rb"))
+ysfx_file_source_t::ysfx_file_source_t(const char *filename)
+    : m_stream(ysfx::fopen_utf8(filename, "rb"))
 {
+    if (!m_stream)
+        return;
+
+    m_mapped = ysfx::map_stream_file(m_stream.get(), m_map);
+    if (m_mapped) {
+        m_size = m_map.size;
+        return;
+    }
+
+    // cannot map, fall back to buffered reading
+    int64_t end_off = -1;
+    if (ysfx::fseek_lfs(m_stream.get(), 0, SEEK_END) == 0)
+        end_off = ysfx::ftell_lfs(m_stream.get());
+    ::rewind(m_stream.get());
+
+    m_size = (end_off > 0) ? (uint64_t)end_off : 0;
+    m_buf.reset(new uint8_t[buffer_size]);
 }
 
-int32_t ysfx_raw_file_t::avail()
+ysfx_file_source_t::~ysfx_file_source_t()
+{
+    if (m_mapped)
+        ysfx::unmap_file(m_map);
+}
+
+const uint8_t *ysfx_file_source_t::peek(size_t count, size_t *avail)
+{
+    if (m_mapped) {
+        uint64_t remain = (m_pos < m_size) ? (m_size - m_pos) : 0;
+        *avail = (remain < (uint64_t)SIZE_MAX) ? (size_t)remain : SIZE_MAX;
+        return remain ? (m_map.data + m_pos) : nullptr;
+    }
+
+    if (!m_stream) {
+        *avail = 0;
+        return nullptr;
+    }
+
+    if (count > buffer_size)
+        count = buffer_size;
+    size_t fill = m_buf_fill - m_buf_pos;
+    if (fill < count) {
+        // move the remainder to the front, and refill the rest
+        memmove(&m_buf[0], &m_buf[m_buf_pos], fill);
+        fill += fread(&m_buf[fill], 1, buffer_size - fill, m_stream.get());
+        m_buf_pos = 0;
+        m_buf_fill = fill;
+    }
+    *avail = fill;
+    return &m_buf[m_buf_pos];
+}
+
+void ysfx_file_source_t::skip(size_t count)
+{
+    if (!m_mapped)
+        m_buf_pos += count;
+    m_pos += count;
+}
+
+const uint8_t *ysfx_file_source_t::read(size_t count, size_t *read_count)
+{
+    size_t avail;
+    const uint8_t *data = peek(count, &avail);
+    size_t n = (count < avail) ? count : avail;
+    skip(n);
+    *read_count = n;
+    return data;
+}
+
+void ysfx_file_source_t::rewind()
 {
     if (!m_stream)
-        return 0;
+        return;
 
-    int64_t cur_off = ysfx::ftell_lfs(m_stream.get());
-    if (cur_off == -1)
-        return 0;
+    m_pos = 0;
+    m_buf_pos = 0;
+    m_buf_fill = 0;
 
-    if (ysfx::fseek_lfs(m_stream.get(), 0, SEEK_END) == -1)
-        return 0;
+    if (!m_mapped)
+        ::rewind(m_stream.get());
+}
 
-    int64_t end_off = ysfx::ftell_lfs(m_stream.get());
-    if (end_off == -1)
-        return 0;
+void ysfx_file_source_t::readahead(uint64_t size)
+{
+    if (m_mapped) {
+        // touch every page, so the reads to come do not fault
+        uint64_t end = (size < m_size) ? size : m_size;
+        uint8_t sum = 0;
+        for (uint64_t off = 0; off < end; off += 4096)
+            sum ^= m_map.data[off];
+        volatile uint8_t sink = sum;
+        (void)sink;
+    }
+    else if (size > 0) {
+        // fill the buffer
+        size_t avail;
+        peek(buffer_size, &avail);
+    }
+}
 
-    if (ysfx::fseek_lfs(m_stream.get(), cur_off, SEEK_SET) == -1)
-        return 0;
+//------------------------------------------------------------------------------
+ysfx_raw_file_t::ysfx_raw_file_t(NSEEL_VMCTX vm, const char *filename)
+    : m_vm(vm),
+      m_source(filename)
+{
+}
 
-    if ((uint64_t)end_off < (uint64_t)cur_off)
+int32_t ysfx_raw_file_t::avail()
+{
+    uint64_t size = m_source.size();
+    uint64_t pos = m_source.position();
+    if (!m_source.is_open() || pos >= size)
         return 0;
 
-    uint64_t byte_count = (uint64_t)end_off - (uint64_t)cur_off;
+    uint64_t byte_count = size - pos;
     uint64_t f32_count = byte_count / 4;
     return (f32_count > 0x7fffffff) ? 0x7fffffff : (uint32_t)f32_count;
 }
 
 void ysfx_raw_file_t::rewind()
 {
-    if (!m_stream)
-        return;
-
-    ::rewind(m_stream.get());
+    m_source.rewind();
 }
 
 bool ysfx_raw_file_t::var(ysfx_real *var)
 {
-    if (!m_stream)
-        return false;
-
-    uint8_t data[4];
-    if (fread(data, 1, 4, m_stream.get()) != 4)
+    size_t n;
+    const uint8_t *data = m_source.read(4, &n);
+    if (n != 4)
         return false;
 
     *var = (EEL_F)ysfx::unpack_f32le(data);
@@ -79,29 +165,44 @@ bool ysfx_raw_file_t::var(ysfx_real *var)
 
 uint32_t ysfx_raw_file_t::mem(uint32_t offset, uint32_t length)
 {
-    if (!m_stream)
+    if (!m_source.is_open())
         return 0;
 
     ysfx_eel_ram_writer writer{m_vm, offset};
 
-    uint32_t read;
-    for (read = 0; read < length; ++read) {
-        ysfx_real value;
-        if (!var(&value))
-            break;
-        writer.write_next(value);
+    // decode straight into the RAM blocks, one span at a time
+    uint32_t count = 0;
+    bool eof = false;
+    while (count < length && !eof) {
+        uint32_t n;
+        EEL_F *span = writer.write_span(length - count, &n);
+        uint32_t done = 0;
+        while (done < n) {
+            size_t size;
+            const uint8_t *data = m_source.peek(4, &size);
+            size_t m = size / 4;
+            if (m == 0) {
+                eof = true;
+                break;
+            }
+            if (m > n - done)
+                m = n - done;
+            if (span)
+                ysfx::unpack_f32le_array(data, &span[done], m);
+            m_source.skip(4 * m);
+            done += (uint32_t)m;
+        }
+        count += done;
     }
 
-    return read;
+    return count;
 }
 
 uint32_t ysfx_raw_file_t::string(std::string &str)
 {
-    if (!m_stream)
-        return 0;
-
-    uint8_t data[4];
-    if (fread(data, 1, 4, m_stream.get()) != 4)
+    size_t n;
+    const uint8_t *data = m_source.read(4, &n);
+    if (n != 4)
         return 0;
 
     str.clear();
@@ -110,10 +211,13 @@ uint32_t ysfx_raw_file_t::string(std::string &str)
     str.reserve((srclen < ysfx_string_max_length) ? srclen : ysfx_string_max_length);
 
     uint32_t count = 0;
-    for (int byte; count < srclen && (byte = fgetc(m_stream.get())) != EOF; ) {
-        if (str.size() < ysfx_string_max_length)
-            str.push_back((unsigned char)byte);
-        ++count;
+    while (count < srclen) {
+        const uint8_t *bytes = m_source.read(srclen - count, &n);
+        if (n == 0)
+            break;
+        size_t room = ysfx_string_max_length - str.size();
+        str.append((const char *)bytes, (n < room) ? n : room);
+        count += (uint32_t)n;
     }
     return count;
 }
@@ -121,139 +225,206 @@ uint32_t ysfx_raw_file_t::string(std::string &str)
 //------------------------------------------------------------------------------
 ysfx_text_file_t::ysfx_text_file_t(NSEEL_VMCTX vm, const char *filename)
     : m_vm(vm),
-      m_stream(ysfx::fopen_utf8(filename, "rb"))
+      m_source(filename)
 {
     m_buf.reserve(256);
 }
 
 int32_t ysfx_text_file_t::avail()
 {
-    if (!m_stream || ferror(m_stream.get()))
+    if (!m_source.is_open())
         return -1;
 
-    return (feof(m_stream.get()) == 0) ? 0 : 1;
+    return m_eof ? 1 : 0;
 }
 
 void ysfx_text_file_t::rewind()
 {
-    if (!m_stream)
-        return;
-
-    ::rewind(m_stream.get());
+    m_source.rewind();
+    m_eof = false;
 }
 
 bool ysfx_text_file_t::var(ysfx_real *var)
 {
-    if (!m_stream)
+    if (!m_source.is_open())
         return false;
 
     //TODO support the expression language for arithmetic
 
-    int ch;
-    do {
-        // get the next number separated by newline or comma
-        // but skip invalid lines
-        m_buf.clear();
-        while ((ch = fgetc(m_stream.get())) != EOF && ch != '\n' && ch != ',')
-            m_buf.push_back((unsigned char)ch);
-        const char *startp = m_buf.c_str();
-        const char *endp = (char *)startp;
-        double value = ysfx::dot_strtod(startp, (char **)&endp);
-        if (endp != startp) {
+    // get the next number separated by newline or comma
+    // but skip invalid lines
+    m_buf.clear();
+    for (;;) {
+        size_t size;
+        const char *data = (const char *)m_source.peek(1, &size);
+        if (size == 0)
+            m_eof = true;
+
+        const char *end = data + size;
+        const char *delim = data;
+        while (delim != end && *delim != '\n' && *delim != ',')
+            ++delim;
+
+        if (delim == end && !m_eof) {
+            // the field continues after the buffered data
+            m_buf.append(data, size);
+            m_source.skip(size);
+            continue;
+        }
+
+        const char *field = data;
+        const char *field_end = delim;
+        if (!m_buf.empty()) {
+            m_buf.append(data, (size_t)(delim - data));
+            field = m_buf.data();
+            field_end = field + m_buf.size();
+        }
+
+        const char *endp = field;
+        double value = ysfx::dot_strtod_range(field, field_end, &endp);
+        bool valid = endp != field;
+
+        if (!m_eof)
+            m_source.skip((size_t)(delim - data) + 1);
+
+        if (valid) {
             *var = (EEL_F)value;
             return true;
         }
-    } while (ch != EOF);
+        if (m_eof)
+            return false;
 
-    return false;
+        m_buf.clear();
+    }
 }
 
 uint32_t ysfx_text_file_t::mem(uint32_t offset, uint32_t length)
 {
-    if (!m_stream)
+    if (!m_source.is_open())
         return 0;
 
     ysfx_eel_ram_writer writer{m_vm, offset};
 
-    uint32_t read;
-    for (read = 0; read < length; ++read) {
-        ysfx_real value;
-        if (!var(&value))
+    uint32_t count = 0;
+    while (count < length) {
+        uint32_t n;
+        EEL_F *span = writer.write_span(length - count, &n);
+        uint32_t done = 0;
+        for (ysfx_real value; done < n && var(&value); ++done) {
+            if (span)
+                span[done] = value;
+        }
+        count += done;
+        if (done < n)
             break;
-        writer.write_next(value);
     }
 
-    return read;
+    return count;
 }
 
 uint32_t ysfx_text_file_t::string(std::string &str)
 {
-    if (!m_stream)
+    if (!m_source.is_open())
         return 0;
 
     str.clear();
     str.reserve(256);
 
-    int ch;
-    do {
-        ch = fgetc(m_stream.get());
-        if (ch != EOF && str.size() < ysfx_string_max_length)
-            str.push_back((unsigned char)ch);
-    } while (ch != EOF && ch != '\n');
+    for (;;) {
+        size_t size;
+        const char *data = (const char *)m_source.peek(1, &size);
+        if (size == 0) {
+            m_eof = true;
+            break;
+        }
+
+        const char *end = data + size;
+        const char *newline = data;
+        while (newline != end && *newline != '\n')
+            ++newline;
+
+        bool found = newline != end;
+        size_t n = (size_t)(newline - data) + found;
+        size_t room = ysfx_string_max_length - str.size();
+        str.append(data, (n < room) ? n : room);
+        m_source.skip(n);
+        if (found)
+            break;
+    }
 
     return (uint32_t)str.size();
 }
 
 //------------------------------------------------------------------------------
-ysfx_audio_file_t::ysfx_audio_file_t(NSEEL_VMCTX vm, const ysfx_audio_format_t &fmt, const char *filename)
+ysfx_audio_file_t::ysfx_audio_file_t(NSEEL_VMCTX vm, const ysfx_audio_format_t &fmt, const char *filename, ysfx_audio_cache_t *cache)
     : m_vm(vm),
       m_fmt(fmt),
-      m_reader(fmt.open(filename), fmt.close)
+      m_reader(nullptr, fmt.close)
 {
+    if (cache)
+        m_head = ysfx_audio_cache_get(cache, fmt, filename);
+
+    if (m_head) {
+        m_info = m_head->info;
+        m_total = m_head->samples.size();
+        return;
+    }
+
+    m_reader.reset(fmt.open(filename));
+    if (m_reader) {
+        m_info = m_fmt.info(m_reader.get());
+        m_total = m_fmt.avail(m_reader.get());
+    }
 }
 
 int32_t ysfx_audio_file_t::avail()
 {
-    if (!m_reader)
+    if (!is_open())
         return -1;
 
-    uint64_t avail = m_fmt.avail(m_reader.get());
+    uint64_t avail = (m_pos < m_total) ? (m_total - m_pos) : 0;
     return (avail > 0x7fffffff) ? 0x7fffffff : (int32_t)avail;
 }
 
 void ysfx_audio_file_t::rewind()
 {
-    if (!m_reader)
+    if (!is_open())
         return;
 
-    m_fmt.rewind(m_reader.get());
+    // the decoder is rewound later, if the reading goes beyond the head
+    m_pos = 0;
 }
 
 bool ysfx_audio_file_t::var(ysfx_real *var)
 {
-    if (!m_reader)
+    if (!is_open())
         return false;
 
-    return m_fmt.read(m_reader.get(), var, 1) == 1;
+    return read(var, 1) == 1;
 }
 
 uint32_t ysfx_audio_file_t::mem(uint32_t offset, uint32_t length)
 {
-    if (!m_reader)
+    if (!is_open())
         return 0;
 
     uint32_t numread = 0;
-    ysfx_real *buf = m_buf.get();
     ysfx_eel_ram_writer writer(m_vm, offset);
 
+    // let the decoder write whole RAM blocks at once
     while (numread < length) {
-        uint32_t n = length - numread;
-        if (n > buffer_size)
-            n = buffer_size;
-
-        uint32_t m = (uint32_t)m_fmt.read(m_reader.get(), buf, n);
-        for (uint32_t i = 0; i < m; ++i)
-            writer.write_next(buf[i]);
+        uint32_t n;
+        ysfx_real *span = writer.write_span(length - numread, &n);
+
+        uint32_t m;
+        if (span)
+            m = (uint32_t)read(span, n);
+        else {
+            // out of the memory range, the values are passed over
+            uint64_t avail = (m_pos < m_total) ? (m_total - m_pos) : 0;
+            m = (uint32_t)std::min<uint64_t>(n, avail);
+            m_pos += m;
+        }
 
         numread += m;
         if (m < n)
@@ -263,6 +434,79 @@ uint32_t ysfx_audio_file_t::mem(uint32_t offset, uint32_t length)
     return numread;
 }
 
+void ysfx_audio_file_t::readahead(uint64_t size)
+{
+    if (!m_reader || m_pos != 0 || m_reader_pos != 0 || m_head)
+        return;
+
+    uint64_t count = size / sizeof(ysfx_real);
+    if (count > m_total)
+        count = m_total;
+    if (count == 0)
+        return;
+
+    std::shared_ptr<ysfx_decoded_audio_t> head{new ysfx_decoded_audio_t};
+    head->info = m_info;
+    head->samples.resize((size_t)count);
+    count = m_fmt.read(m_reader.get(), head->samples.data(), count);
+    head->samples.resize((size_t)count);
+    m_head = std::move(head);
+    m_reader_pos = count;
+}
+
+uint64_t ysfx_audio_file_t::read(ysfx_real *samples, uint64_t count)
+{
+    uint64_t avail = (m_pos < m_total) ? (m_total - m_pos) : 0;
+    if (count > avail)
+        count = avail;
+
+    uint64_t numread = 0;
+
+    uint64_t head = m_head ? m_head->samples.size() : 0;
+    if (m_pos < head) {
+        uint64_t n = head - m_pos;
+        if (n > count)
+            n = count;
+        memcpy(samples, &m_head->samples[(size_t)m_pos], (size_t)n * sizeof(ysfx_real));
+        m_pos += n;
+        samples += n;
+        count -= n;
+        numread += n;
+    }
+
+    if (count > 0 && m_reader && sync_reader()) {
+        uint64_t n = m_fmt.read(m_reader.get(), samples, count);
+        m_pos += n;
+        m_reader_pos += n;
+        numread += n;
+    }
+
+    return numread;
+}
+
+bool ysfx_audio_file_t::sync_reader()
+{
+    if (m_reader_pos == m_pos)
+        return true;
+
+    if (m_reader_pos > m_pos) {
+        m_fmt.rewind(m_reader.get());
+        m_reader_pos = 0;
+    }
+
+    while (m_reader_pos < m_pos) {
+        uint64_t n = m_pos - m_reader_pos;
+        if (n > buffer_size)
+            n = buffer_size;
+        uint64_t m = m_fmt.read(m_reader.get(), m_buf.get(), n);
+        m_reader_pos += m;
+        if (m < n)
+            return false;
+    }
+
+    return true;
+}
+
 uint32_t ysfx_audio_file_t::string(std::string &str)
 {
     (void)str;
@@ -271,12 +515,11 @@ uint32_t ysfx_audio_file_t::string(std::string &str)
 
 bool ysfx_audio_file_t::riff(uint32_t &nch, ysfx_real &samplerate)
 {
-    if (!m_reader)
+    if (!is_open())
         return false;
 
-    ysfx_audio_file_info_t info = m_fmt.info(m_reader.get());
-    nch = info.channels;
-    samplerate = info.sample_rate;
+    nch = m_info.channels;
+    samplerate = m_info.sample_rate;
     return true;
 }
 
@@ -334,24 +577,36 @@ bool ysfx_serializer_t::var(ysfx_real *var)
 
 uint32_t ysfx_serializer_t::mem(uint32_t offset, uint32_t length)
 {
+    // convert the memory a block at a time, rather than by `var`
     if (m_write == 1) {
+        size_t pos = m_buffer->size();
+        m_buffer->resize(pos + 4 * (size_t)length);
+        uint8_t *data = (uint8_t *)&(*m_buffer)[pos];
         ysfx_eel_ram_reader reader{m_vm, offset};
-        for (uint32_t i = 0; i < length; ++i) {
-            ysfx_real value = reader.read_next();
-            if (!var(&value))
-                return i;
+        for (uint32_t i = 0, n; i < length; i += n) {
+            const EEL_F *span = reader.read_span(length - i, &n);
+            if (span)
+                ysfx::pack_f32le_array(span, &data[4 * i], n);
+            else
+                memset(&data[4 * i], 0, 4 * n);
         }
         return length;
     }
     else if (m_write == 0) {
+        uint32_t count = length;
+        bool truncated = (m_buffer->size() - m_pos) / 4 < count;
+        if (truncated)
+            count = (uint32_t)((m_buffer->size() - m_pos) / 4);
+        const uint8_t *data = (const uint8_t *)&(*m_buffer)[m_pos];
         ysfx_eel_ram_writer writer{m_vm, offset};
-        for (uint32_t i = 0; i < length; ++i) {
-            ysfx_real value{};
-            if (!var(&value))
-                return i;
-            writer.write_next(value);
+        for (uint32_t i = 0, n; i < count; i += n) {
+            EEL_F *span = writer.write_span(count - i, &n);
+            if (span)
+                ysfx::unpack_f32le_array(&data[4 * i], span, n);
         }
-        return length;
+        // like `var`, a value which is cut short consumes the rest
+        m_pos = truncated ? m_buffer->size() : (m_pos + 4 * (size_t)count);
+        return count;
     }
     return 0;
 }
@@ -364,6 +619,23 @@ uint32_t ysfx_serializer_t::string(std::string &str)
 }
 
 //------------------------------------------------------------------------------
+ysfx_file_t *ysfx_new_file(NSEEL_VMCTX vm, ysfx_file_type_t type, const ysfx_audio_format_t *fmt, ysfx_audio_cache_t *cache, const char *filename)
+{
+    switch (type) {
+    case ysfx_file_type_txt:
+        return new ysfx_text_file_t(vm, filename);
+    case ysfx_file_type_raw:
+        return new ysfx_raw_file_t(vm, filename);
+    case ysfx_file_type_audio:
+        return new ysfx_audio_file_t(vm, *fmt, filename, cache);
+    case ysfx_file_type_none:
+        return nullptr;
+    default:
+        assert(false);
+        return nullptr;
+    }
+}
+
 static EEL_F NSEEL_CGEN_CALL ysfx_api_file_open(void *opaque, EEL_F *file)
 {
     ysfx_t *fx = (ysfx_t *)opaque;
@@ -386,7 +658,7 @@ static EEL_F NSEEL_CGEN_CALL ysfx_api_file_open(void *opaque, EEL_F *file)
         slider = &fx->source.main->header.sliders[slideridx];
 
     if (slider && !slider->path.empty()) {
-        int32_t value = ysfx_eel_round<int32_t>(*fx->var.slider[slideridx]);
+        int32_t value = ysfx_eel_round<int32_t>(fx->var.slider[slideridx]);
         if (value < 0 || (uint32_t)value >= slider->enum_names.size())
             return -1;
 
@@ -422,20 +694,26 @@ static EEL_F NSEEL_CGEN_CALL ysfx_api_file_open(void *opaque, EEL_F *file)
         ysfx_file_type_t ftype = ysfx_detect_file_type(fx, filepath.c_str(), &fmtobj);
 
         ysfx_file_u file;
-        switch (ftype) {
-        case ysfx_file_type_txt:
-            file.reset(new ysfx_text_file_t(fx->vm.get(), filepath.c_str()));
-            break;
-        case ysfx_file_type_raw:
-            file.reset(new ysfx_raw_file_t(fx->vm.get(), filepath.c_str()));
-            break;
-        case ysfx_file_type_audio:
-            file.reset(new ysfx_audio_file_t(fx->vm.get(), *(ysfx_audio_format_t *)fmtobj, filepath.c_str()));
-            break;
-        case ysfx_file_type_none:
-            break;
-        default:
-            assert(false);
+        if (ftype != ysfx_file_type_none) {
+            ysfx_prefetcher_t *prefetcher = fx->config->prefetcher.get();
+            if (!prefetcher)
+                file.reset(ysfx_new_file(fx->vm.get(), ftype, (ysfx_audio_format_t *)fmtobj, fx->config->audio_cache.get(), filepath.c_str()));
+            else {
+                // let the prefetch thread open the file, and give a handle to it already
+                std::shared_ptr<ysfx_prefetch_job_t> job{new ysfx_prefetch_job_t};
+                job->vm = fx->vm.get();
+                job->type = ftype;
+                if (fmtobj)
+                    job->fmt = *(ysfx_audio_format_t *)fmtobj;
+                // the job keeps the cache, which the configuration can replace meanwhile
+                ysfx_audio_cache_t *cache = fx->config->audio_cache.get();
+                if (cache)
+                    ysfx_audio_cache_add_ref(cache);
+                job->audio_cache.reset(cache);
+                job->path = filepath;
+                file.reset(new ysfx_prefetched_file_t(job));
+                ysfx_prefetcher_submit(prefetcher, std::move(job));
+            }
         }
 
         if (file) {
@@ -469,6 +747,7 @@ static EEL_F NSEEL_CGEN_CALL ysfx_api_file_close(void *opaque, EEL_F *handle_)
     file_mutex = std::move(fx->file.list[(uint32_t)handle]->m_mutex);
 
     fx->file.list[(uint32_t)handle].reset();
+    ysfx_count<uint32_t>(fx->counters.open_files, (uint32_t)-1);
     return 0;
 }
 
@@ -18,11 +18,19 @@
 #pragma once
 #include "ysfx.h"
 #include "ysfx_utils.hpp"
+#include "ysfx_audio_cache.hpp"
 #include "WDL/eel2/ns-eel.h"
 #include "WDL/eel2/ns-eel-int.h"
 #include <vector>
 #include <memory>
 
+enum ysfx_file_type_t {
+    ysfx_file_type_none,
+    ysfx_file_type_txt,
+    ysfx_file_type_raw,
+    ysfx_file_type_audio,
+};
+
 struct ysfx_file_t {
     virtual ~ysfx_file_t() {}
 
@@ -34,12 +42,55 @@ struct ysfx_file_t {
     virtual bool riff(uint32_t &nch, ysfx_real &samplerate) = 0;
     virtual bool is_text() = 0;
     virtual bool is_in_write_mode() = 0;
+    // whether the file was opened successfully
+    virtual bool is_open() = 0;
+    // read in advance the beginning of the file, up to the given size in bytes
+    virtual void readahead(uint64_t size) { (void)size; }
 
     std::unique_ptr<ysfx::mutex> m_mutex{new ysfx::mutex};
 };
 
 using ysfx_file_u = std::unique_ptr<ysfx_file_t>;
 
+// open a file for reading, as the given type; audio is decoded through the cache, if any
+ysfx_file_t *ysfx_new_file(NSEEL_VMCTX vm, ysfx_file_type_t type, const ysfx_audio_format_t *fmt, ysfx_audio_cache_t *cache, const char *filename);
+
+//------------------------------------------------------------------------------
+
+// sequential access to the bytes of a file, memory-mapped if possible
+struct ysfx_file_source_t {
+    explicit ysfx_file_source_t(const char *filename);
+    ~ysfx_file_source_t();
+
+    bool is_open() const { return m_stream != nullptr; }
+    // file size, measured when opening
+    uint64_t size() const { return m_size; }
+    // current read position
+    uint64_t position() const { return m_pos; }
+
+    // get the contiguous bytes at the current position, at least `count` unless the end is reached
+    const uint8_t *peek(size_t count, size_t *avail);
+    // advance by `count` bytes, which must have been peeked
+    void skip(size_t count);
+    // get up to `count` contiguous bytes at the current position, and advance
+    const uint8_t *read(size_t count, size_t *read_count);
+    void rewind();
+    // bring the beginning of the file into memory
+    void readahead(uint64_t size);
+
+    ysfx::FILE_u m_stream;
+    uint64_t m_size = 0;
+    uint64_t m_pos = 0;
+    // memory mapping of the file, if it succeeded
+    ysfx::file_mapping_t m_map;
+    bool m_mapped = false;
+    // otherwise, the file is read in large blocks into this buffer
+    enum { buffer_size = 64 * 1024 };
+    std::unique_ptr<uint8_t[]> m_buf;
+    size_t m_buf_pos = 0;
+    size_t m_buf_fill = 0;
+};
+
 //------------------------------------------------------------------------------
 
 struct ysfx_raw_file_t final : ysfx_file_t {
@@ -53,9 +104,11 @@ struct ysfx_raw_file_t final : ysfx_file_t {
     bool riff(uint32_t &, ysfx_real &) override { return false; }
     bool is_text() override { return false; }
     bool is_in_write_mode() override { return false; }
+    bool is_open() override { return m_source.is_open(); }
+    void readahead(uint64_t size) override { m_source.readahead(size); }
 
     NSEEL_VMCTX m_vm = nullptr;
-    ysfx::FILE_u m_stream;
+    ysfx_file_source_t m_source;
 };
 
 //------------------------------------------------------------------------------
@@ -71,16 +124,20 @@ struct ysfx_text_file_t final : ysfx_file_t {
     bool riff(uint32_t &, ysfx_real &) override { return false; }
     bool is_text() override { return true; }
     bool is_in_write_mode() override { return false; }
+    bool is_open() override { return m_source.is_open(); }
+    void readahead(uint64_t size) override { m_source.readahead(size); }
 
     NSEEL_VMCTX m_vm = nullptr;
-    ysfx::FILE_u m_stream;
+    ysfx_file_source_t m_source;
+    bool m_eof = false;
+    // holds a field which spans across buffer refills
     std::string m_buf;
 };
 
 //------------------------------------------------------------------------------
 
 struct ysfx_audio_file_t final : ysfx_file_t {
-    ysfx_audio_file_t(NSEEL_VMCTX vm, const ysfx_audio_format_t &fmt, const char *filename);
+    ysfx_audio_file_t(NSEEL_VMCTX vm, const ysfx_audio_format_t &fmt, const char *filename, ysfx_audio_cache_t *cache = nullptr);
 
     int32_t avail() override;
     void rewind() override;
@@ -90,10 +147,26 @@ struct ysfx_audio_file_t final : ysfx_file_t {
     bool riff(uint32_t &nch, ysfx_real &samplerate) override;
     bool is_text() override { return false; }
     bool is_in_write_mode() override { return false; }
+    bool is_open() override { return m_reader || m_head; }
+    void readahead(uint64_t size) override;
+
+    // read the next samples, from those read ahead first, then from the decoder
+    uint64_t read(ysfx_real *samples, uint64_t count);
+    // bring the decoder to the current position, after a rewind
+    bool sync_reader();
 
     NSEEL_VMCTX m_vm = nullptr;
     ysfx_audio_format_t m_fmt{};
     std::unique_ptr<ysfx_audio_reader_t, void (*)(ysfx_audio_reader_t *)> m_reader;
+    ysfx_audio_file_info_t m_info{};
+    // total number of samples, and current position
+    uint64_t m_total = 0;
+    uint64_t m_pos = 0;
+    // position of the decoder, which can lag behind after a rewind
+    uint64_t m_reader_pos = 0;
+    // the samples at the beginning, which were decoded ahead, or the whole
+    // file shared by the cache, in which case there is no decoder
+    std::shared_ptr<const ysfx_decoded_audio_t> m_head;
     enum { buffer_size = 256 };
     std::unique_ptr<ysfx_real[]> m_buf{new ysfx_real[buffer_size]};
 };
@@ -114,6 +187,7 @@ struct ysfx_serializer_t final : ysfx_file_t {
     bool riff(uint32_t &, ysfx_real &) override { return false; }
     bool is_text() override { return false; }
     bool is_in_write_mode() override { return m_write == 1; }
+    bool is_open() override { return true; }
 
     NSEEL_VMCTX m_vm{};
     int m_write = -1;
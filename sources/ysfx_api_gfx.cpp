@@ -34,6 +34,8 @@ struct ysfx_gfx_state_t {
     LICE_WrapperBitmap framebuffer{nullptr, 0, 0, 0, false};
     std::vector<std::unique_ptr<LICE_IBitmap>> images;
     ysfx_real scale = 0.0;
+    // the size of the images, which other threads can read
+    std::atomic<uint64_t> image_memory{0};
 };
 
 ysfx_gfx_state_t *ysfx_gfx_state_new()
@@ -73,6 +75,21 @@ bool ysfx_gfx_state_is_dirty(ysfx_gfx_state_t *state)
     return state->framebuffer_dirty;
 }
 
+void ysfx_gfx_state_update_image_memory(ysfx_gfx_state_t *state)
+{
+    uint64_t size = 0;
+    for (const std::unique_ptr<LICE_IBitmap> &image : state->images) {
+        if (image)
+            size += (uint64_t)image->getRowSpan() * (uint32_t)image->getHeight() * sizeof(LICE_pixel);
+    }
+    state->image_memory.store(size, std::memory_order_relaxed);
+}
+
+uint64_t ysfx_gfx_state_get_image_memory(ysfx_gfx_state_t *state)
+{
+    return state->image_memory.load(std::memory_order_relaxed);
+}
+
 //------------------------------------------------------------------------------
 void ysfx_gfx_enter(ysfx_t *fx, bool doinit)
 {
@@ -52,7 +52,7 @@ static EEL_F *NSEEL_CGEN_CALL ysfx_api_slider(void *opaque, EEL_F *n_)
     }
 
     n -= 1;
-    return fx->var.slider[(uint32_t)n];
+    return &fx->var.slider[(uint32_t)n];
 }
 
 static EEL_F NSEEL_CGEN_CALL ysfx_api_slider_next_chg(void *opaque, EEL_F *index_, EEL_F *val_)
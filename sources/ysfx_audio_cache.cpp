@@ -0,0 +1,150 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+#include "ysfx_audio_cache.hpp"
+#include <chrono>
+#include <new>
+
+ysfx_audio_cache_t *ysfx_audio_cache_new(uint64_t capacity)
+{
+    ysfx_audio_cache_t *cache = new ysfx_audio_cache_t;
+    cache->capacity = capacity;
+    return cache;
+}
+
+void ysfx_audio_cache_free(ysfx_audio_cache_t *cache)
+{
+    if (!cache)
+        return;
+
+    if (cache->ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete cache;
+}
+
+void ysfx_audio_cache_add_ref(ysfx_audio_cache_t *cache)
+{
+    cache->ref_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t ysfx_audio_cache_get_size(ysfx_audio_cache_t *cache)
+{
+    std::lock_guard<ysfx::mutex> lock{cache->mutex};
+    return cache->size;
+}
+
+static std::shared_ptr<const ysfx_decoded_audio_t> ysfx_audio_cache_decode(const ysfx_audio_format_t &fmt, const char *path, uint64_t capacity)
+{
+    std::unique_ptr<ysfx_audio_reader_t, void (*)(ysfx_audio_reader_t *)> reader{fmt.open(path), fmt.close};
+    if (!reader)
+        return nullptr;
+
+    uint64_t count = fmt.avail(reader.get());
+    if (count > capacity / sizeof(ysfx_real))
+        return nullptr;
+
+    std::shared_ptr<ysfx_decoded_audio_t> data;
+    try {
+        data.reset(new ysfx_decoded_audio_t);
+        data->samples.resize((size_t)count);
+    }
+    catch (std::bad_alloc &) {
+        return nullptr;
+    }
+
+    data->info = fmt.info(reader.get());
+    count = fmt.read(reader.get(), data->samples.data(), count);
+    data->samples.resize((size_t)count);
+    return data;
+}
+
+static void ysfx_audio_cache_erase(ysfx_audio_cache_t *cache, std::list<ysfx_audio_cache_t::entry_t>::iterator it)
+{
+    cache->size -= it->size;
+    cache->index.erase(it->uid);
+    cache->entries.erase(it);
+}
+
+std::shared_ptr<const ysfx_decoded_audio_t> ysfx_audio_cache_get(ysfx_audio_cache_t *cache, const ysfx_audio_format_t &fmt, const char *path)
+{
+    using entry_t = ysfx_audio_cache_t::entry_t;
+
+    ysfx::file_uid uid;
+    ysfx::file_stat_t stat;
+    if (!ysfx::get_file_uid(path, uid) || !ysfx::get_file_stat(path, stat))
+        return nullptr;
+
+    std::promise<std::shared_ptr<const ysfx_decoded_audio_t>> promise;
+    uint64_t id;
+
+    std::unique_lock<ysfx::mutex> lock{cache->mutex};
+
+    auto found = cache->index.find(uid);
+    if (found != cache->index.end()) {
+        std::list<entry_t>::iterator it = found->second;
+        if (it->stat == stat) {
+            // it's the most recently used now
+            cache->entries.splice(cache->entries.begin(), cache->entries, it);
+            std::shared_future<std::shared_ptr<const ysfx_decoded_audio_t>> data = it->data;
+            lock.unlock();
+            // if another caller is decoding, do not wait for it, the caller
+            // can read the file by itself in the meantime
+            if (data.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                return nullptr;
+            return data.get();
+        }
+        // the file has changed
+        ysfx_audio_cache_erase(cache, it);
+    }
+
+    id = ++cache->next_id;
+    entry_t entry;
+    entry.id = id;
+    entry.uid = uid;
+    entry.stat = stat;
+    entry.data = promise.get_future().share();
+    cache->entries.push_front(std::move(entry));
+    cache->index[uid] = cache->entries.begin();
+
+    lock.unlock();
+    std::shared_ptr<const ysfx_decoded_audio_t> data = ysfx_audio_cache_decode(fmt, path, cache->capacity);
+    promise.set_value(data);
+    lock.lock();
+
+    found = cache->index.find(uid);
+    if (found == cache->index.end() || found->second->id != id)
+        return data;
+
+    std::list<entry_t>::iterator it = found->second;
+    if (!data) {
+        ysfx_audio_cache_erase(cache, it);
+        return data;
+    }
+
+    it->size = sizeof(ysfx_decoded_audio_t) + data->samples.size() * sizeof(ysfx_real);
+    cache->size += it->size;
+
+    // drop the least recently used, except the entries still decoding
+    std::list<entry_t>::iterator pos = cache->entries.end();
+    while (cache->size > cache->capacity && pos != cache->entries.begin()) {
+        --pos;
+        if (pos->size == 0 || pos == it)
+            continue;
+        std::list<entry_t>::iterator victim = pos++;
+        ysfx_audio_cache_erase(cache, victim);
+    }
+
+    return data;
+}
@@ -0,0 +1,63 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+#pragma once
+#include "ysfx.h"
+#include "ysfx_utils.hpp"
+#include <vector>
+#include <list>
+#include <map>
+#include <memory>
+#include <future>
+#include <atomic>
+
+// The samples of an audio file, entirely decoded.
+struct ysfx_decoded_audio_t {
+    ysfx_audio_file_info_t info{};
+    std::vector<ysfx_real> samples;
+};
+
+// A cache of decoded audio files, which the effects share read-only. A file is
+// identified by its unique ID, and it's decoded again if its size or its
+// modification time change. The least recently used files are dropped when
+// the cache exceeds its capacity; the effects still using them keep them.
+struct ysfx_audio_cache_s {
+    struct entry_t {
+        uint64_t id = 0;
+        ysfx::file_uid uid;
+        ysfx::file_stat_t stat;
+        // the decoded file, available once decoding has finished
+        std::shared_future<std::shared_ptr<const ysfx_decoded_audio_t>> data;
+        // the size in bytes, or 0 while decoding
+        uint64_t size = 0;
+    };
+
+    uint64_t capacity = 0;
+    std::atomic<uint32_t> ref_count{1};
+    ysfx::mutex mutex;
+    // the entries, from the most to the least recently used
+    std::list<entry_t> entries;
+    std::map<ysfx::file_uid, std::list<entry_t>::iterator> index;
+    uint64_t size = 0;
+    uint64_t next_id = 0;
+};
+
+void ysfx_audio_cache_add_ref(ysfx_audio_cache_t *cache);
+
+// get the decoded file, which is decoded once by the first of the callers;
+//     null if it cannot be decoded, if it's larger than the capacity, or if
+//     another caller is decoding it still
+std::shared_ptr<const ysfx_decoded_audio_t> ysfx_audio_cache_get(ysfx_audio_cache_t *cache, const ysfx_audio_format_t &fmt, const char *path);
@@ -131,8 +131,7 @@ static uint64_t ysfx_wav_read(ysfx_audio_reader_t *reader_, ysfx_real *samples,
         uint64_t readframes = drwav_read_pcm_frames_f32(reader->wav.get(), count / channels, f32buf);
         uint64_t readsamples = channels * readframes;
         // f32->f64
-        for (uint64_t i = readsamples; i-- > 0; )
-            samples[i] = f32buf[i];
+        ysfx::widen_f32_array_inplace(samples, (size_t)readsamples);
         samples += readsamples;
         count -= readsamples;
         readtotal += readsamples;
@@ -19,6 +19,8 @@
 #include "ysfx_utils.hpp"
 #include "ysfx_audio_wav.hpp"
 #include "ysfx_audio_flac.hpp"
+#include "WDL/eel2/ns-eel.h"
+#include <chrono>
 #include <cassert>
 
 ysfx_config_t *ysfx_config_new()
@@ -26,10 +28,15 @@ ysfx_config_t *ysfx_config_new()
     return new ysfx_config_t;
 }
 
+static void ysfx_stop_async_logging(ysfx_config_t *config);
+
 void ysfx_config_free(ysfx_config_t *config)
 {
-    if (config->ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    if (config->ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        ysfx_stop_async_logging(config);
+        config->prefetcher.reset();
         delete config;
+    }
 }
 
 void ysfx_config_add_ref(ysfx_config_t *config)
@@ -115,6 +122,47 @@ void ysfx_set_user_data(ysfx_config_t *config, intptr_t userdata)
     config->userdata = userdata;
 }
 
+//------------------------------------------------------------------------------
+// The registry is global, since the effects which share the memory are
+// usually in separate instances of a plugin, each with its configuration.
+struct ysfx_gmem_registry_t {
+    ysfx::mutex mutex;
+    std::map<std::string, std::unique_ptr<ysfx_gmem_t>> gmem;
+};
+
+static ysfx_gmem_registry_t &ysfx_gmem_get_registry()
+{
+    // never destroyed, so the effects can release the memory late at exit
+    static ysfx_gmem_registry_t *registry = new ysfx_gmem_registry_t;
+    return *registry;
+}
+
+ysfx_gmem_t *ysfx_gmem_acquire(const std::string &name)
+{
+    ysfx_gmem_registry_t &registry = ysfx_gmem_get_registry();
+    std::lock_guard<ysfx::mutex> lock{registry.mutex};
+
+    std::unique_ptr<ysfx_gmem_t> &gmem = registry.gmem[name];
+    if (!gmem) {
+        gmem.reset(new ysfx_gmem_t);
+        gmem->name = name;
+    }
+
+    ++gmem->ref_count;
+    return gmem.get();
+}
+
+void ysfx_gmem_release(ysfx_gmem_t *gmem)
+{
+    ysfx_gmem_registry_t &registry = ysfx_gmem_get_registry();
+    std::lock_guard<ysfx::mutex> lock{registry.mutex};
+
+    if (--gmem->ref_count == 0) {
+        NSEEL_VM_FreeGRAM(&gmem->gram);
+        registry.gmem.erase(gmem->name);
+    }
+}
+
 //------------------------------------------------------------------------------
 const char *ysfx_log_level_string(ysfx_log_level level)
 {
@@ -131,7 +179,106 @@ const char *ysfx_log_level_string(ysfx_log_level level)
     }
 }
 
+void ysfx_set_async_logging(ysfx_config_t *config, uint32_t capacity, bool background)
+{
+    ysfx_stop_async_logging(config);
+
+    if (capacity == 0)
+        return;
+
+    config->log_queue.reset(ysfx_log_queue_new(capacity));
+
+    if (background) {
+        config->log_worker.stop = false;
+        config->log_worker.thread = std::thread([config]() {
+            // the producers never wake this thread, which would make them
+            // enter the kernel; it polls the queue instead
+            const std::chrono::milliseconds interval{50};
+            std::unique_lock<std::mutex> lock{config->log_worker.mutex};
+            while (!config->log_worker.stop) {
+                lock.unlock();
+                ysfx_drain_logs(config);
+                lock.lock();
+                config->log_worker.cond.wait_for(lock, interval, [config]() { return config->log_worker.stop; });
+            }
+        });
+    }
+}
+
+static void ysfx_stop_async_logging(ysfx_config_t *config)
+{
+    if (config->log_worker.thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock{config->log_worker.mutex};
+            config->log_worker.stop = true;
+        }
+        config->log_worker.cond.notify_one();
+        config->log_worker.thread.join();
+    }
+
+    if (config->log_queue) {
+        ysfx_drain_logs(config);
+        config->log_queue.reset();
+    }
+}
+
+uint32_t ysfx_drain_logs(ysfx_config_t *config)
+{
+    ysfx_log_queue_t *queue = config->log_queue.get();
+    if (!queue)
+        return 0;
+
+    uint32_t count = 0;
+    ysfx_log_level level;
+    char message[ysfx_log_message_max];
+    while (ysfx_log_queue_pop(queue, &level, message)) {
+        ysfx_log_report(*config, level, message);
+        ++count;
+    }
+    return count;
+}
+
+uint64_t ysfx_get_dropped_logs(ysfx_config_t *config)
+{
+    ysfx_log_queue_t *queue = config->log_queue.get();
+    if (!queue)
+        return 0;
+    return queue->dropped.load(std::memory_order_relaxed);
+}
+
+void ysfx_set_file_prefetch(ysfx_config_t *config, uint64_t readahead)
+{
+    config->prefetcher.reset();
+
+    if (readahead == 0)
+        return;
+
+    config->prefetcher.reset(ysfx_prefetcher_new(readahead));
+}
+
+void ysfx_wait_file_prefetch(ysfx_config_t *config)
+{
+    ysfx_prefetcher_t *prefetcher = config->prefetcher.get();
+    if (prefetcher)
+        ysfx_prefetcher_wait(prefetcher);
+}
+
+void ysfx_set_audio_cache(ysfx_config_t *config, ysfx_audio_cache_t *cache)
+{
+    if (cache)
+        ysfx_audio_cache_add_ref(cache);
+    config->audio_cache.reset(cache);
+}
+
 void ysfx_log(ysfx_config_t &conf, ysfx_log_level level, const char *message)
+{
+    if (conf.log_queue)
+        ysfx_log_queue_push(conf.log_queue.get(), level, message);
+    else
+        ysfx_log_report(conf, level, message);
+}
+
+void ysfx_log_report(ysfx_config_t &conf, ysfx_log_level level, const char *message)
 {
     if (conf.log_reporter)
         conf.log_reporter(conf.userdata, level, message);
@@ -141,7 +288,7 @@ void ysfx_log(ysfx_config_t &conf, ysfx_log_level level, const char *message)
 
 void ysfx_logfv(ysfx_config_t &conf, ysfx_log_level level, const char *format, va_list ap)
 {
-    char buf[256];
+    char buf[ysfx_log_message_max];
     vsnprintf(buf, sizeof(buf), format, ap);
     buf[sizeof(buf)-1] = '\0';
     ysfx_log(conf, level, buf);
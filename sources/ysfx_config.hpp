@@ -17,11 +17,32 @@
 
 #pragma once
 #include "ysfx.h"
+#include "ysfx_utils.hpp"
+#include "ysfx_log.hpp"
+#include "ysfx_prefetch.hpp"
+#include "ysfx_audio_cache.hpp"
 #include <vector>
 #include <string>
+#include <map>
+#include <memory>
 #include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <cstdarg>
 
+// the named global memory `gmem[]`, shared by the effects of the process
+struct ysfx_gmem_t {
+    std::string name;
+    // the EEL2 block table, as managed by `NSEEL_VM_SetGRAM`
+    void *gram = nullptr;
+    uint32_t ref_count = 0;
+};
+
+ysfx_gmem_t *ysfx_gmem_acquire(const std::string &name);
+void ysfx_gmem_release(ysfx_gmem_t *gmem);
+YSFX_DEFINE_AUTO_PTR(ysfx_gmem_u, ysfx_gmem_t, ysfx_gmem_release);
+
 struct ysfx_config_s {
     std::string import_root;
     std::string data_root;
@@ -29,11 +50,24 @@ struct ysfx_config_s {
     ysfx_log_reporter *log_reporter = nullptr;
     intptr_t userdata = 0;
     std::atomic<uint32_t> ref_count{1};
+    // the messages waiting to be reported, if logging is asynchronous
+    ysfx_log_queue_u log_queue;
+    struct {
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable cond;
+        bool stop = false;
+    } log_worker;
+    // the decoded audio files, possibly shared with other configurations
+    ysfx_audio_cache_u audio_cache;
+    // the thread which opens the files of effects, if prefetching
+    ysfx_prefetcher_u prefetcher;
 };
 
 void ysfx_config_add_ref(ysfx_config_t *config);
 
 void ysfx_log(ysfx_config_t &conf, ysfx_log_level level, const char *message);
+void ysfx_log_report(ysfx_config_t &conf, ysfx_log_level level, const char *message);
 void ysfx_logfv(ysfx_config_t &conf, ysfx_log_level level, const char *format, va_list ap);
 #if defined(__GNUC__)
 __attribute__((format(printf, 3, 4)))
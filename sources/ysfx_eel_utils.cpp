@@ -16,7 +16,46 @@
 //
 
 #include "ysfx_eel_utils.hpp"
+#include "ysfx_ram.hpp"
+#include <algorithm>
+#include <cstring>
 
+void ysfx_eel_ram_copy(NSEEL_VMCTX dst, NSEEL_VMCTX src)
+{
+    compileContext *src_ctx = (compileContext *)src;
+    compileContext *dst_ctx = (compileContext *)dst;
+
+    // the blocks beyond both extents are unused by either
+    uint32_t extent = std::max(ysfx_ram_get_extent(src), ysfx_ram_get_extent(dst));
+
+    for (uint32_t i = 0; i < extent; ++i) {
+        const EEL_F *src_block = src_ctx->ram_state->blocks[i];
+        if (!src_block) {
+            EEL_F *dst_block = dst_ctx->ram_state->blocks[i];
+            if (dst_block)
+                memset(dst_block, 0, NSEEL_RAM_ITEMSPERBLOCK * sizeof(EEL_F));
+            continue;
+        }
+        int32_t avail = 0;
+        EEL_F *dst_block = NSEEL_VM_getramptr(dst, i * NSEEL_RAM_ITEMSPERBLOCK, &avail);
+        if (dst_block && avail >= NSEEL_RAM_ITEMSPERBLOCK)
+            memcpy(dst_block, src_block, NSEEL_RAM_ITEMSPERBLOCK * sizeof(EEL_F));
+    }
+}
+
+//------------------------------------------------------------------------------
+// get the number of values from the address to the next block, or to the start
+// of the memory; these have no storage if the block at the address has none
+static uint32_t ysfx_eel_ram_gap(int64_t addr)
+{
+    if (addr < 0)
+        return (uint32_t)std::min<int64_t>(-addr, 0xFFFFFFFFu);
+    if (addr >= (int64_t)NSEEL_RAM_BLOCKS * NSEEL_RAM_ITEMSPERBLOCK)
+        return 0xFFFFFFFFu;
+    return NSEEL_RAM_ITEMSPERBLOCK - (uint32_t)(addr % NSEEL_RAM_ITEMSPERBLOCK);
+}
+
+//------------------------------------------------------------------------------
 ysfx_eel_ram_reader::ysfx_eel_ram_reader(NSEEL_VMCTX vm, int64_t addr)
     : m_vm(vm),
       m_addr(addr)
@@ -25,21 +64,54 @@ ysfx_eel_ram_reader::ysfx_eel_ram_reader(NSEEL_VMCTX vm, int64_t addr)
 
 EEL_F ysfx_eel_ram_reader::read_next()
 {
-    if (m_block_avail == 0) {
-        m_block = (m_addr < 0 || m_addr > 0xFFFFFFFFu) ? nullptr :
-            NSEEL_VM_getramptr_noalloc(m_vm, (uint32_t)m_addr, (int32_t *)&m_block_avail);
-        if (m_block)
-            m_addr += m_block_avail;
-        else {
-            m_addr += 1;
-            m_block_avail = 1;
-        }
-    }
+    if (m_block_avail == 0)
+        next_block();
     EEL_F value = m_block ? *m_block++ : 0;
     m_block_avail -= 1;
     return value;
 }
 
+void ysfx_eel_ram_reader::read_array(EEL_F *dest, uint32_t count)
+{
+    while (count > 0) {
+        if (m_block_avail == 0)
+            next_block();
+        uint32_t n = (count < m_block_avail) ? count : m_block_avail;
+        if (m_block) {
+            memcpy(dest, m_block, n * sizeof(EEL_F));
+            m_block += n;
+        }
+        else
+            memset(dest, 0, n * sizeof(EEL_F));
+        m_block_avail -= n;
+        dest += n;
+        count -= n;
+    }
+}
+
+const EEL_F *ysfx_eel_ram_reader::read_span(uint32_t count, uint32_t *span_count)
+{
+    if (m_block_avail == 0)
+        next_block();
+    uint32_t n = (count < m_block_avail) ? count : m_block_avail;
+    const EEL_F *span = m_block;
+    if (m_block)
+        m_block += n;
+    m_block_avail -= n;
+    *span_count = n;
+    return span;
+}
+
+void ysfx_eel_ram_reader::next_block()
+{
+    m_block = (m_addr < 0 || m_addr > 0xFFFFFFFFu) ? nullptr :
+        NSEEL_VM_getramptr_noalloc(m_vm, (uint32_t)m_addr, (int32_t *)&m_block_avail);
+    // a block without storage is passed over whole
+    if (!m_block)
+        m_block_avail = ysfx_eel_ram_gap(m_addr);
+    m_addr += m_block_avail;
+}
+
 //------------------------------------------------------------------------------
 ysfx_eel_ram_writer::ysfx_eel_ram_writer(NSEEL_VMCTX vm, int64_t addr)
     : m_vm(vm),
@@ -49,18 +121,52 @@ ysfx_eel_ram_writer::ysfx_eel_ram_writer(NSEEL_VMCTX vm, int64_t addr)
 
 bool ysfx_eel_ram_writer::write_next(EEL_F value)
 {
-    if (m_block_avail == 0) {
-        m_block = (m_addr < 0 || m_addr > 0xFFFFFFFFu) ? nullptr :
-            NSEEL_VM_getramptr(m_vm, (uint32_t)m_addr, (int32_t *)&m_block_avail);
-        if (m_block)
-            m_addr += m_block_avail;
-        else {
-            m_addr += 1;
-            m_block_avail = 1;
-        }
-    }
+    if (m_block_avail == 0)
+        next_block();
     if (m_block)
         *m_block++ = value;
     m_block_avail -= 1;
     return true;
 }
+
+uint32_t ysfx_eel_ram_writer::write_array(const EEL_F *src, uint32_t count)
+{
+    uint32_t written = 0;
+    while (count > 0) {
+        if (m_block_avail == 0)
+            next_block();
+        uint32_t n = (count < m_block_avail) ? count : m_block_avail;
+        if (m_block) {
+            memcpy(m_block, src, n * sizeof(EEL_F));
+            m_block += n;
+            written += n;
+        }
+        m_block_avail -= n;
+        src += n;
+        count -= n;
+    }
+    return written;
+}
+
+EEL_F *ysfx_eel_ram_writer::write_span(uint32_t count, uint32_t *span_count)
+{
+    if (m_block_avail == 0)
+        next_block();
+    uint32_t n = (count < m_block_avail) ? count : m_block_avail;
+    EEL_F *span = m_block;
+    if (m_block)
+        m_block += n;
+    m_block_avail -= n;
+    *span_count = n;
+    return span;
+}
+
+void ysfx_eel_ram_writer::next_block()
+{
+    m_block = (m_addr < 0 || m_addr > 0xFFFFFFFFu) ? nullptr :
+        NSEEL_VM_getramptr(m_vm, (uint32_t)m_addr, (int32_t *)&m_block_avail);
+    // a block without storage is passed over whole
+    if (!m_block)
+        m_block_avail = ysfx_eel_ram_gap(m_addr);
+    m_addr += m_block_avail;
+}
@@ -28,12 +28,24 @@ ysfx_eel_round(EEL_F value)
     return (T)(value + (EEL_F)0.0001); // same one as used in eel2 everywhere
 }
 
+//------------------------------------------------------------------------------
+// copy the contents of all the RAM blocks which are allocated in the source,
+// and clear the blocks of the destination which are not
+void ysfx_eel_ram_copy(NSEEL_VMCTX dst, NSEEL_VMCTX src);
+
 //------------------------------------------------------------------------------
 class ysfx_eel_ram_reader {
 public:
     ysfx_eel_ram_reader() = default;
     ysfx_eel_ram_reader(NSEEL_VMCTX vm, int64_t addr);
     EEL_F read_next();
+    void read_array(EEL_F *dest, uint32_t count);
+    // get the next values, up to `count`, which are contiguous in one block;
+    // the result is null if the memory is not allocated, and reads as zeros
+    const EEL_F *read_span(uint32_t count, uint32_t *span_count);
+
+private:
+    void next_block();
 
 private:
     NSEEL_VMCTX m_vm{};
@@ -48,6 +60,13 @@ public:
     ysfx_eel_ram_writer() = default;
     ysfx_eel_ram_writer(NSEEL_VMCTX vm, int64_t addr);
     bool write_next(EEL_F value);
+    uint32_t write_array(const EEL_F *src, uint32_t count);
+    // get the next values, up to `count`, which are contiguous in one block;
+    // the result is null if the memory is out of range, and discards the writes
+    EEL_F *write_span(uint32_t count, uint32_t *span_count);
+
+private:
+    void next_block();
 
 private:
     NSEEL_VMCTX m_vm{};
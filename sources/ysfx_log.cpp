@@ -0,0 +1,97 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "ysfx_log.hpp"
+#include <cstring>
+
+ysfx_log_queue_t *ysfx_log_queue_new(uint32_t capacity)
+{
+    size_t size = 2;
+    while (size < capacity)
+        size *= 2;
+
+    ysfx_log_queue_u queue{new ysfx_log_queue_t};
+    queue->cells.reset(new ysfx_log_queue_t::cell_t[size]);
+    queue->mask = size - 1;
+    for (size_t i = 0; i < size; ++i)
+        queue->cells[i].sequence.store(i, std::memory_order_relaxed);
+
+    return queue.release();
+}
+
+void ysfx_log_queue_free(ysfx_log_queue_t *queue)
+{
+    delete queue;
+}
+
+bool ysfx_log_queue_push(ysfx_log_queue_t *queue, ysfx_log_level level, const char *message)
+{
+    ysfx_log_queue_t::cell_t *cell;
+    size_t pos = queue->push_pos.load(std::memory_order_relaxed);
+
+    for (;;) {
+        cell = &queue->cells[pos & queue->mask];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        if (diff == 0) {
+            if (queue->push_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0) {
+            queue->dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else
+            pos = queue->push_pos.load(std::memory_order_relaxed);
+    }
+
+    cell->level = level;
+    size_t length = strlen(message);
+    if (length > ysfx_log_message_max - 1)
+        length = ysfx_log_message_max - 1;
+    memcpy(cell->message, message, length);
+    cell->message[length] = '\0';
+
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool ysfx_log_queue_pop(ysfx_log_queue_t *queue, ysfx_log_level *level, char *message)
+{
+    ysfx_log_queue_t::cell_t *cell;
+    size_t pos = queue->pop_pos.load(std::memory_order_relaxed);
+
+    for (;;) {
+        cell = &queue->cells[pos & queue->mask];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (queue->pop_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+            return false;
+        else
+            pos = queue->pop_pos.load(std::memory_order_relaxed);
+    }
+
+    *level = cell->level;
+    memcpy(message, cell->message, strlen(cell->message) + 1);
+
+    cell->sequence.store(pos + queue->mask + 1, std::memory_order_release);
+    return true;
+}
@@ -0,0 +1,53 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#pragma once
+#include "ysfx.h"
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+enum { ysfx_log_message_max = 256 };
+
+// A bounded queue of log messages, which any number of threads can push and
+// pop concurrently, without blocking or allocating memory. It's the bounded
+// MPMC queue of Dmitry Vyukov.
+struct ysfx_log_queue_t {
+    struct cell_t {
+        std::atomic<size_t> sequence{0};
+        ysfx_log_level level = ysfx_log_info;
+        char message[ysfx_log_message_max];
+    };
+
+    std::unique_ptr<cell_t[]> cells;
+    size_t mask = 0;
+    std::atomic<size_t> push_pos{0};
+    std::atomic<size_t> pop_pos{0};
+    // the number of messages which did not fit
+    std::atomic<uint64_t> dropped{0};
+};
+
+// create a queue, whose capacity is rounded up to a power of 2
+ysfx_log_queue_t *ysfx_log_queue_new(uint32_t capacity);
+void ysfx_log_queue_free(ysfx_log_queue_t *queue);
+YSFX_DEFINE_AUTO_PTR(ysfx_log_queue_u, ysfx_log_queue_t, ysfx_log_queue_free);
+
+// add a message, which is truncated if too long; if the queue is full, count it as dropped
+bool ysfx_log_queue_push(ysfx_log_queue_t *queue, ysfx_log_level level, const char *message);
+// remove a message, storing it in a buffer of `ysfx_log_message_max` characters
+bool ysfx_log_queue_pop(ysfx_log_queue_t *queue, ysfx_log_level *level, char *message);
@@ -31,22 +31,23 @@ void ysfx_midi_reserve(ysfx_midi_buffer_t *midi, uint32_t capacity, bool extensi
 void ysfx_midi_clear(ysfx_midi_buffer_t *midi)
 {
     midi->data.clear();
+    midi->count = 0;
+    midi->dropped = 0;
     ysfx_midi_rewind(midi);
 }
 
 bool ysfx_midi_push(ysfx_midi_buffer_t *midi, const ysfx_midi_event_t *event)
 {
-    if (event->size > ysfx_midi_message_max_size)
-        return false;
-    if (event->bus >= ysfx_max_midi_buses)
-        return false;
-
     ysfx_midi_header_t header;
 
-    if (!midi->extensible) {
+    bool fits = event->size <= ysfx_midi_message_max_size && event->bus < ysfx_max_midi_buses;
+    if (fits && !midi->extensible) {
         size_t writable = midi->data.capacity() - midi->data.size();
-        if (writable < sizeof(header) + event->size)
-            return false;
+        fits = writable >= sizeof(header) + event->size;
+    }
+    if (!fits) {
+        ++midi->dropped;
+        return false;
     }
 
     const uint8_t *data = event->data;
@@ -57,6 +58,7 @@ bool ysfx_midi_push(ysfx_midi_buffer_t *midi, const ysfx_midi_event_t *event)
 
     midi->data.insert(midi->data.end(), headp, headp + sizeof(header));
     midi->data.insert(midi->data.end(), data, data + header.size);
+    ++midi->count;
     return true;
 }
 
@@ -138,6 +140,7 @@ bool ysfx_midi_push_begin(ysfx_midi_buffer_t *midi, uint32_t bus, uint32_t offse
         size_t writable = midi->data.capacity() - midi->data.size();
         if (writable < sizeof(header)) {
             mp->eob = true;
+            ++midi->dropped;
             return false;
         }
     }
@@ -181,6 +184,7 @@ bool ysfx_midi_push_end(ysfx_midi_push_t *mp)
 {
     if (mp->eob) {
         mp->midi->data.resize(mp->start);
+        ++mp->midi->dropped;
         return false;
     }
 
@@ -189,6 +193,7 @@ bool ysfx_midi_push_end(ysfx_midi_push_t *mp)
     memcpy(&header, headp, sizeof(header));
     header.size = mp->count;
     memcpy(headp, &header, sizeof(header));
+    ++mp->midi->count;
     return true;
 }
 
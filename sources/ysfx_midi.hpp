@@ -31,6 +31,9 @@ struct ysfx_midi_buffer_t {
     size_t read_pos = 0;
     size_t read_pos_for_bus[ysfx_max_midi_buses] = {};
     bool extensible = false;
+    // the number of events written, and of those which failed, since cleared
+    uint32_t count = 0;
+    uint32_t dropped = 0;
 };
 using ysfx_midi_buffer_u = std::unique_ptr<ysfx_midi_buffer_t>;
 
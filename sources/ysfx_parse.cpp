@@ -147,6 +147,14 @@ void ysfx_parse_header(ysfx_section_t *section, ysfx_header_t &header)
                     int32_t maxmem = (int32_t)ysfx::dot_atof(value.c_str());
                     header.options.maxmem = (maxmem < 0) ? 0 : (uint32_t)maxmem;
                 }
+                else if (name == "prealloc") {
+                    if (value == "*")
+                        header.options.prealloc = ~(uint32_t)0;
+                    else {
+                        int32_t prealloc = (int32_t)ysfx::dot_atof(value.c_str());
+                        header.options.prealloc = (prealloc < 0) ? 0 : (uint32_t)prealloc;
+                    }
+                }
                 else if (name == "want_all_kb")
                     header.options.want_all_kb = true;
                 else if (name == "no_meter")
@@ -0,0 +1,81 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "ysfx_pool.hpp"
+#include <mutex>
+
+ysfx_pool_t *ysfx_pool_new(ysfx_t *fx, uint32_t capacity)
+{
+    ysfx_pool_u pool{new ysfx_pool_t};
+
+    // keep a private model, so the original effect stays free to run
+    pool->model.reset(ysfx_clone(fx));
+    if (!pool->model)
+        return nullptr;
+
+    pool->capacity = capacity;
+    pool->clones.reserve(capacity);
+    ysfx_pool_fill(pool.get());
+
+    return pool.release();
+}
+
+void ysfx_pool_free(ysfx_pool_t *pool)
+{
+    delete pool;
+}
+
+uint32_t ysfx_pool_fill(ysfx_pool_t *pool)
+{
+    std::lock_guard<ysfx::mutex> fill_lock{pool->fill_mutex};
+
+    for (;;) {
+        {
+            std::lock_guard<ysfx::mutex> lock{pool->mutex};
+            if (pool->clones.size() >= pool->capacity)
+                return (uint32_t)pool->clones.size();
+        }
+
+        ysfx_u clone{ysfx_clone(pool->model.get())};
+        if (!clone)
+            break;
+
+        std::lock_guard<ysfx::mutex> lock{pool->mutex};
+        pool->clones.push_back(std::move(clone));
+    }
+
+    std::lock_guard<ysfx::mutex> lock{pool->mutex};
+    return (uint32_t)pool->clones.size();
+}
+
+ysfx_t *ysfx_pool_acquire(ysfx_pool_t *pool)
+{
+    std::lock_guard<ysfx::mutex> lock{pool->mutex};
+
+    if (pool->clones.empty())
+        return nullptr;
+
+    ysfx_t *fx = pool->clones.back().release();
+    pool->clones.pop_back();
+    return fx;
+}
+
+uint32_t ysfx_pool_get_available(ysfx_pool_t *pool)
+{
+    std::lock_guard<ysfx::mutex> lock{pool->mutex};
+    return (uint32_t)pool->clones.size();
+}
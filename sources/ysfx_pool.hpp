@@ -0,0 +1,30 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#pragma once
+#include "ysfx.h"
+#include "ysfx_utils.hpp"
+#include <vector>
+
+struct ysfx_pool_s {
+    ysfx_u model;
+    uint32_t capacity = 0;
+    // the model is cloned outside of the lock, one filler at a time
+    ysfx::mutex fill_mutex;
+    ysfx::mutex mutex;
+    std::vector<ysfx_u> clones;
+};
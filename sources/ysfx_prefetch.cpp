@@ -0,0 +1,150 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+#include "ysfx_prefetch.hpp"
+
+static void ysfx_prefetcher_run(ysfx_prefetcher_t *prefetcher)
+{
+    std::unique_lock<std::mutex> lock{prefetcher->mutex};
+
+    for (;;) {
+        prefetcher->cond.wait(lock, [prefetcher]() { return prefetcher->stop || !prefetcher->jobs.empty(); });
+        if (prefetcher->stop)
+            break;
+
+        std::shared_ptr<ysfx_prefetch_job_t> job = std::move(prefetcher->jobs.front());
+        prefetcher->jobs.pop_front();
+
+        // if the queue holds the only reference, the file is closed already
+        if (job.use_count() > 1) {
+            prefetcher->busy = true;
+            lock.unlock();
+
+            ysfx_file_u file{ysfx_new_file(job->vm, job->type, &job->fmt, job->audio_cache.get(), job->path.c_str())};
+            // a file which did not open is dropped, so it's reported as failed rather than not ready
+            if (file && !file->is_open())
+                file.reset();
+            if (file)
+                file->readahead(prefetcher->readahead);
+            job->file = std::move(file);
+            job->ready.store(true, std::memory_order_release);
+            job.reset();
+
+            lock.lock();
+            prefetcher->busy = false;
+        }
+
+        if (prefetcher->jobs.empty())
+            prefetcher->idle_cond.notify_all();
+    }
+}
+
+ysfx_prefetcher_t *ysfx_prefetcher_new(uint64_t readahead)
+{
+    std::unique_ptr<ysfx_prefetcher_t> prefetcher{new ysfx_prefetcher_t};
+    prefetcher->readahead = readahead;
+    prefetcher->thread = std::thread(&ysfx_prefetcher_run, prefetcher.get());
+    return prefetcher.release();
+}
+
+void ysfx_prefetcher_free(ysfx_prefetcher_t *prefetcher)
+{
+    if (!prefetcher)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock{prefetcher->mutex};
+        prefetcher->stop = true;
+    }
+    prefetcher->cond.notify_one();
+    prefetcher->thread.join();
+
+    delete prefetcher;
+}
+
+void ysfx_prefetcher_submit(ysfx_prefetcher_t *prefetcher, std::shared_ptr<ysfx_prefetch_job_t> job)
+{
+    {
+        std::lock_guard<std::mutex> lock{prefetcher->mutex};
+        prefetcher->jobs.push_back(std::move(job));
+    }
+    prefetcher->cond.notify_one();
+}
+
+void ysfx_prefetcher_wait(ysfx_prefetcher_t *prefetcher)
+{
+    std::unique_lock<std::mutex> lock{prefetcher->mutex};
+    prefetcher->idle_cond.wait(lock, [prefetcher]() {
+        return prefetcher->stop || (prefetcher->jobs.empty() && !prefetcher->busy);
+    });
+}
+
+//------------------------------------------------------------------------------
+ysfx_prefetched_file_t::ysfx_prefetched_file_t(std::shared_ptr<ysfx_prefetch_job_t> job)
+    : m_job(std::move(job))
+{
+}
+
+ysfx_file_t *ysfx_prefetched_file_t::file()
+{
+    if (!m_job->ready.load(std::memory_order_acquire))
+        return nullptr;
+    return m_job->file.get();
+}
+
+int32_t ysfx_prefetched_file_t::avail()
+{
+    if (!m_job->ready.load(std::memory_order_acquire))
+        return -1;
+    ysfx_file_t *file = m_job->file.get();
+    return file ? file->avail() : -2;
+}
+
+void ysfx_prefetched_file_t::rewind()
+{
+    // if not ready, it's still at the beginning
+    ysfx_file_t *file = this->file();
+    if (file)
+        file->rewind();
+}
+
+bool ysfx_prefetched_file_t::var(ysfx_real *var)
+{
+    ysfx_file_t *file = this->file();
+    return file ? file->var(var) : false;
+}
+
+uint32_t ysfx_prefetched_file_t::mem(uint32_t offset, uint32_t length)
+{
+    ysfx_file_t *file = this->file();
+    return file ? file->mem(offset, length) : 0;
+}
+
+uint32_t ysfx_prefetched_file_t::string(std::string &str)
+{
+    ysfx_file_t *file = this->file();
+    if (!file) {
+        str.clear();
+        return 0;
+    }
+    return file->string(str);
+}
+
+bool ysfx_prefetched_file_t::riff(uint32_t &nch, ysfx_real &samplerate)
+{
+    ysfx_file_t *file = this->file();
+    return file ? file->riff(nch, samplerate) : false;
+}
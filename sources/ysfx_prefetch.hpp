@@ -0,0 +1,84 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+#pragma once
+#include "ysfx.h"
+#include "ysfx_api_file.hpp"
+#include <deque>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// A file to open on the prefetch thread, which also reads ahead its beginning.
+struct ysfx_prefetch_job_t {
+    NSEEL_VMCTX vm = nullptr;
+    ysfx_file_type_t type = ysfx_file_type_none;
+    ysfx_audio_format_t fmt{};
+    ysfx_audio_cache_u audio_cache;
+    std::string path;
+    // the opened file, which is published when `ready` becomes true; null if it did not open
+    ysfx_file_u file;
+    std::atomic<bool> ready{false};
+};
+
+// The thread which serves the prefetch jobs of a configuration, in order.
+struct ysfx_prefetcher_t {
+    uint64_t readahead = 0;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::condition_variable idle_cond;
+    std::deque<std::shared_ptr<ysfx_prefetch_job_t>> jobs;
+    bool busy = false;
+    bool stop = false;
+};
+
+// start a prefetch thread, which reads ahead the given number of bytes
+ysfx_prefetcher_t *ysfx_prefetcher_new(uint64_t readahead);
+// stop the prefetch thread; the jobs it has not started are never served
+void ysfx_prefetcher_free(ysfx_prefetcher_t *prefetcher);
+YSFX_DEFINE_AUTO_PTR(ysfx_prefetcher_u, ysfx_prefetcher_t, ysfx_prefetcher_free);
+
+// add a job to the queue
+void ysfx_prefetcher_submit(ysfx_prefetcher_t *prefetcher, std::shared_ptr<ysfx_prefetch_job_t> job);
+// wait until all the jobs in the queue are served
+void ysfx_prefetcher_wait(ysfx_prefetcher_t *prefetcher);
+
+//------------------------------------------------------------------------------
+
+// A file which the prefetch thread opens. Until it's ready, it reads nothing,
+// and its `avail` is -1; if it could not be opened, its `avail` is -2.
+struct ysfx_prefetched_file_t final : ysfx_file_t {
+    explicit ysfx_prefetched_file_t(std::shared_ptr<ysfx_prefetch_job_t> job);
+
+    int32_t avail() override;
+    void rewind() override;
+    bool var(ysfx_real *var) override;
+    uint32_t mem(uint32_t offset, uint32_t length) override;
+    uint32_t string(std::string &str) override;
+    bool riff(uint32_t &nch, ysfx_real &samplerate) override;
+    bool is_text() override { return m_job->type == ysfx_file_type_txt; }
+    bool is_in_write_mode() override { return false; }
+    bool is_open() override { return file() != nullptr; }
+
+    // get the file, if the prefetch thread has opened it
+    ysfx_file_t *file();
+
+    std::shared_ptr<ysfx_prefetch_job_t> m_job;
+};
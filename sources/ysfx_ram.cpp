@@ -0,0 +1,792 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "ysfx_ram.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cinttypes>
+#if !defined(_WIN32)
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#   if defined(__linux__)
+#       include <linux/userfaultfd.h>
+#       include <sys/ioctl.h>
+#       include <sys/syscall.h>
+#   endif
+#else
+#   include <windows.h>
+#endif
+
+static constexpr uint64_t ysfx_ram_block_bytes = NSEEL_RAM_ITEMSPERBLOCK * sizeof(EEL_F);
+
+//------------------------------------------------------------------------------
+// allocate a heap block, with the RAM mutex already held
+static EEL_F *ysfx_ram_alloc_heap_block_locked()
+{
+    EEL_F *block = (EEL_F *)calloc(sizeof(EEL_F), NSEEL_RAM_ITEMSPERBLOCK);
+    if (block)
+        NSEEL_RAM_memused += (unsigned int)ysfx_ram_block_bytes;
+    return block;
+}
+
+EEL_F *ysfx_ram_alloc_heap_block()
+{
+    NSEEL_HOSTSTUB_EnterRAMMutex();
+    EEL_F *block = ysfx_ram_alloc_heap_block_locked();
+    NSEEL_HOSTSTUB_LeaveRAMMutex();
+    return block;
+}
+
+void ysfx_ram_free_heap_block(EEL_F *block)
+{
+    if (!block)
+        return;
+    NSEEL_HOSTSTUB_EnterRAMMutex();
+    if (NSEEL_RAM_memused >= ysfx_ram_block_bytes)
+        NSEEL_RAM_memused -= (unsigned int)ysfx_ram_block_bytes;
+    else
+        NSEEL_RAM_memused_errors++;
+    NSEEL_HOSTSTUB_LeaveRAMMutex();
+    free(block);
+}
+
+//------------------------------------------------------------------------------
+// the allocator whose allocations the current thread is counting
+static thread_local ysfx_ram_allocator_t *ysfx_ram_counting_allocator = nullptr;
+
+static void ysfx_ram_raise_extent(ysfx_ram_allocator_t &allocator, uint32_t extent)
+{
+    uint32_t current = allocator.extent.load(std::memory_order_relaxed);
+    while (current < extent && !allocator.extent.compare_exchange_weak(current, extent, std::memory_order_relaxed))
+        ;
+}
+
+static EEL_F *ysfx_ram_allocate_block(void *userctx, unsigned int index)
+{
+    // EEL2 calls it with the RAM mutex held
+    ysfx_ram_allocator_t *allocator = (ysfx_ram_allocator_t *)userctx;
+    ysfx_ram_arena_t *arena = allocator->arena;
+
+    // the arena is reserved in advance, so taking a block of it does not allocate
+    if (arena && index < arena->size / ysfx_ram_block_bytes) {
+        ysfx_ram_raise_extent(*allocator, index + 1);
+        allocator->num_blocks.fetch_add(1, std::memory_order_relaxed);
+        return (EEL_F *)(arena->base + index * ysfx_ram_block_bytes);
+    }
+
+    // as EEL2 does it, the limit applies to the allocations of the code
+    if (NSEEL_RAM_limitmem && NSEEL_RAM_memused + ysfx_ram_block_bytes >= NSEEL_RAM_limitmem)
+        return nullptr;
+
+    EEL_F *block = ysfx_ram_alloc_heap_block_locked();
+    if (!block)
+        return nullptr;
+
+    ysfx_ram_raise_extent(*allocator, index + 1);
+    allocator->num_blocks.fetch_add(1, std::memory_order_relaxed);
+    if (ysfx_ram_counting_allocator == allocator)
+        allocator->counted_allocations.fetch_add(1, std::memory_order_relaxed);
+    return block;
+}
+
+ysfx_ram_allocator_t::~ysfx_ram_allocator_t()
+{
+    ysfx_ram_allocator_detach(*this);
+}
+
+void ysfx_ram_allocator_attach(ysfx_ram_allocator_t &allocator, NSEEL_VMCTX vm)
+{
+    ysfx_ram_allocator_detach(allocator);
+
+    compileContext *ctx = (compileContext *)vm;
+    EEL_F **blocks = ctx->ram_state->blocks;
+    NSEEL_HOSTSTUB_EnterRAMMutex();
+    ctx->ram_state->alloc_hook.func = &ysfx_ram_allocate_block;
+    ctx->ram_state->alloc_hook.userctx = &allocator;
+    uint32_t extent = NSEEL_RAM_BLOCKS;
+    while (extent > 0 && !blocks[extent - 1])
+        --extent;
+    allocator.extent.store(extent, std::memory_order_relaxed);
+    uint32_t num_blocks = 0;
+    for (uint32_t k = 0; k < extent; ++k)
+        num_blocks += blocks[k] != nullptr;
+    allocator.num_blocks.store(num_blocks, std::memory_order_relaxed);
+    NSEEL_HOSTSTUB_LeaveRAMMutex();
+
+    allocator.vm = vm;
+}
+
+void ysfx_ram_allocator_detach(ysfx_ram_allocator_t &allocator)
+{
+    if (!allocator.vm)
+        return;
+
+    compileContext *ctx = (compileContext *)allocator.vm;
+    NSEEL_HOSTSTUB_EnterRAMMutex();
+    ctx->ram_state->alloc_hook.func = nullptr;
+    ctx->ram_state->alloc_hook.userctx = nullptr;
+    NSEEL_HOSTSTUB_LeaveRAMMutex();
+
+    allocator.vm = nullptr;
+}
+
+static ysfx_ram_allocator_t *ysfx_ram_get_allocator(NSEEL_VMCTX vm)
+{
+    compileContext *ctx = (compileContext *)vm;
+    if (ctx->ram_state->alloc_hook.func != &ysfx_ram_allocate_block)
+        return nullptr;
+    return (ysfx_ram_allocator_t *)ctx->ram_state->alloc_hook.userctx;
+}
+
+// count the blocks again, after they are replaced by other means than the allocator
+static void ysfx_ram_recount(NSEEL_VMCTX vm)
+{
+    if (ysfx_ram_allocator_t *allocator = ysfx_ram_get_allocator(vm))
+        allocator->num_blocks.store(ysfx_ram_count_blocks(vm), std::memory_order_relaxed);
+}
+
+uint32_t ysfx_ram_get_extent(NSEEL_VMCTX vm)
+{
+    ysfx_ram_allocator_t *allocator = ysfx_ram_get_allocator(vm);
+    if (!allocator)
+        return NSEEL_RAM_BLOCKS;
+    return allocator->extent.load(std::memory_order_relaxed);
+}
+
+ysfx_ram_count_scope::ysfx_ram_count_scope(ysfx_ram_allocator_t &allocator)
+    : m_previous(ysfx_ram_counting_allocator)
+{
+    ysfx_ram_counting_allocator = &allocator;
+}
+
+ysfx_ram_count_scope::~ysfx_ram_count_scope()
+{
+    ysfx_ram_counting_allocator = m_previous;
+}
+
+//------------------------------------------------------------------------------
+ysfx_ram_arena_t::~ysfx_ram_arena_t()
+{
+    ysfx_ram_arena_detach(*this, false);
+}
+
+bool ysfx_ram_arena_attach(ysfx_ram_arena_t &arena, ysfx_ram_allocator_t &allocator, uint32_t num_blocks, bool huge_pages)
+{
+    ysfx_ram_arena_detach(arena, true);
+
+    if (!allocator.vm)
+        return false;
+
+    if (num_blocks > NSEEL_RAM_BLOCKS)
+        num_blocks = NSEEL_RAM_BLOCKS;
+    if (num_blocks == 0)
+        return false;
+
+    uint64_t size = num_blocks * ysfx_ram_block_bytes;
+    uint8_t *base = nullptr;
+    uint64_t map_size = size;
+    bool have_huge_pages = false;
+
+#if !defined(_WIN32)
+    void *addr = MAP_FAILED;
+#   if defined(MAP_HUGETLB)
+    // it requires the system to have reserved huge pages, which is rarely so;
+    // without MAP_NORESERVE, it fails if the reserve is insufficient, rather
+    // than it faults later on the audio thread
+    if (huge_pages) {
+        const uint64_t huge_page_size = 2 * 1024 * 1024;
+        uint64_t huge_size = (size + huge_page_size - 1) / huge_page_size * huge_page_size;
+        addr = mmap(nullptr, (size_t)huge_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+        if (addr != MAP_FAILED) {
+            map_size = huge_size;
+            have_huge_pages = true;
+        }
+    }
+#   endif
+    if (addr == MAP_FAILED) {
+        addr = mmap(nullptr, (size_t)size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+        if (addr == MAP_FAILED)
+            return false;
+#   if defined(MADV_HUGEPAGE)
+        // otherwise, ask for transparent huge pages
+        if (huge_pages)
+            have_huge_pages = madvise(addr, (size_t)size, MADV_HUGEPAGE) == 0;
+#   endif
+    }
+    base = (uint8_t *)addr;
+#else
+    // large pages require a privilege which processes normally don't have
+    (void)huge_pages;
+    base = (uint8_t *)VirtualAlloc(nullptr, (SIZE_T)size, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+    if (!base)
+        return false;
+#endif
+
+    arena.vm = allocator.vm;
+    arena.allocator = &allocator;
+    arena.base = base;
+    arena.size = size;
+    arena.map_size = map_size;
+    arena.huge_pages = have_huge_pages;
+    static std::atomic<uint64_t> serial{0};
+    arena.serial = serial.fetch_add(1, std::memory_order_relaxed) + 1;
+
+    // the blocks which are allocated already stay where they are, the others
+    // are taken from the arena when they are used
+    NSEEL_HOSTSTUB_EnterRAMMutex();
+    allocator.arena = &arena;
+    NSEEL_HOSTSTUB_LeaveRAMMutex();
+    return true;
+}
+
+void ysfx_ram_arena_detach(ysfx_ram_arena_t &arena, bool keep_contents)
+{
+    if (!arena.vm)
+        return;
+
+    NSEEL_HOSTSTUB_EnterRAMMutex();
+    if (arena.allocator->arena == &arena)
+        arena.allocator->arena = nullptr;
+    NSEEL_HOSTSTUB_LeaveRAMMutex();
+
+    compileContext *ctx = (compileContext *)arena.vm;
+    EEL_F **blocks = ctx->ram_state->blocks;
+    uint32_t extent = ysfx_ram_get_extent(arena.vm);
+    for (uint32_t k = 0; k < extent; ++k) {
+        EEL_F *&block = blocks[k];
+        if (!arena.contains(block))
+            continue;
+        EEL_F *copy = nullptr;
+        if (keep_contents) {
+            copy = ysfx_ram_alloc_heap_block();
+            if (copy)
+                memcpy(copy, block, ysfx_ram_block_bytes);
+        }
+        block = copy;
+    }
+    ysfx_ram_recount(arena.vm);
+
+#if !defined(_WIN32)
+    munmap(arena.base, (size_t)arena.map_size);
+#else
+    VirtualFree(arena.base, 0, MEM_RELEASE);
+#endif
+
+    arena.vm = nullptr;
+    arena.allocator = nullptr;
+    arena.base = nullptr;
+    arena.size = 0;
+    arena.map_size = 0;
+    arena.huge_pages = false;
+    arena.serial = 0;
+}
+
+bool ysfx_ram_arena_covers(const ysfx_ram_arena_t &arena)
+{
+    if (!arena.vm)
+        return false;
+
+    compileContext *ctx = (compileContext *)arena.vm;
+    EEL_F **blocks = ctx->ram_state->blocks;
+    uint32_t extent = ysfx_ram_get_extent(arena.vm);
+
+    for (uint32_t k = 0; k < extent; ++k) {
+        if (blocks[k] && !arena.contains(blocks[k]))
+            return false;
+    }
+    return true;
+}
+
+void ysfx_ram_arena_adopt(ysfx_ram_arena_t &arena, const ysfx_ram_view_t *view)
+{
+    if (!arena.vm)
+        return;
+
+    compileContext *ctx = (compileContext *)arena.vm;
+    EEL_F **blocks = ctx->ram_state->blocks;
+    uint32_t extent = ysfx_ram_get_extent(arena.vm);
+    uint32_t capacity = (uint32_t)(arena.size / ysfx_ram_block_bytes);
+
+    for (uint32_t k = 0; k < extent && k < capacity; ++k) {
+        EEL_F *&block = blocks[k];
+        if (!block || arena.contains(block))
+            continue;
+        EEL_F *old = block;
+        block = (EEL_F *)(arena.base + k * ysfx_ram_block_bytes);
+        memcpy(block, old, ysfx_ram_block_bytes);
+        if (!(view && view->vm == arena.vm && view->contains(old)))
+            ysfx_ram_free_heap_block(old);
+    }
+}
+
+//------------------------------------------------------------------------------
+#if !defined(_WIN32)
+static int ysfx_ram_create_shared_memory(uint64_t size)
+{
+    int fd = -1;
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+    fd = memfd_create("ysfx-ram", MFD_CLOEXEC);
+#endif
+    if (fd == -1) {
+        static std::atomic<uint32_t> counter{0};
+        char name[64];
+        sprintf(name, "/ysfx-ram.%ld.%u", (long)getpid(), counter.fetch_add(1));
+        fd = shm_open(name, O_RDWR|O_CREAT|O_EXCL, 0600);
+        if (fd != -1)
+            shm_unlink(name);
+    }
+    if (fd == -1)
+        return -1;
+    if (ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+#endif
+
+ysfx_ram_image_t::~ysfx_ram_image_t()
+{
+#if !defined(_WIN32)
+    if (fd != -1)
+        close(fd);
+#else
+    if (handle)
+        CloseHandle((HANDLE)handle);
+#endif
+}
+
+ysfx_ram_image_t *ysfx_ram_image_create(NSEEL_VMCTX vm)
+{
+    compileContext *ctx = (compileContext *)vm;
+    EEL_F **blocks = ctx->ram_state->blocks;
+
+    std::unique_ptr<ysfx_ram_image_t> image{new ysfx_ram_image_t};
+    uint32_t extent = ysfx_ram_get_extent(vm);
+    for (uint32_t i = 0; i < extent; ++i) {
+        if (blocks[i])
+            image->blocks.push_back(i);
+    }
+
+    image->size = image->blocks.size() * ysfx_ram_block_bytes;
+    if (image->size == 0)
+        return image.release();
+
+#if !defined(_WIN32)
+    image->fd = ysfx_ram_create_shared_memory(image->size);
+    if (image->fd == -1)
+        return nullptr;
+    void *base = mmap(nullptr, (size_t)image->size, PROT_READ|PROT_WRITE, MAP_SHARED, image->fd, 0);
+    if (base == MAP_FAILED)
+        return nullptr;
+#else
+    image->handle = (void *)CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)(image->size >> 32), (DWORD)image->size, nullptr);
+    if (!image->handle)
+        return nullptr;
+    void *base = MapViewOfFile((HANDLE)image->handle, FILE_MAP_WRITE, 0, 0, (SIZE_T)image->size);
+    if (!base)
+        return nullptr;
+#endif
+
+    for (size_t k = 0; k < image->blocks.size(); ++k)
+        memcpy((uint8_t *)base + k * ysfx_ram_block_bytes, blocks[image->blocks[k]], ysfx_ram_block_bytes);
+
+#if !defined(_WIN32)
+    munmap(base, (size_t)image->size);
+#else
+    UnmapViewOfFile(base);
+#endif
+
+    return image.release();
+}
+
+//------------------------------------------------------------------------------
+static void ysfx_ram_view_unmap(uint8_t *base, uint64_t size)
+{
+    if (!base)
+        return;
+#if !defined(_WIN32)
+    munmap(base, (size_t)size);
+#else
+    (void)size;
+    UnmapViewOfFile(base);
+#endif
+}
+
+ysfx_ram_view_t::~ysfx_ram_view_t()
+{
+    ysfx_ram_view_detach(*this);
+}
+
+bool ysfx_ram_view_attach(ysfx_ram_view_t &view, NSEEL_VMCTX vm, const ysfx_ram_image_t &image, const ysfx_ram_arena_t *arena)
+{
+    uint8_t *base = nullptr;
+
+    if (image.size > 0) {
+#if !defined(_WIN32)
+        void *addr = mmap(nullptr, (size_t)image.size, PROT_READ|PROT_WRITE, MAP_PRIVATE, image.fd, 0);
+        if (addr == MAP_FAILED)
+            return false;
+        base = (uint8_t *)addr;
+#else
+        base = (uint8_t *)MapViewOfFile((HANDLE)image.handle, FILE_MAP_COPY, 0, 0, (SIZE_T)image.size);
+        if (!base)
+            return false;
+#endif
+    }
+
+    compileContext *ctx = (compileContext *)vm;
+    EEL_F **blocks = ctx->ram_state->blocks;
+
+    for (size_t k = 0; k < image.blocks.size(); ++k) {
+        EEL_F *&block = blocks[image.blocks[k]];
+        EEL_F *old = block;
+        block = (EEL_F *)(base + k * ysfx_ram_block_bytes);
+        if (old && !(view.vm == vm && view.contains(old)) && !(arena && arena->vm == vm && arena->contains(old)))
+            ysfx_ram_free_heap_block(old);
+    }
+
+    // the blocks of the previous view which were not replaced are kept as copies
+    if (view.vm == vm) {
+        for (uint32_t index : view.blocks) {
+            EEL_F *&block = blocks[index];
+            if (!view.contains(block))
+                continue;
+            EEL_F *copy = ysfx_ram_alloc_heap_block();
+            if (copy)
+                memcpy(copy, block, ysfx_ram_block_bytes);
+            block = copy;
+        }
+        ysfx_ram_view_unmap(view.base, view.size);
+    }
+    else
+        ysfx_ram_view_detach(view);
+
+    if (!image.blocks.empty()) {
+        if (ysfx_ram_allocator_t *allocator = ysfx_ram_get_allocator(vm))
+            ysfx_ram_raise_extent(*allocator, image.blocks.back() + 1);
+    }
+    ysfx_ram_recount(vm);
+
+    view.vm = vm;
+    view.base = base;
+    view.size = image.size;
+    view.blocks = image.blocks;
+    return true;
+}
+
+void ysfx_ram_view_detach(ysfx_ram_view_t &view)
+{
+    if (view.vm) {
+        compileContext *ctx = (compileContext *)view.vm;
+        EEL_F **blocks = ctx->ram_state->blocks;
+        for (uint32_t index : view.blocks) {
+            if (view.contains(blocks[index]))
+                blocks[index] = nullptr;
+        }
+        ysfx_ram_recount(view.vm);
+    }
+
+    ysfx_ram_view_unmap(view.base, view.size);
+
+    view.vm = nullptr;
+    view.base = nullptr;
+    view.size = 0;
+    view.blocks.clear();
+}
+
+//------------------------------------------------------------------------------
+#if defined(__linux__)
+// the asynchronous write protection and the scan of the pages are from Linux
+// 6.7, so the headers of the system may not have them
+#if !defined(UFFD_USER_MODE_ONLY)
+#   define UFFD_USER_MODE_ONLY 1
+#endif
+#if !defined(UFFD_FEATURE_WP_UNPOPULATED)
+#   define UFFD_FEATURE_WP_UNPOPULATED (1 << 13)
+#endif
+#if !defined(UFFD_FEATURE_WP_ASYNC)
+#   define UFFD_FEATURE_WP_ASYNC (1 << 15)
+#endif
+
+struct ysfx_ram_page_region_t {
+    uint64_t start;
+    uint64_t end;
+    uint64_t categories;
+};
+
+struct ysfx_ram_pm_scan_arg_t {
+    uint64_t size;
+    uint64_t flags;
+    uint64_t start;
+    uint64_t end;
+    uint64_t walk_end;
+    uint64_t vec;
+    uint64_t vec_len;
+    uint64_t max_pages;
+    uint64_t category_inverted;
+    uint64_t category_mask;
+    uint64_t category_anyof_mask;
+    uint64_t return_mask;
+};
+
+enum {
+    ysfx_ram_pm_scan_wp_matching = 1 << 0,
+    ysfx_ram_pm_scan_check_wpasync = 1 << 1,
+    ysfx_ram_page_is_written = 1 << 1,
+};
+
+#define YSFX_RAM_PAGEMAP_SCAN _IOWR('f', 16, ysfx_ram_pm_scan_arg_t)
+#endif
+
+ysfx_ram_tracker_t::~ysfx_ram_tracker_t()
+{
+    ysfx_ram_tracker_close(*this);
+}
+
+bool ysfx_ram_tracker_open(ysfx_ram_tracker_t &tracker)
+{
+    ysfx_ram_tracker_close(tracker);
+
+#if defined(__linux__) && defined(SYS_userfaultfd)
+    // the writes are not reported as events: the faults resolve by themselves
+    // and leave a mark on the page, which the page map tells
+    tracker.uffd = (int)syscall(SYS_userfaultfd, O_CLOEXEC|O_NONBLOCK|UFFD_USER_MODE_ONLY);
+    if (tracker.uffd == -1)
+        return false;
+
+    uffdio_api api{};
+    api.api = UFFD_API;
+    api.features = UFFD_FEATURE_WP_ASYNC|UFFD_FEATURE_WP_UNPOPULATED;
+    tracker.pagemap = open("/proc/self/pagemap", O_RDONLY|O_CLOEXEC);
+    tracker.mem = open("/proc/self/mem", O_RDONLY|O_CLOEXEC);
+    if (ioctl(tracker.uffd, UFFDIO_API, &api) != 0 || tracker.pagemap == -1 || tracker.mem == -1) {
+        ysfx_ram_tracker_close(tracker);
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ysfx_ram_tracker_close(ysfx_ram_tracker_t &tracker)
+{
+#if !defined(_WIN32)
+    for (int *fd : {&tracker.uffd, &tracker.pagemap, &tracker.mem}) {
+        if (*fd != -1)
+            close(*fd);
+        *fd = -1;
+    }
+#else
+    (void)tracker;
+#endif
+}
+
+bool ysfx_ram_tracker_protect(ysfx_ram_tracker_t &tracker, uint8_t *base, uint64_t size)
+{
+#if defined(__linux__)
+    if (tracker.uffd == -1)
+        return false;
+    uffdio_writeprotect wp{};
+    wp.range.start = (uintptr_t)base;
+    wp.range.len = size;
+    wp.mode = UFFDIO_WRITEPROTECT_MODE_WP;
+    return ioctl(tracker.uffd, UFFDIO_WRITEPROTECT, &wp) == 0;
+#else
+    (void)tracker;
+    (void)base;
+    (void)size;
+    return false;
+#endif
+}
+
+bool ysfx_ram_tracker_add(ysfx_ram_tracker_t &tracker, uint8_t *base, uint64_t size)
+{
+#if defined(__linux__)
+    if (tracker.uffd == -1)
+        return false;
+    uffdio_register reg{};
+    reg.range.start = (uintptr_t)base;
+    reg.range.len = size;
+    reg.mode = UFFDIO_REGISTER_MODE_WP;
+    if (ioctl(tracker.uffd, UFFDIO_REGISTER, &reg) != 0)
+        return false;
+    return ysfx_ram_tracker_protect(tracker, base, size);
+#else
+    (void)tracker;
+    (void)base;
+    (void)size;
+    return false;
+#endif
+}
+
+bool ysfx_ram_tracker_scan(ysfx_ram_tracker_t &tracker, uint8_t *base, uint64_t size, std::vector<ysfx_ram_range_t> &ranges)
+{
+#if defined(__linux__)
+    if (tracker.pagemap == -1)
+        return false;
+
+    enum { max_regions = 64 };
+    ysfx_ram_page_region_t regions[max_regions];
+
+    ysfx_ram_pm_scan_arg_t arg{};
+    arg.size = sizeof(arg);
+    // the written pages are protected again as they are reported; it fails if
+    // the region is not tracked, which it is not after an unmapping
+    arg.flags = ysfx_ram_pm_scan_wp_matching|ysfx_ram_pm_scan_check_wpasync;
+    arg.start = (uintptr_t)base;
+    arg.end = (uintptr_t)base + size;
+    arg.vec = (uintptr_t)regions;
+    arg.vec_len = max_regions;
+    arg.category_mask = ysfx_ram_page_is_written;
+    arg.return_mask = ysfx_ram_page_is_written;
+
+    // the scan stops where it has no more room, and it continues from there
+    while (arg.start < arg.end) {
+        int count = ioctl(tracker.pagemap, YSFX_RAM_PAGEMAP_SCAN, &arg);
+        if (count < 0)
+            return false;
+        for (int i = 0; i < count; ++i)
+            ranges.push_back({regions[i].start - (uintptr_t)base, regions[i].end - regions[i].start});
+        if (arg.walk_end <= arg.start)
+            return false;
+        arg.start = arg.walk_end;
+    }
+    return true;
+#else
+    (void)tracker;
+    (void)base;
+    (void)size;
+    (void)ranges;
+    return false;
+#endif
+}
+
+bool ysfx_ram_tracker_read(ysfx_ram_tracker_t &tracker, void *dst, const void *src, uint64_t size)
+{
+#if defined(__linux__)
+    if (tracker.mem == -1)
+        return false;
+    for (uint64_t done = 0; done < size; ) {
+        ssize_t count = pread(tracker.mem, (uint8_t *)dst + done, (size_t)(size - done), (off_t)((uintptr_t)src + done));
+        if (count <= 0)
+            return false;
+        done += (uint64_t)count;
+    }
+    return true;
+#else
+    (void)tracker;
+    (void)dst;
+    (void)src;
+    (void)size;
+    return false;
+#endif
+}
+
+//------------------------------------------------------------------------------
+uint32_t ysfx_ram_count_blocks(NSEEL_VMCTX vm)
+{
+    compileContext *ctx = (compileContext *)vm;
+    EEL_F **blocks = ctx->ram_state->blocks;
+    uint32_t extent = ysfx_ram_get_extent(vm);
+
+    uint32_t count = 0;
+    for (uint32_t k = 0; k < extent; ++k)
+        count += blocks[k] != nullptr;
+    return count;
+}
+
+void ysfx_ram_preallocate(NSEEL_VMCTX vm, uint64_t num_items)
+{
+    compileContext *ctx = (compileContext *)vm;
+    uint64_t num_blocks = (num_items + NSEEL_RAM_ITEMSPERBLOCK - 1) / NSEEL_RAM_ITEMSPERBLOCK;
+    if (num_blocks > (uint64_t)ctx->ram_state->maxblocks)
+        num_blocks = (uint64_t)ctx->ram_state->maxblocks;
+
+    for (uint64_t k = 0; k < num_blocks; ++k)
+        NSEEL_VM_getramptr(vm, (unsigned)(k * NSEEL_RAM_ITEMSPERBLOCK), nullptr);
+}
+
+void ysfx_ram_prefault(NSEEL_VMCTX vm)
+{
+    // the smallest page size of the platforms
+    const uint64_t page_size = 4096;
+
+    compileContext *ctx = (compileContext *)vm;
+    EEL_F **blocks = ctx->ram_state->blocks;
+    uint32_t extent = ysfx_ram_get_extent(vm);
+
+    for (uint32_t k = 0; k < extent; ++k) {
+        // write the values in place, reading is not enough if the page is
+        // unallocated or shared copy-on-write
+        volatile uint8_t *block = (volatile uint8_t *)blocks[k];
+        if (!block)
+            continue;
+        for (uint64_t offset = 0; offset < ysfx_ram_block_bytes; offset += page_size)
+            block[offset] = block[offset];
+    }
+}
+
+//------------------------------------------------------------------------------
+ysfx_ram_lock_t::~ysfx_ram_lock_t()
+{
+    ysfx_ram_unlock(*this);
+}
+
+bool ysfx_ram_lock(ysfx_ram_lock_t &lock, NSEEL_VMCTX vm)
+{
+    compileContext *ctx = (compileContext *)vm;
+    EEL_F **blocks = ctx->ram_state->blocks;
+
+    uint32_t extent = ysfx_ram_get_extent(vm);
+
+    bool success = true;
+    for (uint32_t k = 0; k < extent; ++k) {
+        EEL_F *block = blocks[k];
+        if (!block || std::find(lock.blocks.begin(), lock.blocks.end(), block) != lock.blocks.end())
+            continue;
+#if !defined(_WIN32)
+        bool locked = mlock(block, ysfx_ram_block_bytes) == 0;
+#else
+        bool locked = VirtualLock(block, ysfx_ram_block_bytes) != 0;
+#endif
+        if (locked)
+            lock.blocks.push_back(block);
+        else
+            success = false;
+    }
+
+    return success;
+}
+
+void ysfx_ram_unlock(ysfx_ram_lock_t &lock)
+{
+    for (void *block : lock.blocks) {
+#if !defined(_WIN32)
+        munlock(block, ysfx_ram_block_bytes);
+#else
+        VirtualUnlock(block, ysfx_ram_block_bytes);
+#endif
+    }
+    lock.blocks.clear();
+}
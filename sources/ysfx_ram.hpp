@@ -0,0 +1,246 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#pragma once
+#include "WDL/eel2/ns-eel.h"
+#include "WDL/eel2/ns-eel-int.h"
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+// VM memory can be backed by storage which does not come from EEL2.
+// EEL2 takes any RAM block which is non-null as already allocated, and frees
+// all blocks with the VM, so this storage must be detached before that.
+//
+// A block is non-null only once it's used, by the code or by the host. The
+// operations which go through all the memory of a VM only see those blocks.
+
+struct ysfx_ram_arena_t;
+struct ysfx_ram_view_t;
+
+//------------------------------------------------------------------------------
+// The allocator of the RAM blocks of a VM, which EEL2 calls when the code
+// accesses a block for the first time. It takes the block from the arena if
+// there is one, and it keeps account of the allocations.
+
+struct ysfx_ram_allocator_t {
+    ysfx_ram_allocator_t() = default;
+    ~ysfx_ram_allocator_t();
+
+    NSEEL_VMCTX vm = nullptr;
+    // the arena which provides the blocks, if any; guarded by the RAM mutex of EEL2
+    ysfx_ram_arena_t *arena = nullptr;
+    // one past the highest block which was ever used; the blocks above are null
+    std::atomic<uint32_t> extent{0};
+    // the number of blocks in use, which other threads can read while the code allocates
+    std::atomic<uint32_t> num_blocks{0};
+    // the heap blocks allocated on a thread which counts them (see ysfx_ram_count_scope)
+    std::atomic<uint64_t> counted_allocations{0};
+
+private:
+    ysfx_ram_allocator_t(const ysfx_ram_allocator_t &) = delete;
+    ysfx_ram_allocator_t &operator=(const ysfx_ram_allocator_t &) = delete;
+};
+
+// make the allocator provide the blocks of the VM
+void ysfx_ram_allocator_attach(ysfx_ram_allocator_t &allocator, NSEEL_VMCTX vm);
+// restore the default allocation of EEL2
+void ysfx_ram_allocator_detach(ysfx_ram_allocator_t &allocator);
+// get the number of blocks, from the first, which contains all those in use
+uint32_t ysfx_ram_get_extent(NSEEL_VMCTX vm);
+
+// counts the allocations which the current thread makes with the allocator, while in scope
+class ysfx_ram_count_scope {
+public:
+    explicit ysfx_ram_count_scope(ysfx_ram_allocator_t &allocator);
+    ~ysfx_ram_count_scope();
+
+private:
+    ysfx_ram_allocator_t *m_previous = nullptr;
+    ysfx_ram_count_scope(const ysfx_ram_count_scope &) = delete;
+    ysfx_ram_count_scope &operator=(const ysfx_ram_count_scope &) = delete;
+};
+
+//------------------------------------------------------------------------------
+// A single region of memory, from which the allocator takes the RAM blocks of
+// a VM, as they are used. The pages of the region are allocated by the system
+// on first use, so an effect pays for the memory it touches, rather than by
+// the whole block.
+
+struct ysfx_ram_arena_t {
+    ysfx_ram_arena_t() = default;
+    ~ysfx_ram_arena_t();
+
+    NSEEL_VMCTX vm = nullptr;
+    ysfx_ram_allocator_t *allocator = nullptr;
+    uint8_t *base = nullptr;
+    uint64_t size = 0;
+    uint64_t map_size = 0;
+    bool huge_pages = false;
+    // a number which no other mapping of an arena has, unlike the address
+    uint64_t serial = 0;
+
+    bool contains(const EEL_F *block) const
+    {
+        return (const uint8_t *)block >= base && (const uint8_t *)block < base + size;
+    }
+
+private:
+    ysfx_ram_arena_t(const ysfx_ram_arena_t &) = delete;
+    ysfx_ram_arena_t &operator=(const ysfx_ram_arena_t &) = delete;
+};
+
+// make the allocator take the blocks from a new arena, up to the given count
+//     huge pages are requested if possible, and it falls back to normal pages
+bool ysfx_ram_arena_attach(ysfx_ram_arena_t &arena, ysfx_ram_allocator_t &allocator, uint32_t num_blocks, bool huge_pages);
+// detach the arena from its VM, and unmap it
+//     the blocks in use are copied to the heap if the contents are kept, otherwise they are unallocated
+void ysfx_ram_arena_detach(ysfx_ram_arena_t &arena, bool keep_contents);
+// whether the arena provides all the blocks of its VM
+bool ysfx_ram_arena_covers(const ysfx_ram_arena_t &arena);
+// move the blocks of the VM which are elsewhere into the arena
+//     the heap blocks are released, those of the view are left for it to unmap
+void ysfx_ram_arena_adopt(ysfx_ram_arena_t &arena, const ysfx_ram_view_t *view = nullptr);
+
+//------------------------------------------------------------------------------
+// An image of the RAM of a VM, held in a shared memory object, which can be
+// mapped copy-on-write by any number of VMs. Pages are duplicated only when
+// a VM writes them.
+
+struct ysfx_ram_image_t {
+    ysfx_ram_image_t() = default;
+    ~ysfx_ram_image_t();
+
+#if !defined(_WIN32)
+    int fd = -1;
+#else
+    void *handle = nullptr;
+#endif
+    uint64_t size = 0;
+    // numbers of the VM blocks, in order of storage
+    std::vector<uint32_t> blocks;
+
+private:
+    ysfx_ram_image_t(const ysfx_ram_image_t &) = delete;
+    ysfx_ram_image_t &operator=(const ysfx_ram_image_t &) = delete;
+};
+
+// capture all the blocks of the VM into a new image
+ysfx_ram_image_t *ysfx_ram_image_create(NSEEL_VMCTX vm);
+
+//------------------------------------------------------------------------------
+// A private mapping of an image, which provides RAM blocks to a VM.
+
+struct ysfx_ram_view_t {
+    ysfx_ram_view_t() = default;
+    ~ysfx_ram_view_t();
+
+    NSEEL_VMCTX vm = nullptr;
+    uint8_t *base = nullptr;
+    uint64_t size = 0;
+    std::vector<uint32_t> blocks;
+
+    bool contains(const EEL_F *block) const
+    {
+        return (const uint8_t *)block >= base && (const uint8_t *)block < base + size;
+    }
+
+private:
+    ysfx_ram_view_t(const ysfx_ram_view_t &) = delete;
+    ysfx_ram_view_t &operator=(const ysfx_ram_view_t &) = delete;
+};
+
+// replace the blocks of the VM with a view of the image, releasing the blocks it replaces
+//     the blocks of the arena, if any, are not released, they are left for the arena to unmap
+bool ysfx_ram_view_attach(ysfx_ram_view_t &view, NSEEL_VMCTX vm, const ysfx_ram_image_t &image, const ysfx_ram_arena_t *arena = nullptr);
+// detach the view from its VM, and unmap it
+void ysfx_ram_view_detach(ysfx_ram_view_t &view);
+
+//------------------------------------------------------------------------------
+// A record of the pages of some regions of memory which are written, where the
+// system can tell it (Linux, by userfaultfd). The pages are protected, and the
+// first write to one lifts the protection and marks the page; the writer takes
+// a minor fault, but it does not wait for anyone, and nothing gets copied.
+
+struct ysfx_ram_range_t {
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct ysfx_ram_tracker_t {
+    ysfx_ram_tracker_t() = default;
+    ~ysfx_ram_tracker_t();
+
+    int uffd = -1;
+    int pagemap = -1;
+    int mem = -1;
+
+private:
+    ysfx_ram_tracker_t(const ysfx_ram_tracker_t &) = delete;
+    ysfx_ram_tracker_t &operator=(const ysfx_ram_tracker_t &) = delete;
+};
+
+// open the tracker; it returns false if the system cannot track the writes
+bool ysfx_ram_tracker_open(ysfx_ram_tracker_t &tracker);
+// close the tracker, which stops tracking all the regions
+void ysfx_ram_tracker_close(ysfx_ram_tracker_t &tracker);
+// track a region, whose pages count as unwritten from now on, until it's unmapped
+bool ysfx_ram_tracker_add(ysfx_ram_tracker_t &tracker, uint8_t *base, uint64_t size);
+// append the written ranges of a tracked region to the list, and protect them again
+//     the ranges are relative to the base, and they count as unwritten afterwards
+bool ysfx_ram_tracker_scan(ysfx_ram_tracker_t &tracker, uint8_t *base, uint64_t size, std::vector<ysfx_ram_range_t> &ranges);
+// protect a range of a tracked region again, so it counts as unwritten
+bool ysfx_ram_tracker_protect(ysfx_ram_tracker_t &tracker, uint8_t *base, uint64_t size);
+// copy memory which another thread may write or unmap meanwhile; the system
+// does the copy, so the worst it gets is a torn page or a failure
+bool ysfx_ram_tracker_read(ysfx_ram_tracker_t &tracker, void *dst, const void *src, uint64_t size);
+
+//------------------------------------------------------------------------------
+// allocate a block on the heap, as EEL2 does it
+EEL_F *ysfx_ram_alloc_heap_block();
+// free a block which was allocated on the heap
+void ysfx_ram_free_heap_block(EEL_F *block);
+
+//------------------------------------------------------------------------------
+// count the blocks of the VM which are allocated
+uint32_t ysfx_ram_count_blocks(NSEEL_VMCTX vm);
+// allocate the blocks of the VM which hold the first items, up to the given count
+void ysfx_ram_preallocate(NSEEL_VMCTX vm, uint64_t num_items);
+// write to every page of the allocated blocks, to make them resident in memory
+void ysfx_ram_prefault(NSEEL_VMCTX vm);
+
+//------------------------------------------------------------------------------
+// A set of blocks of a VM, which are locked into physical memory.
+
+struct ysfx_ram_lock_t {
+    ysfx_ram_lock_t() = default;
+    ~ysfx_ram_lock_t();
+
+    // the alignment attribute of EEL_F does not apply to template arguments
+    std::vector<void *> blocks;
+
+private:
+    ysfx_ram_lock_t(const ysfx_ram_lock_t &) = delete;
+    ysfx_ram_lock_t &operator=(const ysfx_ram_lock_t &) = delete;
+};
+
+// lock the allocated blocks of the VM, in addition to those already locked
+//     it returns false if any of the blocks could not be locked
+bool ysfx_ram_lock(ysfx_ram_lock_t &lock, NSEEL_VMCTX vm);
+// unlock all the blocks; do this before the blocks are released
+void ysfx_ram_unlock(ysfx_ram_lock_t &lock);
@@ -0,0 +1,224 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "ysfx_snapshot.hpp"
+#include "ysfx.hpp"
+#include "ysfx_eel_utils.hpp"
+#include <cstring>
+
+static bool ysfx_snapshot_track(ysfx_snapshot_t *snapshot);
+
+ysfx_snapshot_t *ysfx_snapshot_new(ysfx_t *fx)
+{
+    if (!fx->code.compiled)
+        return nullptr;
+
+    ysfx_snapshot_u snapshot{new ysfx_snapshot_t};
+    snapshot->source = fx;
+    snapshot->compile_count = fx->compile_count;
+
+    snapshot->fx.reset(ysfx_new_sibling(fx));
+    if (!snapshot->fx)
+        return nullptr;
+
+    // match the variables once, so a capture is a plain copy
+    const auto &dst_index = snapshot->fx->code.var_index;
+    snapshot->vars.reserve(fx->code.var_index.size());
+    for (const auto &item : fx->code.var_index) {
+        auto it = dst_index.find(item.first);
+        if (it != dst_index.end())
+            snapshot->vars.push_back({item.second, it->second});
+    }
+
+    // the tracking starts now, so the first capture can be prepared as well
+    snapshot->can_track = ysfx_ram_tracker_open(snapshot->tracker);
+    ysfx_snapshot_track(snapshot.get());
+
+    return snapshot.release();
+}
+
+void ysfx_snapshot_free(ysfx_snapshot_t *snapshot)
+{
+    delete snapshot;
+}
+
+void ysfx_snapshot_set_memory_limit(ysfx_snapshot_t *snapshot, uint64_t limit)
+{
+    snapshot->memory_limit = limit;
+}
+
+// put all the memory of the effect into its arena, where the writes can be tracked
+static bool ysfx_snapshot_gather(ysfx_t *fx)
+{
+    ysfx_ram_arena_t &arena = fx->ram.arena;
+    if (!arena.vm) {
+        compileContext *ctx = (compileContext *)fx->vm.get();
+        if (!ysfx_ram_arena_attach(arena, fx->ram.allocator, (uint32_t)ctx->ram_state->maxblocks, false))
+            return false;
+    }
+
+    if (!ysfx_ram_arena_covers(arena)) {
+        // the blocks which move get released
+        ysfx_ram_unlock(fx->ram.lock);
+        ysfx_ram_arena_adopt(arena, &fx->ram.view);
+        ysfx_ram_view_detach(fx->ram.view);
+        if (fx->ram.options != 0)
+            ysfx_prepare_ram(fx);
+    }
+    return true;
+}
+
+// track the writes to the memory of the source and of the copy, if they are not tracked already
+static bool ysfx_snapshot_track(ysfx_snapshot_t *snapshot)
+{
+    ysfx_t *src = snapshot->source;
+    ysfx_t *dst = snapshot->fx.get();
+
+    if (!snapshot->can_track || !ysfx_snapshot_gather(src) || !ysfx_snapshot_gather(dst))
+        return false;
+
+    ysfx_ram_arena_t &src_arena = src->ram.arena;
+    ysfx_ram_arena_t &dst_arena = dst->ram.arena;
+    if (src_arena.size != dst_arena.size)
+        return false;
+    if (src_arena.serial == snapshot->src_serial && dst_arena.serial == snapshot->dst_serial)
+        return true;
+
+    snapshot->src_serial = 0;
+    snapshot->dst_serial = 0;
+    snapshot->synced = false;
+    if (!ysfx_ram_tracker_add(snapshot->tracker, src_arena.base, src_arena.size) ||
+        !ysfx_ram_tracker_add(snapshot->tracker, dst_arena.base, dst_arena.size))
+        return false;
+
+    snapshot->src_serial = src_arena.serial;
+    snapshot->dst_serial = dst_arena.serial;
+    snapshot->src_base = src_arena.base;
+    snapshot->dst_base = dst_arena.base;
+    snapshot->arena_size = src_arena.size;
+    return true;
+}
+
+// copy a range of the memory of the source into the copy
+static bool ysfx_snapshot_copy_range(ysfx_snapshot_t *snapshot, uint64_t offset, uint64_t size)
+{
+    const uint64_t block_bytes = NSEEL_RAM_ITEMSPERBLOCK * sizeof(EEL_F);
+    NSEEL_VMCTX dst_vm = snapshot->fx->vm.get();
+
+    // the blocks of the copy are taken at the same place of its arena
+    for (uint64_t k = offset / block_bytes; k * block_bytes < offset + size; ++k) {
+        EEL_F *block = NSEEL_VM_getramptr(dst_vm, (unsigned)(k * NSEEL_RAM_ITEMSPERBLOCK), nullptr);
+        if ((uint8_t *)block != snapshot->dst_base + k * block_bytes)
+            return false;
+    }
+
+    // the pages of the copy which this writes do not count as written by it
+    return ysfx_ram_tracker_read(snapshot->tracker, snapshot->dst_base + offset, snapshot->src_base + offset, size) &&
+        ysfx_ram_tracker_protect(snapshot->tracker, snapshot->dst_base + offset, size);
+}
+
+// copy all the memory of the source into the copy
+static bool ysfx_snapshot_sync_whole(ysfx_snapshot_t *snapshot)
+{
+    const uint64_t block_bytes = NSEEL_RAM_ITEMSPERBLOCK * sizeof(EEL_F);
+    NSEEL_VMCTX dst_vm = snapshot->fx->vm.get();
+    EEL_F **dst_blocks = ((compileContext *)dst_vm)->ram_state->blocks;
+
+    uint32_t src_extent = snapshot->source->ram.allocator.extent.load(std::memory_order_relaxed);
+    uint32_t dst_extent = ysfx_ram_get_extent(dst_vm);
+    if (src_extent > snapshot->arena_size / block_bytes)
+        src_extent = (uint32_t)(snapshot->arena_size / block_bytes);
+
+    if (src_extent > 0 && !ysfx_snapshot_copy_range(snapshot, 0, src_extent * block_bytes))
+        return false;
+
+    // the blocks of the copy beyond are those which its @serialize took
+    for (uint32_t k = src_extent; k < dst_extent; ++k) {
+        if (dst_blocks[k]) {
+            memset(dst_blocks[k], 0, block_bytes);
+            if (!ysfx_ram_tracker_protect(snapshot->tracker, snapshot->dst_base + k * block_bytes, block_bytes))
+                return false;
+        }
+    }
+    return true;
+}
+
+// copy the pages which the source or the copy wrote since the last scan
+static bool ysfx_snapshot_sync_written(ysfx_snapshot_t *snapshot)
+{
+    std::vector<ysfx_ram_range_t> &ranges = snapshot->ranges;
+    ranges.clear();
+
+    // the pages which the copy wrote by @serialize get restored too
+    if (!ysfx_ram_tracker_scan(snapshot->tracker, snapshot->src_base, snapshot->arena_size, ranges) ||
+        !ysfx_ram_tracker_scan(snapshot->tracker, snapshot->dst_base, snapshot->arena_size, ranges))
+        return false;
+
+    for (const ysfx_ram_range_t &range : ranges) {
+        if (!ysfx_snapshot_copy_range(snapshot, range.offset, range.size))
+            return false;
+    }
+    return true;
+}
+
+// bring the copy up to date with the tracked memory; tracking stops if it fails
+static bool ysfx_snapshot_sync(ysfx_snapshot_t *snapshot)
+{
+    bool synced = snapshot->synced ? ysfx_snapshot_sync_written(snapshot) : ysfx_snapshot_sync_whole(snapshot);
+    snapshot->synced = synced;
+    if (!synced) {
+        snapshot->src_serial = 0;
+        snapshot->dst_serial = 0;
+    }
+    return synced;
+}
+
+void ysfx_snapshot_prepare(ysfx_snapshot_t *snapshot)
+{
+    // the pages which the source writes meanwhile are marked again, so the
+    // capture takes them; this may copy a torn page, which is taken again too
+    if (snapshot->src_serial != 0)
+        ysfx_snapshot_sync(snapshot);
+}
+
+bool ysfx_snapshot_capture(ysfx_snapshot_t *snapshot)
+{
+    ysfx_t *src = snapshot->source;
+    ysfx_t *dst = snapshot->fx.get();
+
+    if (!src->code.compiled || src->compile_count != snapshot->compile_count)
+        return false;
+
+    // the copy is held in addition to the effect, within the limit
+    uint64_t size = (uint64_t)ysfx_ram_count_blocks(src->vm.get()) * NSEEL_RAM_ITEMSPERBLOCK * sizeof(EEL_F);
+    if (size > snapshot->memory_limit)
+        return false;
+
+    for (const ysfx_snapshot_t::var_pair_t &var : snapshot->vars)
+        *var.dst = *var.src;
+
+    if (!ysfx_snapshot_track(snapshot) || !ysfx_snapshot_sync(snapshot))
+        ysfx_eel_ram_copy(dst->vm.get(), src->vm.get());
+
+    ysfx_copy_strings_and_sliders(dst, src);
+    return true;
+}
+
+ysfx_state_t *ysfx_snapshot_save_state(ysfx_snapshot_t *snapshot)
+{
+    return ysfx_save_state(snapshot->fx.get());
+}
@@ -0,0 +1,52 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#pragma once
+#include "ysfx.h"
+#include "ysfx_ram.hpp"
+#include <vector>
+#include <memory>
+
+struct ysfx_snapshot_s {
+    // the effect which is captured, and the code it had at creation
+    ysfx_t *source = nullptr;
+    uint64_t compile_count = 0;
+    // the copy, which runs @serialize
+    ysfx_u fx;
+    // the variables of the source, each with the one of the copy
+    struct var_pair_t {
+        ysfx_real *src;
+        ysfx_real *dst;
+    };
+    std::vector<var_pair_t> vars;
+    // the pages which the source and the copy write, where the system can
+    // tell them; then the copy is kept, and updated by those pages only
+    ysfx_ram_tracker_t tracker;
+    bool can_track = false;
+    // the arenas which are tracked, by serial, or zero
+    uint64_t src_serial = 0;
+    uint64_t dst_serial = 0;
+    uint8_t *src_base = nullptr;
+    uint8_t *dst_base = nullptr;
+    uint64_t arena_size = 0;
+    // whether the copy has the memory of the source, but for the pages written since the last scan
+    bool synced = false;
+    // the written ranges, found by a scan
+    std::vector<ysfx_ram_range_t> ranges;
+    // the memory which the copy may hold, otherwise a capture fails
+    uint64_t memory_limit = 64 * 1024 * 1024;
+};
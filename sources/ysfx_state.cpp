@@ -0,0 +1,160 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "ysfx_state.hpp"
+#include <mutex>
+#include <type_traits>
+#include <cstring>
+
+static_assert(std::is_standard_layout<ysfx_state_storage_t>::value,
+              "the state must convert to its storage");
+
+static ysfx_state_storage_t *ysfx_state_get_storage(ysfx_state_t *state)
+{
+    return reinterpret_cast<ysfx_state_storage_t *>(state);
+}
+
+ysfx_state_t *ysfx_state_alloc(ysfx_state_pool_t *pool)
+{
+    ysfx_state_storage_t *storage = new ysfx_state_storage_t;
+    if (pool) {
+        pool->ref_count.fetch_add(1, std::memory_order_relaxed);
+        storage->pool = pool;
+    }
+    return &storage->state;
+}
+
+void ysfx_state_resize(ysfx_state_t *state, uint32_t slider_count, size_t data_size)
+{
+    ysfx_state_storage_t *storage = ysfx_state_get_storage(state);
+
+    if (slider_count > storage->slider_capacity) {
+        ysfx_state_slider_t *sliders = new ysfx_state_slider_t[slider_count]{};
+        delete[] state->sliders;
+        state->sliders = sliders;
+        storage->slider_capacity = slider_count;
+    }
+    state->slider_count = slider_count;
+
+    if (data_size > storage->data_capacity) {
+        uint8_t *data = new uint8_t[data_size];
+        delete[] state->data;
+        state->data = data;
+        storage->data_capacity = data_size;
+    }
+    state->data_size = data_size;
+}
+
+void ysfx_state_free(ysfx_state_t *state)
+{
+    if (!state)
+        return;
+
+    ysfx_state_storage_t *storage = ysfx_state_get_storage(state);
+    if (storage->pool && ysfx_state_pool_release(storage))
+        return;
+
+    delete[] state->sliders;
+    delete[] state->data;
+    if (storage->pool)
+        ysfx_state_pool_unref(storage->pool);
+    delete storage;
+}
+
+void ysfx_state_copy(ysfx_state_t *dst, ysfx_state_t *src)
+{
+    if (dst == src)
+        return;
+
+    ysfx_state_resize(dst, src->slider_count, src->data_size);
+    if (src->slider_count > 0)
+        memcpy(dst->sliders, src->sliders, src->slider_count * sizeof(ysfx_state_slider_t));
+    if (src->data_size > 0)
+        memcpy(dst->data, src->data, src->data_size);
+}
+
+ysfx_state_t *ysfx_state_dup(ysfx_state_t *state_in)
+{
+    if (!state_in)
+        return nullptr;
+
+    ysfx_state_t *state_out = ysfx_state_alloc();
+    ysfx_state_copy(state_out, state_in);
+    return state_out;
+}
+
+//------------------------------------------------------------------------------
+ysfx_state_pool_t *ysfx_state_pool_new(uint32_t capacity)
+{
+    ysfx_state_pool_t *pool = new ysfx_state_pool_t;
+    pool->capacity = capacity;
+    pool->free.reserve(capacity);
+    return pool;
+}
+
+void ysfx_state_pool_free(ysfx_state_pool_t *pool)
+{
+    if (!pool)
+        return;
+
+    std::vector<ysfx_state_storage_t *> free;
+    {
+        std::lock_guard<ysfx::mutex> lock{pool->mutex};
+        pool->closed = true;
+        free.swap(pool->free);
+    }
+
+    for (ysfx_state_storage_t *storage : free)
+        ysfx_state_free(&storage->state);
+
+    ysfx_state_pool_unref(pool);
+}
+
+ysfx_state_t *ysfx_state_pool_acquire(ysfx_state_pool_t *pool)
+{
+    ysfx_state_storage_t *storage = nullptr;
+    {
+        std::lock_guard<ysfx::mutex> lock{pool->mutex};
+        if (!pool->free.empty()) {
+            storage = pool->free.back();
+            pool->free.pop_back();
+        }
+    }
+
+    if (!storage)
+        return ysfx_state_alloc(pool);
+
+    storage->state.slider_count = 0;
+    storage->state.data_size = 0;
+    return &storage->state;
+}
+
+bool ysfx_state_pool_release(ysfx_state_storage_t *storage)
+{
+    ysfx_state_pool_t *pool = storage->pool;
+    std::lock_guard<ysfx::mutex> lock{pool->mutex};
+    if (pool->closed || pool->free.size() >= pool->capacity)
+        return false;
+    pool->free.push_back(storage);
+    return true;
+}
+
+void ysfx_state_pool_unref(ysfx_state_pool_t *pool)
+{
+    if (pool->ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete pool;
+}
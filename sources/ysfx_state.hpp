@@ -0,0 +1,49 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#pragma once
+#include "ysfx.h"
+#include "ysfx_utils.hpp"
+#include <vector>
+#include <atomic>
+
+// The state objects which the library creates are allocated with their
+// capacity, so they can be refilled without allocating.
+struct ysfx_state_storage_t {
+    // first, so a state converts to its storage
+    ysfx_state_t state{};
+    uint32_t slider_capacity = 0;
+    size_t data_capacity = 0;
+    // the pool which it returns to, which it holds a reference of
+    ysfx_state_pool_t *pool = nullptr;
+};
+
+struct ysfx_state_pool_s {
+    std::atomic<uint32_t> ref_count{1};
+    uint32_t capacity = 0;
+    ysfx::mutex mutex;
+    bool closed = false;
+    std::vector<ysfx_state_storage_t *> free;
+};
+
+// create an empty state, optionally belonging to a pool
+ysfx_state_t *ysfx_state_alloc(ysfx_state_pool_t *pool = nullptr);
+// set the counts of sliders and data, growing the capacity if needed; the contents are not preserved when it grows
+void ysfx_state_resize(ysfx_state_t *state, uint32_t slider_count, size_t data_size);
+// give a state back to its pool, returning false if the pool does not keep it
+bool ysfx_state_pool_release(ysfx_state_storage_t *storage);
+void ysfx_state_pool_unref(ysfx_state_pool_t *pool);
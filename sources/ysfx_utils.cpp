@@ -22,6 +22,10 @@
 #include <clocale>
 #include <cstring>
 #include <cassert>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define YSFX_HAVE_SSE2 1
+#endif
 #if !defined(_WIN32)
 #   include <sys/stat.h>
 #   include <sys/types.h>
@@ -29,6 +33,7 @@
 #   include <dirent.h>
 #   include <fcntl.h>
 #   include <fts.h>
+#   include <sys/mman.h>
 #else
 #   include <windows.h>
 #   include <io.h>
@@ -197,6 +202,85 @@ double dot_strtod(const char *text, char **endp)
     return c_strtod(text, endp, c_numeric_locale());
 }
 
+double dot_strtod_range(const char *text, const char *end, const char **endp)
+{
+    // exact powers of ten, for the fast path (Clinger's algorithm)
+    static const double exact_pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+
+    if (text == end) {
+        if (endp)
+            *endp = text;
+        return 0;
+    }
+
+    const char *p = text;
+    while (p != end && ascii_isspace(*p))
+        ++p;
+
+    bool negative = false;
+    if (p != end && (*p == '+' || *p == '-'))
+        negative = *p++ == '-';
+
+    uint64_t mantissa = 0;
+    uint32_t significant = 0;
+    uint32_t digits = 0;
+    int32_t exponent = 0;
+
+    for (; p != end && (uint8_t)(*p - '0') < 10; ++p, ++digits) {
+        mantissa = mantissa * 10 + (uint32_t)(*p - '0');
+        significant += significant || mantissa;
+    }
+    bool hex = digits > 0 && p != end && (*p == 'x' || *p == 'X');
+    if (p != end && *p == '.') {
+        for (++p; p != end && (uint8_t)(*p - '0') < 10; ++p, ++digits) {
+            mantissa = mantissa * 10 + (uint32_t)(*p - '0');
+            significant += significant || mantissa;
+            --exponent;
+        }
+    }
+
+    if (digits > 0 && !hex && significant <= 19) {
+        if (p != end && (*p == 'e' || *p == 'E')) {
+            const char *q = p + 1;
+            bool exp_negative = false;
+            if (q != end && (*q == '+' || *q == '-'))
+                exp_negative = *q++ == '-';
+            if (q != end && (uint8_t)(*q - '0') < 10) {
+                int32_t exp_value = 0;
+                for (; q != end && (uint8_t)(*q - '0') < 10; ++q) {
+                    if (exp_value < 100000)
+                        exp_value = exp_value * 10 + (*q - '0');
+                }
+                exponent += exp_negative ? -exp_value : exp_value;
+                p = q;
+            }
+        }
+
+        bool exact = mantissa <= ((uint64_t)1 << 53) && exponent >= -22 && exponent <= 22;
+        if (mantissa == 0 || exact) {
+            double value = (double)mantissa;
+            if (mantissa != 0 && exponent < 0)
+                value /= exact_pow10[-exponent];
+            else if (mantissa != 0)
+                value *= exact_pow10[exponent];
+            if (endp)
+                *endp = p;
+            return negative ? -value : value;
+        }
+    }
+
+    // not a simple case, let the C library handle it
+    std::string copy(text, end);
+    char *copy_endp = nullptr;
+    double value = dot_strtod(copy.c_str(), &copy_endp);
+    if (endp)
+        *endp = text + (copy_endp - copy.c_str());
+    return value;
+}
+
 bool ascii_isspace(char c)
 {
     switch (c) {
@@ -297,6 +381,77 @@ float unpack_f32le(const uint8_t data[4])
     return value;
 }
 
+void pack_f32le_array(const double *values, uint8_t *data, size_t count)
+{
+    size_t i = 0;
+#if defined(YSFX_HAVE_SSE2)
+    // x86 is little-endian, so the floats are stored as they are
+    for (; i + 4 <= count; i += 4) {
+        __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(&values[i]));
+        __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(&values[i + 2]));
+        _mm_storeu_ps((float *)&data[4 * i], _mm_movelh_ps(lo, hi));
+    }
+#endif
+    for (; i < count; ++i)
+        pack_f32le((float)values[i], &data[4 * i]);
+}
+
+void unpack_f32le_array(const uint8_t *data, double *values, size_t count)
+{
+    size_t i = 0;
+#if defined(YSFX_HAVE_SSE2)
+    for (; i + 4 <= count; i += 4) {
+        __m128 f = _mm_loadu_ps((const float *)&data[4 * i]);
+        _mm_storeu_pd(&values[i], _mm_cvtps_pd(f));
+        _mm_storeu_pd(&values[i + 2], _mm_cvtps_pd(_mm_movehl_ps(f, f)));
+    }
+#endif
+    for (; i < count; ++i)
+        values[i] = unpack_f32le(&data[4 * i]);
+}
+
+void widen_f32_array_inplace(double *values, size_t count)
+{
+    // go backwards, so each double overwrites only floats already converted
+    uint8_t *data = (uint8_t *)values;
+    size_t i = count;
+#if defined(YSFX_HAVE_SSE2)
+    for (; i >= 4; i -= 4) {
+        __m128 f = _mm_loadu_ps((const float *)&data[4 * (i - 4)]);
+        _mm_storeu_pd(&values[i - 2], _mm_cvtps_pd(_mm_movehl_ps(f, f)));
+        _mm_storeu_pd(&values[i - 4], _mm_cvtps_pd(f));
+    }
+#endif
+    while (i-- > 0) {
+        float f;
+        memcpy(&f, &data[4 * i], 4);
+        values[i] = f;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+uint64_t hash64(const void *data, size_t size)
+{
+    // each step is invertible, so a change of a single word always changes the result
+    auto mix = [](uint64_t hash, uint64_t word) -> uint64_t {
+        hash = (hash ^ word) * 0x9e3779b97f4a7c15u;
+        return hash ^ (hash >> 32);
+    };
+
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint64_t hash = mix(0xcbf29ce484222325u, size);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, &bytes[i], 8);
+        hash = mix(hash, word);
+    }
+    for (; i < size; ++i)
+        hash = mix(hash, bytes[i]);
+    return hash;
+}
+
 //------------------------------------------------------------------------------
 
 bool get_file_uid(const char *path, file_uid &uid)
@@ -361,6 +516,116 @@ bool get_handle_file_uid(void *handle, file_uid &uid)
 }
 #endif
 
+bool operator==(const file_stat_t &a, const file_stat_t &b)
+{
+    return a.size == b.size && a.mtime == b.mtime;
+}
+
+bool operator!=(const file_stat_t &a, const file_stat_t &b)
+{
+    return !(a == b);
+}
+
+bool get_file_stat(const char *path, file_stat_t &st)
+{
+#if !defined(_WIN32)
+    struct stat info;
+    if (stat(path, &info) != 0)
+        return false;
+    st.size = (uint64_t)info.st_size;
+#if defined(__APPLE__)
+    st.mtime = (int64_t)info.st_mtimespec.tv_sec * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+    st.mtime = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+    return true;
+#else
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesExW(widen(path).c_str(), GetFileExInfoStandard, &info))
+        return false;
+    st.size = (uint64_t)info.nFileSizeLow | ((uint64_t)info.nFileSizeHigh << 32);
+    uint64_t ticks = (uint64_t)info.ftLastWriteTime.dwLowDateTime | ((uint64_t)info.ftLastWriteTime.dwHighDateTime << 32);
+    st.mtime = (int64_t)ticks * 100;
+    return true;
+#endif
+}
+
+bool map_stream_file(FILE *stream, file_mapping_t &map)
+{
+    map = file_mapping_t{};
+
+#if !defined(_WIN32)
+    int fd = fileno(stream);
+    if (fd == -1)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode))
+        return false;
+
+    uint64_t size = (uint64_t)info.st_size;
+    if (size == 0)
+        return true;
+    if (size > (uint64_t)SIZE_MAX)
+        return false;
+
+    void *data = mmap(nullptr, (size_t)size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+        return false;
+
+    madvise(data, (size_t)size, MADV_SEQUENTIAL);
+
+    map.data = (const uint8_t *)data;
+    map.size = size;
+    return true;
+#else
+    int fd = _fileno(stream);
+    if (fd == -1)
+        return false;
+
+    HANDLE file = (HANDLE)_get_osfhandle(fd);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+        return false;
+    if (size.QuadPart == 0)
+        return true;
+    if ((uint64_t)size.QuadPart > (uint64_t)SIZE_MAX)
+        return false;
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+        return false;
+
+    void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data) {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    map.data = (const uint8_t *)data;
+    map.size = (uint64_t)size.QuadPart;
+    map.handle = (void *)mapping;
+    return true;
+#endif
+}
+
+void unmap_file(file_mapping_t &map)
+{
+#if !defined(_WIN32)
+    if (map.data)
+        munmap((void *)map.data, (size_t)map.size);
+#else
+    if (map.data)
+        UnmapViewOfFile(map.data);
+    if (map.handle)
+        CloseHandle((HANDLE)map.handle);
+#endif
+    map = file_mapping_t{};
+}
+
 //------------------------------------------------------------------------------
 
 bool is_path_separator(char ch)
@@ -86,6 +86,8 @@ double c_atof(const char *text, c_locale_t loc);
 double c_strtod(const char *text, char **endp, c_locale_t loc);
 double dot_atof(const char *text);
 double dot_strtod(const char *text, char **endp);
+// parse like `dot_strtod` the text delimited by `end`, fast if it is a plain decimal number
+double dot_strtod_range(const char *text, const char *end, const char **endp);
 bool ascii_isspace(char c);
 char ascii_tolower(char c);
 char ascii_toupper(char c);
@@ -99,6 +101,15 @@ void pack_u32le(uint32_t value, uint8_t data[4]);
 void pack_f32le(float value, uint8_t data[4]);
 uint32_t unpack_u32le(const uint8_t data[4]);
 float unpack_f32le(const uint8_t data[4]);
+void pack_f32le_array(const double *values, uint8_t *data, size_t count);
+void unpack_f32le_array(const uint8_t *data, double *values, size_t count);
+// convert the floats packed at the start of the buffer into doubles, in place
+void widen_f32_array_inplace(double *values, size_t count);
+
+//------------------------------------------------------------------------------
+
+// compute a 64-bit hash of the data, for detecting changes (not cryptographic)
+uint64_t hash64(const void *data, size_t size);
 
 //------------------------------------------------------------------------------
 
@@ -110,6 +121,29 @@ bool get_descriptor_file_uid(int fd, file_uid &uid);
 bool get_handle_file_uid(void *handle, file_uid &uid);
 #endif
 
+struct file_stat_t {
+    uint64_t size = 0;
+    int64_t mtime = 0; // nanoseconds
+};
+
+bool operator==(const file_stat_t &a, const file_stat_t &b);
+bool operator!=(const file_stat_t &a, const file_stat_t &b);
+bool get_file_stat(const char *path, file_stat_t &st);
+
+// a read-only memory mapping of a whole file
+struct file_mapping_t {
+    const uint8_t *data = nullptr;
+    uint64_t size = 0;
+#if defined(_WIN32)
+    void *handle = nullptr;
+#endif
+};
+
+// map the file which is open in the stream; an empty file maps without data
+bool map_stream_file(FILE *stream, file_mapping_t &map);
+// release the mapping, if any
+void unmap_file(file_mapping_t &map);
+
 //------------------------------------------------------------------------------
 
 struct split_path_t {
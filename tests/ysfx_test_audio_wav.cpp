@@ -97,4 +97,65 @@ TEST_CASE("wav audio format", "[wav]")
             }
         }
     }
+
+    SECTION("load wav file into memory")
+    {
+        const char *text =
+            "desc:example" "\n"
+            "filename:0,example.wav" "\n"
+            "out_pin:output" "\n"
+            "@init" "\n"
+            "h=file_open(0);" "\n"
+            "file_riff(h, nch, srate);" "\n"
+            "avail=file_avail(h);" "\n"
+            "count=file_mem(h, 65530, avail + 100);" "\n"
+            "file_close(h);" "\n";
+
+        scoped_new_dir dir_fx("${root}/Effects");
+        scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+        scoped_new_txt wav_file("${root}/Effects/example.wav", nullptr, 0);
+
+        drwav_data_format fmt{};
+        fmt.container = drwav_container_riff;
+        fmt.format = DR_WAVE_FORMAT_IEEE_FLOAT;
+        fmt.channels = 2;
+        fmt.sampleRate = 48000;
+        fmt.bitsPerSample = 32;
+        uint64_t totalframes = 100000;
+        uint64_t totalsmpls = fmt.channels * totalframes;
+        std::unique_ptr<float[]> data{new float[(size_t)totalsmpls]};
+
+        {
+            std::mt19937_64 prng;
+            for (size_t i = 0; i < (size_t)totalsmpls; ++i)
+                data[i] = std::uniform_real_distribution<float>{-1.0f, 1.0f}(prng);
+        }
+        {
+            drwav wav;
+            REQUIRE(drwav_init_file_write(&wav, wav_file.m_path.c_str(), &fmt, nullptr));
+            uint64_t written = drwav_write_pcm_frames(&wav, totalframes, data.get());
+            drwav_uninit(&wav);
+            REQUIRE(written == totalframes);
+        }
+
+        ysfx_config_u config{ysfx_config_new()};
+        ysfx_register_builtin_audio_formats(config.get());
+        ysfx_u fx{ysfx_new(config.get())};
+        REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(fx.get(), 0));
+        ysfx_init(fx.get());
+
+        REQUIRE(*ysfx_find_var(fx.get(), "nch") == fmt.channels);
+        REQUIRE(*ysfx_find_var(fx.get(), "srate") == fmt.sampleRate);
+        REQUIRE(*ysfx_find_var(fx.get(), "avail") == totalsmpls);
+        REQUIRE(*ysfx_find_var(fx.get(), "count") == totalsmpls);
+
+        // the range crosses boundaries of memory blocks
+        std::unique_ptr<ysfx_real[]> mem{new ysfx_real[(size_t)totalsmpls]};
+        ysfx_read_vmem(fx.get(), 65530, mem.get(), (uint32_t)totalsmpls);
+        uint64_t mismatches = 0;
+        for (size_t i = 0; i < (size_t)totalsmpls; ++i)
+            mismatches += mem[i] != data[i];
+        REQUIRE(mismatches == 0);
+    }
 }
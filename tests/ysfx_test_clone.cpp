@@ -0,0 +1,358 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "ysfx.h"
+#include "ysfx.hpp"
+#include "ysfx_snapshot.hpp"
+#include "ysfx_utils.hpp"
+#include "ysfx_test_utils.hpp"
+#include <catch.hpp>
+#include <vector>
+#include <cstring>
+#include <thread>
+
+TEST_CASE("clone", "[clone]")
+{
+    const char *text =
+        "desc:example" "\n"
+        "out_pin:output" "\n"
+        "slider1:1<1,3,0.1>the slider 1" "\n"
+        "@init" "\n"
+        "myvar=1;" "\n"
+        "mymem=100000;" "\n"
+        "mymem[0]=1;" "\n"
+        "mymem[1]=2;" "\n"
+        "strcpy(#mystr, \"hello\");" "\n"
+        "@block" "\n"
+        "myvar+=1;" "\n"
+        "mymem[0]+=1;" "\n"
+        "mylen=strlen(#mystr);" "\n"
+        "@sample" "\n"
+        "spl0=0.0;" "\n";
+
+    scoped_new_dir dir_fx("${root}/Effects");
+    scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+
+    ysfx_config_u config{ysfx_config_new()};
+    ysfx_u fx{ysfx_new(config.get())};
+
+    REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+    REQUIRE(ysfx_compile(fx.get(), 0));
+    ysfx_init(fx.get());
+    ysfx_slider_set_value(fx.get(), 0, 2);
+
+    auto run_block = [](ysfx_t *fx) {
+        ysfx_real out[1] = {};
+        ysfx_real *outs[] = {out};
+        ysfx_process_double(fx, nullptr, outs, 0, 1, 1);
+    };
+    auto get_mem = [](ysfx_t *fx, uint32_t addr) -> ysfx_real {
+        ysfx_real value = 0;
+        ysfx_read_vmem(fx, addr, &value, 1);
+        return value;
+    };
+
+    run_block(fx.get());
+    REQUIRE(*ysfx_find_var(fx.get(), "myvar") == 2);
+    REQUIRE(get_mem(fx.get(), 100000) == 2);
+
+    SECTION("state is copied")
+    {
+        ysfx_u clone{ysfx_clone(fx.get())};
+        REQUIRE(clone);
+        REQUIRE(ysfx_is_compiled(clone.get()));
+        REQUIRE(ysfx_slider_get_value(clone.get(), 0) == 2);
+        REQUIRE(*ysfx_find_var(clone.get(), "myvar") == 2);
+        REQUIRE(get_mem(clone.get(), 100000) == 2);
+        REQUIRE(get_mem(clone.get(), 100001) == 2);
+
+        // no @init on the clone, it continues where the original is
+        run_block(clone.get());
+        REQUIRE(*ysfx_find_var(clone.get(), "myvar") == 3);
+        REQUIRE(*ysfx_find_var(clone.get(), "mylen") == 5);
+        REQUIRE(get_mem(clone.get(), 100000) == 3);
+
+        // the original is unaffected
+        REQUIRE(*ysfx_find_var(fx.get(), "myvar") == 2);
+        REQUIRE(get_mem(fx.get(), 100000) == 2);
+    }
+
+    SECTION("memory is copy-on-write")
+    {
+        ysfx_u clone1{ysfx_clone(fx.get())};
+        ysfx_u clone2{ysfx_clone(fx.get())};
+        REQUIRE(clone1);
+        REQUIRE(clone2);
+
+        // both clones map the same image, as the original did not run between
+        REQUIRE(clone1->ram.view.base != nullptr);
+        REQUIRE(clone2->ram.view.base != nullptr);
+        REQUIRE(clone1->ram.view.base != clone2->ram.view.base);
+        REQUIRE(fx->ram.image);
+        REQUIRE(fx->ram.image->blocks.size() == 1);
+
+        run_block(clone1.get());
+        REQUIRE(get_mem(clone1.get(), 100000) == 3);
+        REQUIRE(get_mem(clone2.get(), 100000) == 2);
+        REQUIRE(get_mem(fx.get(), 100000) == 2);
+
+        run_block(fx.get());
+        run_block(fx.get());
+        REQUIRE(get_mem(fx.get(), 100000) == 4);
+        REQUIRE(get_mem(clone1.get(), 100000) == 3);
+        REQUIRE(get_mem(clone2.get(), 100000) == 2);
+
+        // a new image is taken, now that the original has run
+        ysfx_u clone3{ysfx_clone(fx.get())};
+        REQUIRE(get_mem(clone3.get(), 100000) == 4);
+        REQUIRE(get_mem(clone3.get(), 100001) == 2);
+        REQUIRE(get_mem(clone1.get(), 100001) == 2);
+
+        // the memory outlives the original
+        fx.reset();
+        REQUIRE(get_mem(clone1.get(), 100000) == 3);
+        REQUIRE(get_mem(clone3.get(), 100000) == 4);
+    }
+
+    SECTION("pool")
+    {
+        ysfx_pool_u pool{ysfx_pool_new(fx.get(), 4)};
+        REQUIRE(pool);
+        REQUIRE(ysfx_pool_get_available(pool.get()) == 4);
+
+        std::vector<ysfx_u> clones;
+        for (uint32_t i = 0; i < 4; ++i) {
+            clones.emplace_back(ysfx_pool_acquire(pool.get()));
+            REQUIRE(clones.back());
+            REQUIRE(*ysfx_find_var(clones.back().get(), "myvar") == 2);
+        }
+        REQUIRE(!ysfx_pool_acquire(pool.get()));
+        REQUIRE(ysfx_pool_get_available(pool.get()) == 0);
+
+        // the pool holds the state at the time of its creation
+        run_block(fx.get());
+        REQUIRE(ysfx_pool_fill(pool.get()) == 4);
+        ysfx_u clone{ysfx_pool_acquire(pool.get())};
+        REQUIRE(clone);
+        REQUIRE(*ysfx_find_var(clone.get(), "myvar") == 2);
+    }
+}
+
+TEST_CASE("snapshot", "[clone]")
+{
+    const char *text =
+        "desc:example" "\n"
+        "out_pin:output" "\n"
+        "slider1:1<1,3,0.1>the slider 1" "\n"
+        "@init" "\n"
+        "myvar=1;" "\n"
+        "mymem=100000;" "\n"
+        "@block" "\n"
+        "myvar+=1;" "\n"
+        "mymem[0]=myvar*10;" "\n"
+        "@serialize" "\n"
+        "file_var(0, myvar);" "\n"
+        "file_mem(0, mymem, 1);" "\n"
+        "@sample" "\n"
+        "spl0=0.0;" "\n";
+
+    scoped_new_dir dir_fx("${root}/Effects");
+    scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+
+    ysfx_config_u config{ysfx_config_new()};
+    ysfx_u fx{ysfx_new(config.get())};
+
+    REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+    REQUIRE(ysfx_compile(fx.get(), 0));
+    ysfx_init(fx.get());
+    ysfx_slider_set_value(fx.get(), 0, 2);
+
+    auto run_block = [](ysfx_t *fx) {
+        ysfx_real out[1] = {};
+        ysfx_real *outs[] = {out};
+        ysfx_process_double(fx, nullptr, outs, 0, 1, 1);
+    };
+
+    ysfx_snapshot_u snapshot{ysfx_snapshot_new(fx.get())};
+    REQUIRE(snapshot);
+
+    run_block(fx.get());
+    REQUIRE(ysfx_snapshot_capture(snapshot.get()));
+
+    // the effect continues, while the snapshot keeps the captured state
+    run_block(fx.get());
+    REQUIRE(*ysfx_find_var(fx.get(), "myvar") == 3);
+
+    ysfx_state_u state{ysfx_snapshot_save_state(snapshot.get())};
+    REQUIRE(state);
+    REQUIRE(state->data_size == 2 * sizeof(float));
+    REQUIRE(ysfx::unpack_f32le(&state->data[0]) == 2);
+    REQUIRE(ysfx::unpack_f32le(&state->data[4]) == 20);
+    REQUIRE(state->slider_count == 1);
+    REQUIRE(state->sliders[0].value == 2);
+
+    // it's the same as saving the effect at the time of capture
+    REQUIRE(ysfx_snapshot_capture(snapshot.get()));
+    ysfx_state_u expected{ysfx_save_state(fx.get())};
+    state.reset(ysfx_snapshot_save_state(snapshot.get()));
+    REQUIRE(state->data_size == expected->data_size);
+    REQUIRE(memcmp(state->data, expected->data, state->data_size) == 0);
+
+    // the snapshot is invalid once the effect is compiled again
+    REQUIRE(ysfx_compile(fx.get(), 0));
+    REQUIRE(!ysfx_snapshot_capture(snapshot.get()));
+}
+
+TEST_CASE("snapshot memory", "[clone]")
+{
+    const char *text =
+        "desc:example" "\n"
+        "out_pin:output" "\n"
+        "@init" "\n"
+        "mymem=0;" "\n"
+        "mymem[1]=1;" "\n"
+        "mymem[100000]=2;" "\n"
+        "count=0;" "\n"
+        "@block" "\n"
+        "count+=1;" "\n"
+        "mymem[count*1000]=count;" "\n"
+        "@serialize" "\n"
+        "file_mem(0, mymem, 5000);" "\n"
+        "file_var(0, mymem[100000]);" "\n"
+        "file_var(0, mymem[200000]);" "\n"
+        "mymem[200000]+=1;" "\n"
+        "@sample" "\n"
+        "spl0=0.0;" "\n";
+
+    scoped_new_dir dir_fx("${root}/Effects");
+    scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+
+    ysfx_config_u config{ysfx_config_new()};
+    ysfx_u fx{ysfx_new(config.get())};
+
+    REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+    REQUIRE(ysfx_compile(fx.get(), 0));
+
+    auto run_block = [](ysfx_t *fx) {
+        ysfx_real out[1] = {};
+        ysfx_real *outs[] = {out};
+        ysfx_process_double(fx, nullptr, outs, 0, 1, 1);
+    };
+
+    auto check_capture = [&](ysfx_snapshot_t *snapshot) {
+        REQUIRE(ysfx_snapshot_capture(snapshot));
+        ysfx_state_u expected{ysfx_save_state(fx.get())};
+        ysfx_state_u state{ysfx_snapshot_save_state(snapshot)};
+        REQUIRE(state);
+        REQUIRE(state->data_size == expected->data_size);
+        REQUIRE(memcmp(state->data, expected->data, state->data_size) == 0);
+        // the snapshot modifies its memory, which the next capture must revert
+        state.reset(ysfx_snapshot_save_state(snapshot));
+    };
+
+    // where the writes are tracked, the snapshot keeps its copy of the memory
+    auto check_tracked = [&](ysfx_snapshot_t *snapshot) {
+        if (snapshot->can_track) {
+            REQUIRE(snapshot->src_serial != 0);
+            REQUIRE(snapshot->src_serial == fx->ram.arena.serial);
+            REQUIRE(snapshot->synced);
+        }
+    };
+
+    SECTION("captures follow the writes of the effect")
+    {
+        uint32_t options = GENERATE(0u, (uint32_t)ysfx_ram_option_prefault);
+        ysfx_set_ram_options(fx.get(), options, 0);
+        ysfx_init(fx.get());
+        ysfx_snapshot_u snapshot{ysfx_snapshot_new(fx.get())};
+        REQUIRE(snapshot);
+
+        for (int i = 0; i < 6; ++i) {
+            run_block(fx.get());
+            // the writes after the preparation are taken by the capture
+            if (i % 2 == 1) {
+                ysfx_snapshot_prepare(snapshot.get());
+                run_block(fx.get());
+            }
+            check_capture(snapshot.get());
+            check_tracked(snapshot.get());
+        }
+
+        // the memory allocated after a capture is taken by the next
+        ysfx_real value = 3;
+        REQUIRE(ysfx_write_vmem(fx.get(), 300000, &value, 1) == 1);
+        run_block(fx.get());
+        check_capture(snapshot.get());
+        value = 0;
+        ysfx_read_vmem(snapshot->fx.get(), 300000, &value, 1);
+        REQUIRE(value == 3);
+    }
+
+    SECTION("preparation runs alongside processing")
+    {
+        ysfx_set_ram_options(fx.get(), ysfx_ram_option_prefault, 0);
+        ysfx_init(fx.get());
+        ysfx_snapshot_u snapshot{ysfx_snapshot_new(fx.get())};
+        REQUIRE(snapshot);
+
+        for (int i = 0; i < 4; ++i) {
+            std::thread processing([&]() {
+                for (int j = 0; j < 50; ++j)
+                    run_block(fx.get());
+            });
+            for (int j = 0; j < 10; ++j)
+                ysfx_snapshot_prepare(snapshot.get());
+            processing.join();
+            check_capture(snapshot.get());
+            check_tracked(snapshot.get());
+        }
+    }
+
+    SECTION("the memory of a clone is tracked after it")
+    {
+        ysfx_init(fx.get());
+        ysfx_snapshot_u snapshot{ysfx_snapshot_new(fx.get())};
+        REQUIRE(snapshot);
+        run_block(fx.get());
+        check_capture(snapshot.get());
+
+        // the clone maps the memory of the effect, which moves back into an arena
+        ysfx_u clone{ysfx_clone(fx.get())};
+        REQUIRE(clone);
+        run_block(fx.get());
+        check_capture(snapshot.get());
+        check_tracked(snapshot.get());
+        run_block(fx.get());
+        check_capture(snapshot.get());
+    }
+
+    SECTION("the memory copied whole is limited")
+    {
+        ysfx_set_ram_options(fx.get(), ysfx_ram_option_prefault, 0);
+        ysfx_init(fx.get());
+        ysfx_snapshot_u snapshot{ysfx_snapshot_new(fx.get())};
+        REQUIRE(snapshot);
+
+        run_block(fx.get());
+        check_capture(snapshot.get());
+
+        ysfx_snapshot_set_memory_limit(snapshot.get(), 3 * 65536 * sizeof(ysfx_real) - 1);
+        REQUIRE(!ysfx_snapshot_capture(snapshot.get()));
+        ysfx_snapshot_set_memory_limit(snapshot.get(), 3 * 65536 * sizeof(ysfx_real));
+        check_capture(snapshot.get());
+    }
+}
@@ -0,0 +1,283 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "ysfx.h"
+#include "ysfx_test_utils.hpp"
+#include "WDL/eel2/ns-eel.h"
+#include <catch.hpp>
+#include <memory>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+TEST_CASE("concurrent loading", "[concurrency]")
+{
+    SECTION("load many")
+    {
+        const char *text_lib =
+            "@init" "\n"
+            "function lib_value(x) ( x * 2 );" "\n";
+
+        scoped_new_dir dir_fx("${root}/Effects");
+        scoped_new_txt file_lib("${root}/Effects/lib.jsfx-inc", text_lib);
+
+        constexpr uint32_t num_effects = 16;
+
+        std::vector<std::unique_ptr<scoped_new_txt>> files;
+        for (uint32_t i = 0; i < num_effects; ++i) {
+            std::string text =
+                "desc:example " + std::to_string(i) + "\n"
+                "import lib.jsfx-inc" "\n"
+                "@init" "\n"
+                "value=lib_value(" + std::to_string(i) + ");" "\n";
+            // make one of them fail
+            if (i == 5)
+                text += "value=;" "\n";
+            std::string path = "${root}/Effects/example" + std::to_string(i) + ".jsfx";
+            files.emplace_back(new scoped_new_txt(path, text.c_str()));
+        }
+
+        ysfx_config_u config{ysfx_config_new()};
+        ysfx_set_log_reporter(config.get(), [](intptr_t, ysfx_log_level, const char *) {});
+
+        std::vector<ysfx_u> fx(num_effects);
+        std::vector<ysfx_load_request_t> requests(num_effects);
+        for (uint32_t i = 0; i < num_effects; ++i) {
+            fx[i].reset(ysfx_new(config.get()));
+            requests[i].fx = fx[i].get();
+            requests[i].filepath = files[i]->m_path.c_str();
+            requests[i].loadopts = 0;
+            requests[i].compileopts = 0;
+            requests[i].success = false;
+        }
+
+        REQUIRE(ysfx_load_many(requests.data(), num_effects, 4) == num_effects - 1);
+
+        for (uint32_t i = 0; i < num_effects; ++i) {
+            if (i == 5) {
+                REQUIRE(!requests[i].success);
+                REQUIRE(!ysfx_is_compiled(fx[i].get()));
+                continue;
+            }
+            REQUIRE(requests[i].success);
+            ysfx_init(fx[i].get());
+            ysfx_real *value = ysfx_find_var(fx[i].get(), "value");
+            REQUIRE(value);
+            REQUIRE(*value == 2 * i);
+        }
+    }
+}
+
+TEST_CASE("memory allocation during a compilation", "[concurrency]")
+{
+    const char *text =
+        "desc:example" "\n"
+        "out_pin:output" "\n"
+        "@init" "\n"
+        "count=0;" "\n"
+        "@block" "\n"
+        "mymem[count*65536]=1;" "\n"
+        "count+=1;" "\n";
+
+    scoped_new_dir dir_fx("${root}/Effects");
+    scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+
+    ysfx_config_u config{ysfx_config_new()};
+    ysfx_u fx{ysfx_new(config.get())};
+    REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+    REQUIRE(ysfx_compile(fx.get(), 0));
+    ysfx_init(fx.get());
+
+    // the compilation of another effect holds the mutex of the compiler
+    NSEEL_HOSTSTUB_EnterMutex();
+
+    std::atomic<bool> done{false};
+    std::thread processing([&]() {
+        for (uint32_t i = 0; i < 4; ++i) {
+            ysfx_real out[1] = {};
+            ysfx_real *outs[] = {out};
+            ysfx_process_double(fx.get(), nullptr, outs, 0, 1, 1);
+        }
+        done.store(true);
+    });
+
+    for (uint32_t i = 0; i < 500 && !done.load(); ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    bool allocated = done.load();
+
+    NSEEL_HOSTSTUB_LeaveMutex();
+    processing.join();
+
+    REQUIRE(allocated);
+    ysfx_memory_stats_t stats{};
+    ysfx_get_memory_usage(fx.get(), &stats);
+    REQUIRE(stats.ram == 4 * 65536 * sizeof(ysfx_real));
+}
+
+#if !defined(YSFX_NO_GFX)
+TEST_CASE("strings shared with @gfx", "[concurrency]")
+{
+    const char *text =
+        "desc:example" "\n"
+        "out_pin:output" "\n"
+        "@init" "\n"
+        "strcpy(#common, \"init\");" "\n"
+        "@block" "\n"
+        "block_sees_gfx = !strcmp(#from_gfx, \"hello\");" "\n"
+        "block_common = strlen(#common);" "\n"
+        "sprintf(#from_block, \"%d\", 12345);" "\n"
+        "@gfx 100 100" "\n"
+        "gfx_sees_block = strlen(#from_block);" "\n"
+        "gfx_common = strlen(#common);" "\n"
+        "strcpy(#from_gfx, \"hello\");" "\n";
+
+    scoped_new_dir dir_fx("${root}/Effects");
+    scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+
+    ysfx_config_u config{ysfx_config_new()};
+    ysfx_u fx{ysfx_new(config.get())};
+    REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+    REQUIRE(ysfx_compile(fx.get(), 0));
+
+    std::vector<uint8_t> pixels(100 * 100 * 4);
+    ysfx_gfx_config_t gc{};
+    gc.pixel_width = 100;
+    gc.pixel_height = 100;
+    gc.pixels = pixels.data();
+    gc.scale_factor = 1;
+
+    auto run_block = [&fx]() {
+        ysfx_real out[1] = {};
+        ysfx_real *outs[] = {out};
+        ysfx_process_double(fx.get(), nullptr, outs, 0, 1, 1);
+    };
+
+    ysfx_real *block_sees_gfx = ysfx_find_var(fx.get(), "block_sees_gfx");
+    ysfx_real *block_common = ysfx_find_var(fx.get(), "block_common");
+    ysfx_real *gfx_sees_block = ysfx_find_var(fx.get(), "gfx_sees_block");
+    ysfx_real *gfx_common = ysfx_find_var(fx.get(), "gfx_common");
+
+    SECTION("the modifications pass from either side to the other")
+    {
+        run_block();
+        REQUIRE(*block_sees_gfx == 0);
+        REQUIRE(*block_common == 4);
+
+        ysfx_gfx_setup(fx.get(), &gc);
+        ysfx_gfx_run(fx.get());
+        REQUIRE(*gfx_sees_block == 5);
+        REQUIRE(*gfx_common == 4);
+
+        run_block();
+        REQUIRE(*block_sees_gfx == 1);
+    }
+
+    SECTION("processing does not wait for @gfx")
+    {
+        run_block();
+
+        std::atomic<bool> done{false};
+        std::thread gfx_thread([&]() {
+            ysfx_gfx_setup(fx.get(), &gc);
+            do
+                ysfx_gfx_run(fx.get());
+            while (!done.load());
+        });
+        for (uint32_t i = 0; i < 1000; ++i)
+            run_block();
+        done.store(true);
+        gfx_thread.join();
+
+        run_block();
+        REQUIRE(*block_sees_gfx == 1);
+        REQUIRE(*block_common == 4);
+    }
+
+    SECTION("a clone leaves the modifications of @gfx to the original")
+    {
+        run_block();
+        ysfx_gfx_setup(fx.get(), &gc);
+        ysfx_gfx_run(fx.get());
+
+        ysfx_u clone{ysfx_clone(fx.get())};
+        REQUIRE(clone);
+
+        run_block();
+        REQUIRE(*block_sees_gfx == 1);
+    }
+}
+
+TEST_CASE("long strings shared with @gfx", "[concurrency]")
+{
+    // more text than a batch holds at once
+    const char *text =
+        "desc:example" "\n"
+        "out_pin:output" "\n"
+        "@block" "\n"
+        "len_a = strlen(#a);" "\n"
+        "len_b = strlen(#b);" "\n"
+        "len_c = strlen(#c);" "\n"
+        "@gfx 100 100" "\n"
+        "!done ? (" "\n"
+        "  str_setlen(#a, 60000);" "\n"
+        "  strcpy(#b, #a);" "\n"
+        "  strcpy(#c, #a);" "\n"
+        "  done = 1;" "\n"
+        ");" "\n";
+
+    scoped_new_dir dir_fx("${root}/Effects");
+    scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+
+    ysfx_config_u config{ysfx_config_new()};
+    ysfx_u fx{ysfx_new(config.get())};
+    REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+    REQUIRE(ysfx_compile(fx.get(), 0));
+
+    std::vector<uint8_t> pixels(100 * 100 * 4);
+    ysfx_gfx_config_t gc{};
+    gc.pixel_width = 100;
+    gc.pixel_height = 100;
+    gc.pixels = pixels.data();
+    gc.scale_factor = 1;
+
+    auto run_block = [&fx]() {
+        ysfx_real out[1] = {};
+        ysfx_real *outs[] = {out};
+        ysfx_process_double(fx.get(), nullptr, outs, 0, 1, 1);
+    };
+
+    ysfx_real *len_a = ysfx_find_var(fx.get(), "len_a");
+    ysfx_real *len_b = ysfx_find_var(fx.get(), "len_b");
+    ysfx_real *len_c = ysfx_find_var(fx.get(), "len_c");
+
+    run_block();
+    ysfx_gfx_setup(fx.get(), &gc);
+    ysfx_gfx_run(fx.get());
+
+    // the string which did not fit waits for the next exchange
+    run_block();
+    REQUIRE(*len_a == 60000);
+    REQUIRE(*len_b == 60000);
+    REQUIRE(*len_c == 0);
+
+    ysfx_gfx_run(fx.get());
+    run_block();
+    REQUIRE(*len_c == 60000);
+}
+#endif
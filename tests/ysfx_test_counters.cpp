@@ -0,0 +1,159 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "ysfx.h"
+#include "ysfx_test_utils.hpp"
+#include <catch.hpp>
+
+TEST_CASE("runtime counters", "[counters]")
+{
+    SECTION("init and slider")
+    {
+        const char *text =
+            "desc:example" "\n"
+            "out_pin:output" "\n"
+            "slider1:0<0,1,0.1>the slider" "\n"
+            "@block" "\n"
+            "x=1;" "\n";
+
+        scoped_new_dir dir_fx("${root}/Effects");
+        scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+
+        ysfx_config_u config{ysfx_config_new()};
+        ysfx_u fx{ysfx_new(config.get())};
+        REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(fx.get(), 0));
+
+        ysfx_counters_t counters{};
+        ysfx_get_counters(fx.get(), &counters);
+        REQUIRE(counters.init == 0);
+        REQUIRE(counters.blocks == 0);
+
+        ysfx_init(fx.get());
+        for (uint32_t i = 0; i < 4; ++i)
+            ysfx_process_float(fx.get(), nullptr, nullptr, 0, 0, 1);
+        ysfx_slider_set_value(fx.get(), 0, 0.5);
+        ysfx_process_float(fx.get(), nullptr, nullptr, 0, 0, 1);
+
+        ysfx_get_counters(fx.get(), &counters);
+        REQUIRE(counters.init == 1);
+        REQUIRE(counters.slider == 2);
+        REQUIRE(counters.blocks == 5);
+        REQUIRE(counters.transport_restarts == 0);
+
+        ysfx_time_info_t info{};
+        info.tempo = 120;
+        info.time_signature[0] = 4;
+        info.time_signature[1] = 4;
+        info.playback_state = ysfx_playback_paused;
+        ysfx_set_time_info(fx.get(), &info);
+        for (uint32_t i = 0; i < 3; ++i) {
+            info.playback_state = ysfx_playback_playing;
+            ysfx_set_time_info(fx.get(), &info);
+            ysfx_process_float(fx.get(), nullptr, nullptr, 0, 0, 1);
+            info.playback_state = ysfx_playback_paused;
+            ysfx_set_time_info(fx.get(), &info);
+            ysfx_process_float(fx.get(), nullptr, nullptr, 0, 0, 1);
+        }
+
+        ysfx_get_counters(fx.get(), &counters);
+        REQUIRE(counters.transport_restarts == 3);
+        REQUIRE(counters.init == 4);
+        REQUIRE(counters.slider == 5);
+        REQUIRE(counters.blocks == 11);
+    }
+
+    SECTION("midi")
+    {
+        const char *text =
+            "desc:example" "\n"
+            "out_pin:output" "\n"
+            "@block" "\n"
+            "while (midirecv(offset, msg1, msg2, msg3)) (" "\n"
+            "  midisend(offset, msg1, msg2, msg3);" "\n"
+            "  midisend(offset, msg1, msg2, msg3);" "\n"
+            ");" "\n";
+
+        scoped_new_dir dir_fx("${root}/Effects");
+        scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+
+        ysfx_config_u config{ysfx_config_new()};
+        ysfx_u fx{ysfx_new(config.get())};
+        REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(fx.get(), 0));
+        // room for 4 events of 3 bytes, each with a header of 12 bytes
+        ysfx_set_midi_capacity(fx.get(), 4 * 15, false);
+        ysfx_init(fx.get());
+
+        const uint8_t data[] = {0x90, 60, 0x40};
+        ysfx_midi_event_t event{};
+        event.size = sizeof(data);
+        event.data = data;
+
+        for (uint32_t i = 0; i < 2; ++i)
+            REQUIRE(ysfx_send_midi(fx.get(), &event));
+        ysfx_process_float(fx.get(), nullptr, nullptr, 0, 0, 1);
+
+        for (uint32_t i = 0; i < 4; ++i)
+            REQUIRE(ysfx_send_midi(fx.get(), &event));
+        REQUIRE(!ysfx_send_midi(fx.get(), &event));
+        ysfx_process_float(fx.get(), nullptr, nullptr, 0, 0, 1);
+
+        ysfx_counters_t counters{};
+        ysfx_get_counters(fx.get(), &counters);
+        REQUIRE(counters.midi_in == 6);
+        REQUIRE(counters.midi_in_dropped == 1);
+        REQUIRE(counters.midi_in_peak == 4);
+        REQUIRE(counters.midi_out == 8);
+        REQUIRE(counters.midi_out_dropped == 4);
+        REQUIRE(counters.midi_out_peak == 4);
+    }
+
+    SECTION("files")
+    {
+        const char *text =
+            "desc:example" "\n"
+            "filename:0,data.txt" "\n"
+            "out_pin:output" "\n"
+            "@init" "\n"
+            "i=0;" "\n"
+            "loop(100, handles[i]=file_open(0); i+=1);" "\n"
+            "file_close(handles[0]);" "\n";
+
+        scoped_new_dir dir_fx("${root}/Effects");
+        scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+        scoped_new_txt file_data("${root}/Effects/data.txt", "1 2 3");
+
+        ysfx_config_u config{ysfx_config_new()};
+        ysfx_u fx{ysfx_new(config.get())};
+        REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(fx.get(), 0));
+        ysfx_init(fx.get());
+
+        ysfx_counters_t counters{};
+        ysfx_get_counters(fx.get(), &counters);
+        REQUIRE(counters.open_files_limit == 63);
+        REQUIRE(counters.open_files_peak == 63);
+        REQUIRE(counters.open_files == 62);
+        REQUIRE(counters.file_handle_failures == 100 - 63);
+
+        ysfx_init(fx.get());
+        ysfx_get_counters(fx.get(), &counters);
+        REQUIRE(counters.open_files == 62);
+        REQUIRE(counters.file_handle_failures == 2 * (100 - 63));
+    }
+}
@@ -0,0 +1,492 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+#include "ysfx.h"
+#include "ysfx_audio_cache.hpp"
+#include "ysfx_prefetch.hpp"
+#include "ysfx_test_utils.hpp"
+#include "ysfx_utils.hpp"
+#include <catch.hpp>
+#include <vector>
+#include <random>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+#include <atomic>
+
+TEST_CASE("file access", "[file]")
+{
+    SECTION("raw file")
+    {
+        const char *text =
+            "desc:example" "\n"
+            "filename:0,data.raw" "\n"
+            "out_pin:output" "\n"
+            "@init" "\n"
+            "h=file_open(0);" "\n"
+            "avail0=file_avail(h);" "\n"
+            "count=file_mem(h, 65530, 100000);" "\n"
+            "avail1=file_avail(h);" "\n"
+            "slen=file_string(h, #str);" "\n"
+            "match=!strcmp(#str, \"hello\");" "\n"
+            "avail2=file_avail(h);" "\n"
+            "file_rewind(h);" "\n"
+            "file_var(h, v0);" "\n"
+            "file_var(h, v1);" "\n"
+            "avail3=file_avail(h);" "\n"
+            "file_close(h);" "\n";
+
+        const uint32_t value_count = 100000;
+        std::vector<float> values(value_count);
+        std::string data(4 * value_count, '\0');
+        for (uint32_t i = 0; i < value_count; ++i) {
+            values[i] = (float)i * 0.5f - 1000.0f;
+            ysfx::pack_f32le(values[i], (uint8_t *)&data[4 * i]);
+        }
+        {
+            uint8_t len[4];
+            ysfx::pack_u32le(5, len);
+            data.append((const char *)len, 4);
+            data.append("hello");
+        }
+
+        scoped_new_dir dir_fx("${root}/Effects");
+        scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+        scoped_new_txt file_data("${root}/Effects/data.raw", data.data(), data.size());
+
+        ysfx_config_u config{ysfx_config_new()};
+        ysfx_u fx{ysfx_new(config.get())};
+        REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(fx.get(), 0));
+        ysfx_init(fx.get());
+
+        REQUIRE(*ysfx_find_var(fx.get(), "avail0") == value_count + 2);
+        REQUIRE(*ysfx_find_var(fx.get(), "count") == value_count);
+        REQUIRE(*ysfx_find_var(fx.get(), "avail1") == 2);
+        REQUIRE(*ysfx_find_var(fx.get(), "slen") == 5);
+        REQUIRE(*ysfx_find_var(fx.get(), "match") == 1);
+        REQUIRE(*ysfx_find_var(fx.get(), "avail2") == 0);
+        REQUIRE(*ysfx_find_var(fx.get(), "v0") == values[0]);
+        REQUIRE(*ysfx_find_var(fx.get(), "v1") == values[1]);
+        REQUIRE(*ysfx_find_var(fx.get(), "avail3") == value_count);
+
+        // the range crosses a boundary of memory blocks
+        std::vector<ysfx_real> mem(value_count);
+        ysfx_read_vmem(fx.get(), 65530, mem.data(), value_count);
+        uint32_t mismatches = 0;
+        for (uint32_t i = 0; i < value_count; ++i)
+            mismatches += mem[i] != values[i];
+        REQUIRE(mismatches == 0);
+    }
+
+    SECTION("text file")
+    {
+        const char *text =
+            "desc:example" "\n"
+            "filename:0,data.txt" "\n"
+            "out_pin:output" "\n"
+            "@init" "\n"
+            "h=file_open(0);" "\n"
+            "istext=file_text(h);" "\n"
+            "file_string(h, #str);" "\n"
+            "match=!strcmp(#str, \"header line\\n\");" "\n"
+            "count=file_mem(h, 65530, 100000);" "\n"
+            "avail0=file_avail(h);" "\n"
+            "file_var(h, v0);" "\n"
+            "avail1=file_avail(h);" "\n"
+            "file_rewind(h);" "\n"
+            "avail2=file_avail(h);" "\n"
+            "file_var(h, v1);" "\n"
+            "file_close(h);" "\n";
+
+        const uint32_t value_count = 100000;
+        std::vector<double> values(value_count);
+        std::string data = "header line\n";
+        std::mt19937 prng;
+        for (uint32_t i = 0; i < value_count; ++i) {
+            char field[64];
+            switch (i % 4) {
+            case 0:
+                values[i] = (double)(int32_t)(prng() % 2000000) - 1000000;
+                sprintf(field, "%d", (int)values[i]);
+                break;
+            case 1:
+                values[i] = std::uniform_real_distribution<double>{-1.0, 1.0}(prng);
+                sprintf(field, " %.17g", values[i]);
+                break;
+            case 2:
+                values[i] = std::uniform_real_distribution<double>{-1e30, 1e30}(prng);
+                sprintf(field, "%.17e", values[i]);
+                break;
+            case 3:
+                values[i] = (double)(prng() % 1000) / 8;
+                sprintf(field, "%.3f", values[i]);
+                break;
+            }
+            data.append(field);
+            data.push_back((i % 10 == 9) ? '\n' : ',');
+            if (i % 1000 == 999)
+                data.append("not a number\n");
+        }
+
+        scoped_new_dir dir_fx("${root}/Effects");
+        scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+        scoped_new_txt file_data("${root}/Effects/data.txt", data.data(), data.size());
+
+        ysfx_config_u config{ysfx_config_new()};
+        ysfx_u fx{ysfx_new(config.get())};
+        REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(fx.get(), 0));
+        ysfx_init(fx.get());
+
+        REQUIRE(*ysfx_find_var(fx.get(), "istext") == 1);
+        REQUIRE(*ysfx_find_var(fx.get(), "match") == 1);
+        REQUIRE(*ysfx_find_var(fx.get(), "count") == value_count);
+        REQUIRE(*ysfx_find_var(fx.get(), "avail0") == 0);
+        REQUIRE(*ysfx_find_var(fx.get(), "avail1") == 1);
+        REQUIRE(*ysfx_find_var(fx.get(), "avail2") == 0);
+        REQUIRE(*ysfx_find_var(fx.get(), "v1") == values[0]);
+
+        // the effect runs with rounding toward zero, which affects the last bit
+        std::vector<ysfx_real> mem(value_count);
+        ysfx_read_vmem(fx.get(), 65530, mem.data(), value_count);
+        uint32_t mismatches = 0;
+        for (uint32_t i = 0; i < value_count; ++i)
+            mismatches += mem[i] != Approx(values[i]).epsilon(1e-15);
+        REQUIRE(mismatches == 0);
+    }
+
+    SECTION("prefetch")
+    {
+        const char *text =
+            "desc:example" "\n"
+            "filename:0,data.raw" "\n"
+            "out_pin:output" "\n"
+            "@init" "\n"
+            "h=file_open(0);" "\n"
+            "avail0=file_avail(h);" "\n"
+            "loaded=0;" "\n"
+            "@block" "\n"
+            "!loaded && file_avail(h) >= 0 ? (" "\n"
+            "  avail1=file_avail(h);" "\n"
+            "  count=file_mem(h, 1000, avail1);" "\n"
+            "  loaded=1;" "\n"
+            ");" "\n";
+
+        const uint32_t value_count = 1000;
+        std::string data(4 * value_count, '\0');
+        for (uint32_t i = 0; i < value_count; ++i)
+            ysfx::pack_f32le((float)i, (uint8_t *)&data[4 * i]);
+
+        scoped_new_dir dir_fx("${root}/Effects");
+        scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+        scoped_new_txt file_data("${root}/Effects/data.raw", data.data(), data.size());
+
+        ysfx_config_u config{ysfx_config_new()};
+        ysfx_set_file_prefetch(config.get(), 1 << 20);
+        ysfx_u fx{ysfx_new(config.get())};
+        REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(fx.get(), 0));
+        ysfx_init(fx.get());
+
+        // the file may or may not be ready yet
+        ysfx_real avail0 = *ysfx_find_var(fx.get(), "avail0");
+        REQUIRE((avail0 == -1 || avail0 == value_count));
+
+        ysfx_wait_file_prefetch(config.get());
+
+        ysfx_real out[1] = {};
+        ysfx_real *outs[] = {out};
+        ysfx_process_double(fx.get(), nullptr, outs, 0, 1, 1);
+
+        REQUIRE(*ysfx_find_var(fx.get(), "loaded") == 1);
+        REQUIRE(*ysfx_find_var(fx.get(), "avail1") == value_count);
+        REQUIRE(*ysfx_find_var(fx.get(), "count") == value_count);
+
+        std::vector<ysfx_real> mem(value_count);
+        ysfx_read_vmem(fx.get(), 1000, mem.data(), value_count);
+        uint32_t mismatches = 0;
+        for (uint32_t i = 0; i < value_count; ++i)
+            mismatches += mem[i] != i;
+        REQUIRE(mismatches == 0);
+    }
+
+    SECTION("prefetch failure")
+    {
+        // an audio format which fails to open any file
+        ysfx_audio_format_t fmt{};
+        fmt.open = [](const char *) -> ysfx_audio_reader_t * { return nullptr; };
+        fmt.close = [](ysfx_audio_reader_t *) {};
+
+        // as well as files of other types which do not exist
+        ysfx_file_type_t type = GENERATE(ysfx_file_type_audio, ysfx_file_type_raw, ysfx_file_type_txt);
+        scoped_new_dir dir_fx("${root}/Effects");
+
+        ysfx_prefetcher_u prefetcher{ysfx_prefetcher_new(1 << 20)};
+        std::shared_ptr<ysfx_prefetch_job_t> job{new ysfx_prefetch_job_t};
+        job->type = type;
+        job->fmt = fmt;
+        job->path = dir_fx.m_path + "/missing.dat";
+        ysfx_file_u file{new ysfx_prefetched_file_t(job)};
+        REQUIRE(file->avail() == -1);
+
+        ysfx_prefetcher_submit(prefetcher.get(), std::move(job));
+        ysfx_prefetcher_wait(prefetcher.get());
+
+        // it's told apart from a file which is not ready yet
+        REQUIRE(file->avail() == -2);
+        ysfx_real value = 1;
+        REQUIRE(!file->var(&value));
+        REQUIRE(value == 1);
+    }
+
+    SECTION("decimal parsing")
+    {
+        const char *inputs[] = {
+            "", " ", "x", ".", "-", "+.5", "-0", "1e", "1e+", "2.5e-3x", "  42 ",
+            "0x1A", "inf", "-nan", "1e400", "4.9e-324", "123456789012345678901234",
+            "0.000000000000000000000000000001", "9007199254740993", "1.7976931348623157e308",
+            "3.14159265358979323846", "1e22", "1e23", "-123.456e-7",
+        };
+
+        for (const char *input : inputs) {
+            INFO("input: \"" << input << "\"");
+            size_t length = strlen(input);
+            char *expected_end = nullptr;
+            double expected = ysfx::dot_strtod(input, &expected_end);
+            const char *end = nullptr;
+            double value = ysfx::dot_strtod_range(input, input + length, &end);
+            REQUIRE(end - input == expected_end - input);
+            if (expected == expected)
+                REQUIRE(value == expected);
+            else
+                REQUIRE(value != value);
+        }
+
+        // the end of the range delimits the number
+        const char *end = nullptr;
+        REQUIRE(ysfx::dot_strtod_range("1234", &"1234"[2], &end) == 12);
+        REQUIRE(*end == '3');
+    }
+}
+
+//------------------------------------------------------------------------------
+// an audio format, whose files contain the number of samples as text
+namespace {
+struct counting_reader_t {
+    uint64_t total = 0;
+    uint64_t pos = 0;
+};
+
+int counting_opens = 0;
+
+bool counting_can_handle(const char *path)
+{
+    return ysfx::path_has_suffix(path, "cnt");
+}
+
+ysfx_audio_reader_t *counting_open(const char *path)
+{
+    std::ifstream stream(path);
+    counting_reader_t *reader = new counting_reader_t;
+    stream >> reader->total;
+    ++counting_opens;
+    return (ysfx_audio_reader_t *)reader;
+}
+
+void counting_close(ysfx_audio_reader_t *reader)
+{
+    delete (counting_reader_t *)reader;
+}
+
+ysfx_audio_file_info_t counting_info(ysfx_audio_reader_t *)
+{
+    ysfx_audio_file_info_t info;
+    info.channels = 1;
+    info.sample_rate = 44100;
+    return info;
+}
+
+uint64_t counting_avail(ysfx_audio_reader_t *reader_)
+{
+    counting_reader_t *reader = (counting_reader_t *)reader_;
+    return reader->total - reader->pos;
+}
+
+void counting_rewind(ysfx_audio_reader_t *reader_)
+{
+    counting_reader_t *reader = (counting_reader_t *)reader_;
+    reader->pos = 0;
+}
+
+uint64_t counting_read(ysfx_audio_reader_t *reader_, ysfx_real *samples, uint64_t count)
+{
+    counting_reader_t *reader = (counting_reader_t *)reader_;
+    uint64_t n = 0;
+    for (; n < count && reader->pos < reader->total; ++n)
+        samples[n] = (ysfx_real)reader->pos++;
+    return n;
+}
+
+ysfx_audio_format_t counting_format = {
+    &counting_can_handle,
+    &counting_open,
+    &counting_close,
+    &counting_info,
+    &counting_avail,
+    &counting_rewind,
+    &counting_read,
+};
+
+// opens like the above, but the first opening waits until it's released
+std::atomic<int> blocking_state{0};
+
+ysfx_audio_reader_t *blocking_open(const char *path)
+{
+    int expected = 0;
+    if (blocking_state.compare_exchange_strong(expected, 1)) {
+        while (blocking_state.load() != 2)
+            std::this_thread::yield();
+    }
+    return counting_open(path);
+}
+} // namespace
+
+TEST_CASE("audio cache", "[file]")
+{
+    const char *text =
+        "desc:example" "\n"
+        "filename:0,a.cnt" "\n"
+        "filename:1,b.cnt" "\n"
+        "slider1:0<0,1,1>File" "\n"
+        "out_pin:output" "\n"
+        "@init" "\n"
+        "h=file_open(slider1);" "\n"
+        "avail=file_avail(h);" "\n"
+        "count=file_mem(h, 0, avail);" "\n"
+        "file_rewind(h);" "\n"
+        "file_var(h, first);" "\n"
+        "file_close(h);" "\n";
+
+    scoped_new_dir dir_fx("${root}/Effects");
+    scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+    scoped_new_txt file_a("${root}/Effects/a.cnt", "1000");
+    scoped_new_txt file_b("${root}/Effects/b.cnt", "2000");
+
+    const uint64_t size_a = 1000 * sizeof(ysfx_real);
+    const uint64_t size_b = 2000 * sizeof(ysfx_real);
+
+    auto load = [&file_main](ysfx_audio_cache_t *cache, uint32_t file) -> ysfx_u {
+        ysfx_config_u config{ysfx_config_new()};
+        ysfx_register_audio_format(config.get(), &counting_format);
+        ysfx_set_audio_cache(config.get(), cache);
+        ysfx_u fx{ysfx_new(config.get())};
+        REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(fx.get(), 0));
+        ysfx_slider_set_value(fx.get(), 0, (ysfx_real)file);
+        ysfx_init(fx.get());
+        return fx;
+    };
+
+    SECTION("sharing")
+    {
+        ysfx_audio_cache_u cache{ysfx_audio_cache_new(1 << 20)};
+        counting_opens = 0;
+
+        ysfx_u fx1 = load(cache.get(), 0);
+        ysfx_u fx2 = load(cache.get(), 0);
+        REQUIRE(counting_opens == 1);
+
+        for (ysfx_t *fx : {fx1.get(), fx2.get()}) {
+            REQUIRE(*ysfx_find_var(fx, "avail") == 1000);
+            REQUIRE(*ysfx_find_var(fx, "count") == 1000);
+            REQUIRE(*ysfx_find_var(fx, "first") == 0);
+            ysfx_real mem[1000];
+            ysfx_read_vmem(fx, 0, mem, 1000);
+            uint32_t mismatches = 0;
+            for (uint32_t i = 0; i < 1000; ++i)
+                mismatches += mem[i] != i;
+            REQUIRE(mismatches == 0);
+        }
+
+        REQUIRE(ysfx_audio_cache_get_size(cache.get()) >= size_a);
+        REQUIRE(ysfx_audio_cache_get_size(cache.get()) < size_a + 1024);
+    }
+
+    SECTION("modification")
+    {
+        ysfx_audio_cache_u cache{ysfx_audio_cache_new(1 << 20)};
+        counting_opens = 0;
+
+        ysfx_u fx1 = load(cache.get(), 0);
+        REQUIRE(*ysfx_find_var(fx1.get(), "avail") == 1000);
+
+        scoped_new_txt file_a2("${root}/Effects/a.cnt", "500");
+        ysfx_u fx2 = load(cache.get(), 0);
+        REQUIRE(counting_opens == 2);
+        REQUIRE(*ysfx_find_var(fx2.get(), "avail") == 500);
+    }
+
+    SECTION("capacity")
+    {
+        // fits either file, but not both
+        ysfx_audio_cache_u cache{ysfx_audio_cache_new(size_b + 1024)};
+        counting_opens = 0;
+
+        load(cache.get(), 0);
+        load(cache.get(), 1);
+        REQUIRE(ysfx_audio_cache_get_size(cache.get()) >= size_b);
+        REQUIRE(ysfx_audio_cache_get_size(cache.get()) < size_b + 1024);
+        load(cache.get(), 1);
+        REQUIRE(counting_opens == 2);
+        load(cache.get(), 0);
+        REQUIRE(counting_opens == 3);
+
+        // too large to be cached, so it's decoded by the effect
+        ysfx_audio_cache_u small_cache{ysfx_audio_cache_new(size_a / 2)};
+        counting_opens = 0;
+        ysfx_u fx = load(small_cache.get(), 0);
+        REQUIRE(*ysfx_find_var(fx.get(), "count") == 1000);
+        REQUIRE(ysfx_audio_cache_get_size(small_cache.get()) == 0);
+        REQUIRE(counting_opens == 2);
+    }
+
+    SECTION("no waiting for another decoding")
+    {
+        ysfx_audio_cache_u cache{ysfx_audio_cache_new(1 << 20)};
+        ysfx_audio_format_t fmt = counting_format;
+        fmt.open = &blocking_open;
+        blocking_state = 0;
+
+        const char *path = file_a.m_path.c_str();
+        std::thread decoder([&cache, &fmt, path]() {
+            ysfx_audio_cache_get(cache.get(), fmt, path);
+        });
+        while (blocking_state.load() != 1)
+            std::this_thread::yield();
+
+        // the caller is left to read the file by itself
+        REQUIRE(!ysfx_audio_cache_get(cache.get(), fmt, path));
+
+        blocking_state = 2;
+        decoder.join();
+        std::shared_ptr<const ysfx_decoded_audio_t> data = ysfx_audio_cache_get(cache.get(), fmt, path);
+        REQUIRE(data);
+        REQUIRE(data->samples.size() == 1000);
+    }
+}
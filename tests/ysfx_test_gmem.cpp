@@ -0,0 +1,198 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "ysfx.h"
+#include "ysfx_test_utils.hpp"
+#include <catch.hpp>
+#include <thread>
+#include <vector>
+
+TEST_CASE("shared memory", "[gmem]")
+{
+    auto make_text = [](const char *gmem_name, const char *code) -> std::string {
+        std::string text =
+            "desc:example" "\n"
+            "out_pin:output" "\n";
+        if (gmem_name)
+            text += std::string("options:gmem=") + gmem_name + "\n";
+        text += code;
+        return text;
+    };
+
+    const char *code_sender =
+        "@block" "\n"
+        "gmem[100000]=42;" "\n"
+        "atomic_set(gmem[0], 1);" "\n";
+    const char *code_receiver =
+        "@block" "\n"
+        "atomic_get(gmem[0]) ? value=gmem[100000];" "\n";
+
+    scoped_new_dir dir_fx("${root}/Effects");
+    scoped_new_txt file_sender("${root}/Effects/sender.jsfx", make_text("test", code_sender).c_str());
+    scoped_new_txt file_receiver("${root}/Effects/receiver.jsfx", make_text("test", code_receiver).c_str());
+    scoped_new_txt file_other("${root}/Effects/other.jsfx", make_text("other", code_receiver).c_str());
+
+    auto run_block = [](ysfx_t *fx) {
+        ysfx_real out[1] = {};
+        ysfx_real *outs[] = {out};
+        ysfx_process_double(fx, nullptr, outs, 0, 1, 1);
+    };
+
+    ysfx_config_u config{ysfx_config_new()};
+
+    auto load = [&config](const scoped_new_txt &file) -> ysfx_t * {
+        ysfx_u fx{ysfx_new(config.get())};
+        REQUIRE(ysfx_load_file(fx.get(), file.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(fx.get(), 0));
+        return fx.release();
+    };
+
+    ysfx_u sender{load(file_sender)};
+    ysfx_u receiver{load(file_receiver)};
+    ysfx_u other{load(file_other)};
+
+    run_block(sender.get());
+    run_block(receiver.get());
+    run_block(other.get());
+
+    REQUIRE(*ysfx_find_var(receiver.get(), "value") == 42);
+    REQUIRE(*ysfx_find_var(other.get(), "value") == 0);
+
+    SECTION("the memory lives as long as the users")
+    {
+        sender.reset();
+        receiver.reset();
+
+        ysfx_u receiver2{load(file_receiver)};
+        run_block(receiver2.get());
+        REQUIRE(*ysfx_find_var(receiver2.get(), "value") == 0);
+    }
+
+    SECTION("the memory survives recompilation")
+    {
+        sender.reset();
+        REQUIRE(ysfx_compile(receiver.get(), 0));
+        run_block(receiver.get());
+        REQUIRE(*ysfx_find_var(receiver.get(), "value") == 42);
+    }
+
+    SECTION("the memory is shared across configurations")
+    {
+        // like instances of a plugin, which have a configuration each
+        ysfx_config_u config2{ysfx_config_new()};
+        ysfx_u receiver2{ysfx_new(config2.get())};
+        REQUIRE(ysfx_load_file(receiver2.get(), file_receiver.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(receiver2.get(), 0));
+        run_block(receiver2.get());
+        REQUIRE(*ysfx_find_var(receiver2.get(), "value") == 42);
+    }
+}
+
+TEST_CASE("atomics", "[gmem]")
+{
+    const char *text =
+        "desc:example" "\n"
+        "options:gmem=atomics" "\n"
+        "out_pin:output" "\n"
+        "@block" "\n"
+        "i=0; loop(10000, atomic_add(gmem[0], 1); i+=1);" "\n"
+        "old=atomic_setifequal(gmem[1], 0, 5);" "\n"
+        "x=7; atomic_exch(gmem[2], x);" "\n";
+
+    scoped_new_dir dir_fx("${root}/Effects");
+    scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+
+    ysfx_config_u config{ysfx_config_new()};
+
+    const uint32_t num_fx = 4;
+    std::vector<ysfx_u> fxs(num_fx);
+    for (ysfx_u &fx : fxs) {
+        fx.reset(ysfx_new(config.get()));
+        REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(fx.get(), 0));
+    }
+
+    std::vector<std::thread> threads;
+    for (ysfx_u &fx : fxs) {
+        ysfx_t *fxp = fx.get();
+        threads.emplace_back([fxp]() {
+            ysfx_real out[1] = {};
+            ysfx_real *outs[] = {out};
+            ysfx_process_double(fxp, nullptr, outs, 0, 1, 1);
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+
+    const char *probe_text =
+        "desc:example" "\n"
+        "options:gmem=atomics" "\n"
+        "out_pin:output" "\n"
+        "@block" "\n"
+        "count=atomic_get(gmem[0]);" "\n"
+        "flag=atomic_get(gmem[1]);" "\n";
+    scoped_new_txt file_probe("${root}/Effects/probe.jsfx", probe_text);
+
+    ysfx_u probe{ysfx_new(config.get())};
+    REQUIRE(ysfx_load_file(probe.get(), file_probe.m_path.c_str(), 0));
+    REQUIRE(ysfx_compile(probe.get(), 0));
+    ysfx_real out[1] = {};
+    ysfx_real *outs[] = {out};
+    ysfx_process_double(probe.get(), nullptr, outs, 0, 1, 1);
+
+    REQUIRE(*ysfx_find_var(probe.get(), "count") == 10000 * num_fx);
+    REQUIRE(*ysfx_find_var(probe.get(), "flag") == 5);
+
+    // a single effect observed the zero before it was replaced
+    uint32_t num_first = 0;
+    for (ysfx_u &fx : fxs)
+        num_first += *ysfx_find_var(fx.get(), "old") == 0;
+    REQUIRE(num_first == 1);
+
+    // the exchanged values form a chain starting from zero
+    uint32_t num_zero = 0;
+    for (ysfx_u &fx : fxs)
+        num_zero += *ysfx_find_var(fx.get(), "x") == 0;
+    REQUIRE(num_zero == 1);
+}
+
+TEST_CASE("atomic exchange", "[gmem]")
+{
+    const char *text =
+        "desc:example" "\n"
+        "options:gmem=exchange" "\n"
+        "out_pin:output" "\n"
+        "@init" "\n"
+        "gmem[0]=3;" "\n"
+        "x=7;" "\n"
+        "result=atomic_exch(gmem[0], x);" "\n"
+        "a=gmem[0];" "\n";
+
+    scoped_new_dir dir_fx("${root}/Effects");
+    scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+
+    ysfx_config_u config{ysfx_config_new()};
+    ysfx_u fx{ysfx_new(config.get())};
+    REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+    REQUIRE(ysfx_compile(fx.get(), 0));
+    ysfx_init(fx.get());
+
+    // it returns the value of the second operand, as EEL2 does
+    REQUIRE(*ysfx_find_var(fx.get(), "result") == 7);
+    REQUIRE(*ysfx_find_var(fx.get(), "a") == 7);
+    REQUIRE(*ysfx_find_var(fx.get(), "x") == 3);
+}
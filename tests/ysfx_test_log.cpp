@@ -0,0 +1,103 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "ysfx.h"
+#include "ysfx_test_utils.hpp"
+#include <catch.hpp>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <thread>
+
+namespace {
+struct log_collector {
+    std::mutex mutex;
+    std::vector<std::string> messages;
+
+    static void report(intptr_t userdata, ysfx_log_level, const char *message)
+    {
+        log_collector *self = (log_collector *)userdata;
+        std::lock_guard<std::mutex> lock{self->mutex};
+        self->messages.emplace_back(message);
+    }
+
+    size_t count()
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        return messages.size();
+    }
+};
+} // namespace
+
+TEST_CASE("asynchronous logging", "[log]")
+{
+    log_collector collector;
+    ysfx_config_u config{ysfx_config_new()};
+    ysfx_set_log_reporter(config.get(), &log_collector::report);
+    ysfx_set_user_data(config.get(), (intptr_t)&collector);
+
+    ysfx_u fx{ysfx_new(config.get())};
+
+    SECTION("synchronous by default")
+    {
+        REQUIRE(!ysfx_compile(fx.get(), 0));
+        REQUIRE(collector.count() == 1);
+        REQUIRE(ysfx_drain_logs(config.get()) == 0);
+    }
+
+    SECTION("delivered on drain")
+    {
+        ysfx_set_async_logging(config.get(), 8, false);
+        REQUIRE(!ysfx_compile(fx.get(), 0));
+        REQUIRE(!ysfx_compile(fx.get(), 0));
+        REQUIRE(collector.count() == 0);
+        REQUIRE(ysfx_drain_logs(config.get()) == 2);
+        REQUIRE(collector.count() == 2);
+        REQUIRE(collector.messages[0] == collector.messages[1]);
+        REQUIRE(ysfx_drain_logs(config.get()) == 0);
+        REQUIRE(ysfx_get_dropped_logs(config.get()) == 0);
+    }
+
+    SECTION("dropped when full")
+    {
+        ysfx_set_async_logging(config.get(), 4, false);
+        for (uint32_t i = 0; i < 10; ++i)
+            REQUIRE(!ysfx_compile(fx.get(), 0));
+        REQUIRE(ysfx_drain_logs(config.get()) == 4);
+        REQUIRE(ysfx_get_dropped_logs(config.get()) == 6);
+    }
+
+    SECTION("delivered when made synchronous")
+    {
+        ysfx_set_async_logging(config.get(), 8, false);
+        REQUIRE(!ysfx_compile(fx.get(), 0));
+        ysfx_set_async_logging(config.get(), 0, false);
+        REQUIRE(collector.count() == 1);
+        REQUIRE(!ysfx_compile(fx.get(), 0));
+        REQUIRE(collector.count() == 2);
+    }
+
+    SECTION("delivered in the background")
+    {
+        ysfx_set_async_logging(config.get(), 8, true);
+        REQUIRE(!ysfx_compile(fx.get(), 0));
+        for (uint32_t i = 0; i < 200 && collector.count() == 0; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        REQUIRE(collector.count() == 1);
+    }
+}
@@ -0,0 +1,172 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "utility/lz_codec.h"
+#include <catch.hpp>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+static std::vector<uint8_t> lz_test_compress(const std::vector<uint8_t> &data)
+{
+    std::vector<uint8_t> compressed(lz_compress_bound(data.size()));
+    size_t size = lz_compress(data.data(), data.size(), compressed.data(), compressed.size());
+    REQUIRE(size > 0);
+    REQUIRE(size <= compressed.size());
+    compressed.resize(size);
+    return compressed;
+}
+
+static bool lz_test_decompress(const std::vector<uint8_t> &compressed, std::vector<uint8_t> &data, size_t expected_size)
+{
+    // exactly the expected size, so any write past the end is caught by the sanitizer
+    data.assign(expected_size, 0);
+    return lz_decompress(compressed.data(), compressed.size(), data.data(), expected_size);
+}
+
+static std::vector<uint8_t> lz_test_random(size_t size, uint32_t seed)
+{
+    std::mt19937 prng{seed};
+    std::vector<uint8_t> data(size);
+    for (uint8_t &byte : data)
+        byte = (uint8_t)(prng() & 0xff);
+    return data;
+}
+
+// numbers like those of a state: repeated values, small patterns and some noise
+static std::vector<uint8_t> lz_test_state_like(size_t size, uint32_t seed)
+{
+    std::mt19937 prng{seed};
+    std::vector<uint8_t> data;
+    data.reserve(size);
+    while (data.size() < size) {
+        switch (prng() % 4) {
+        case 0:
+            data.insert(data.end(), prng() % 1000, 0);
+            break;
+        case 1:
+            for (uint32_t i = 0, n = prng() % 100; i < n; ++i) {
+                const uint8_t pattern[] = {0x00, 0x00, 0x80, 0x3f};
+                data.insert(data.end(), pattern, pattern + sizeof(pattern));
+            }
+            break;
+        case 2:
+            for (uint32_t i = 0, n = prng() % 300; i < n; ++i)
+                data.push_back((uint8_t)(prng() & 0xff));
+            break;
+        case 3:
+            if (data.size() > 8) {
+                size_t start = prng() % data.size();
+                size_t length = std::min<size_t>(prng() % 2000, data.size() - start);
+                std::vector<uint8_t> copy(data.begin() + start, data.begin() + start + length);
+                data.insert(data.end(), copy.begin(), copy.end());
+            }
+            break;
+        }
+    }
+    data.resize(size);
+    return data;
+}
+
+TEST_CASE("lz codec", "[lz]")
+{
+    SECTION("round trip")
+    {
+        std::vector<std::vector<uint8_t>> inputs;
+        inputs.push_back({});
+        inputs.push_back({1});
+        inputs.push_back({1, 2, 3});
+        inputs.push_back(std::vector<uint8_t>(100000, 0));
+        inputs.push_back(lz_test_random(100000, 1));
+        inputs.push_back(lz_test_state_like(300000, 2));
+        // a pattern which repeats by overlapping matches
+        std::vector<uint8_t> pattern;
+        for (size_t i = 0; i < 5000; ++i)
+            pattern.push_back((uint8_t)"abc"[i % 3]);
+        inputs.push_back(pattern);
+        // the same data again, beyond the distance of a back-reference
+        std::vector<uint8_t> far = lz_test_random(70000, 3);
+        far.insert(far.end(), far.begin(), far.begin() + 10000);
+        inputs.push_back(far);
+
+        for (const std::vector<uint8_t> &input : inputs) {
+            std::vector<uint8_t> compressed = lz_test_compress(input);
+            std::vector<uint8_t> output;
+            REQUIRE(lz_test_decompress(compressed, output, input.size()));
+            REQUIRE(output == input);
+        }
+    }
+
+    SECTION("compression ratio")
+    {
+        std::vector<uint8_t> zeros(100000, 0);
+        REQUIRE(lz_test_compress(zeros).size() < 1000);
+
+        std::vector<uint8_t> noise = lz_test_random(100000, 4);
+        REQUIRE(lz_test_compress(noise).size() <= lz_compress_bound(noise.size()));
+    }
+
+    SECTION("insufficient capacity")
+    {
+        std::vector<uint8_t> input = lz_test_state_like(10000, 5);
+        std::vector<uint8_t> compressed = lz_test_compress(input);
+        std::vector<uint8_t> small(compressed.size() - 1);
+        REQUIRE(lz_compress(input.data(), input.size(), small.data(), small.size()) == 0);
+    }
+
+    SECTION("truncation")
+    {
+        std::vector<uint8_t> input = lz_test_state_like(20000, 6);
+        std::vector<uint8_t> compressed = lz_test_compress(input);
+        std::vector<uint8_t> output;
+
+        for (size_t size = 0; size < compressed.size(); ++size) {
+            std::vector<uint8_t> truncated(compressed.begin(), compressed.begin() + size);
+            REQUIRE(!lz_test_decompress(truncated, output, input.size()));
+        }
+
+        // the expected size must be exact as well
+        REQUIRE(!lz_test_decompress(compressed, output, input.size() - 1));
+        REQUIRE(!lz_test_decompress(compressed, output, input.size() + 1));
+    }
+
+    SECTION("corrupt input")
+    {
+        std::vector<uint8_t> output;
+
+        // a back-reference of zero, or before the start
+        const std::vector<uint8_t> zero_offset{0x10, 'a', 0x00, 0x00, 0x00};
+        REQUIRE(!lz_test_decompress(zero_offset, output, 5));
+        const std::vector<uint8_t> early_offset{0x10, 'a', 0x02, 0x00, 0x00};
+        REQUIRE(!lz_test_decompress(early_offset, output, 5));
+
+        // a length which continues past the end
+        const std::vector<uint8_t> long_literals{0xf0, 0xff, 0xff};
+        REQUIRE(!lz_test_decompress(long_literals, output, 1000));
+
+        // altered bytes do not make it read or write out of bounds
+        std::vector<uint8_t> input = lz_test_state_like(20000, 7);
+        std::vector<uint8_t> compressed = lz_test_compress(input);
+        std::mt19937 prng{8};
+        for (int i = 0; i < 2000; ++i) {
+            std::vector<uint8_t> corrupt = compressed;
+            for (int n = 1 + (int)(prng() % 4); n > 0; --n)
+                corrupt[prng() % corrupt.size()] = (uint8_t)(prng() & 0xff);
+            lz_test_decompress(corrupt, output, input.size());
+        }
+    }
+}
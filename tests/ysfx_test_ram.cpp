@@ -0,0 +1,329 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "ysfx.h"
+#include "ysfx_test_utils.hpp"
+#include <catch.hpp>
+#include <vector>
+#include <algorithm>
+
+TEST_CASE("memory preparation", "[ram]")
+{
+    auto make_text = [](const char *options) -> std::string {
+        std::string text =
+            "desc:example" "\n"
+            "out_pin:output" "\n";
+        if (options)
+            text += std::string("options:") + options + "\n";
+        text +=
+            "@block" "\n"
+            "buf[200000]=1;" "\n";
+        return text;
+    };
+
+    auto run_block = [](ysfx_t *fx) {
+        ysfx_real out[1] = {};
+        ysfx_real *outs[] = {out};
+        ysfx_process_double(fx, nullptr, outs, 0, 1, 1);
+    };
+
+    ysfx_config_u config{ysfx_config_new()};
+
+    SECTION("processing allocates")
+    {
+        scoped_new_dir dir_fx("${root}/Effects");
+        scoped_new_txt file_main("${root}/Effects/example.jsfx", make_text(nullptr).c_str());
+
+        ysfx_u fx{ysfx_new(config.get())};
+        REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(fx.get(), 0));
+        ysfx_init(fx.get());
+        REQUIRE(ysfx_get_late_ram_allocations(fx.get()) == 0);
+
+        run_block(fx.get());
+        REQUIRE(ysfx_get_late_ram_allocations(fx.get()) == 1);
+        run_block(fx.get());
+        REQUIRE(ysfx_get_late_ram_allocations(fx.get()) == 1);
+    }
+
+    SECTION("allocations outside of processing are not counted")
+    {
+        std::string text = make_text(nullptr) +
+            "@serialize" "\n"
+            "other[300000]=1;" "\n";
+        scoped_new_dir dir_fx("${root}/Effects");
+        scoped_new_txt file_main("${root}/Effects/example.jsfx", text.c_str());
+
+        ysfx_u fx{ysfx_new(config.get())};
+        REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(fx.get(), 0));
+        ysfx_init(fx.get());
+
+        ysfx_state_u state{ysfx_save_state(fx.get())};
+        REQUIRE(state);
+        ysfx_real value = 1;
+        ysfx_write_vmem(fx.get(), 400000, &value, 1);
+        REQUIRE(ysfx_get_late_ram_allocations(fx.get()) == 0);
+
+        run_block(fx.get());
+        REQUIRE(ysfx_get_late_ram_allocations(fx.get()) == 1);
+    }
+
+    SECTION("preallocation by the effect")
+    {
+        scoped_new_dir dir_fx("${root}/Effects");
+        scoped_new_txt file_main("${root}/Effects/example.jsfx", make_text("prealloc=*").c_str());
+
+        ysfx_u fx{ysfx_new(config.get())};
+        REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(fx.get(), 0));
+        ysfx_set_ram_options(fx.get(), ysfx_ram_option_prefault, 0);
+        ysfx_init(fx.get());
+
+        run_block(fx.get());
+        REQUIRE(ysfx_get_late_ram_allocations(fx.get()) == 0);
+    }
+
+    SECTION("preallocation by the host")
+    {
+        scoped_new_dir dir_fx("${root}/Effects");
+        scoped_new_txt file_main("${root}/Effects/example.jsfx", make_text(nullptr).c_str());
+
+        ysfx_u fx{ysfx_new(config.get())};
+        REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(fx.get(), 0));
+        ysfx_set_ram_options(fx.get(), ysfx_ram_option_prefault|ysfx_ram_option_lock, 200001);
+        ysfx_init(fx.get());
+
+        run_block(fx.get());
+        REQUIRE(ysfx_get_late_ram_allocations(fx.get()) == 0);
+
+        ysfx_u clone{ysfx_clone(fx.get())};
+        REQUIRE(clone);
+        run_block(clone.get());
+        REQUIRE(ysfx_get_late_ram_allocations(clone.get()) == 0);
+    }
+}
+
+TEST_CASE("memory arena", "[ram]")
+{
+    const char *text =
+        "desc:example" "\n"
+        "out_pin:output" "\n"
+        "@init" "\n"
+        "buf[0]=1;" "\n"
+        "@block" "\n"
+        "buf[200000]=2;" "\n";
+
+    auto run_block = [](ysfx_t *fx) {
+        ysfx_real out[1] = {};
+        ysfx_real *outs[] = {out};
+        ysfx_process_double(fx, nullptr, outs, 0, 1, 1);
+    };
+
+    scoped_new_dir dir_fx("${root}/Effects");
+    scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+
+    ysfx_config_u config{ysfx_config_new()};
+    ysfx_u fx{ysfx_new(config.get())};
+    REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+
+    uint32_t compileopts = GENERATE(ysfx_compile_ram_arena, ysfx_compile_ram_huge_pages);
+    REQUIRE(ysfx_compile(fx.get(), compileopts));
+    ysfx_init(fx.get());
+    run_block(fx.get());
+    REQUIRE(ysfx_get_late_ram_allocations(fx.get()) == 0);
+
+    ysfx_real values[2] = {};
+    ysfx_read_vmem(fx.get(), 0, &values[0], 1);
+    ysfx_read_vmem(fx.get(), 200000, &values[1], 1);
+    REQUIRE(values[0] == 1);
+    REQUIRE(values[1] == 2);
+
+    SECTION("only the used blocks are accounted")
+    {
+        ysfx_memory_stats_t stats{};
+        ysfx_get_memory_usage(fx.get(), &stats);
+        REQUIRE(stats.ram == 2 * 65536 * sizeof(ysfx_real));
+    }
+
+    SECTION("recompilation keeps the memory")
+    {
+        REQUIRE(ysfx_compile(fx.get(), 0));
+        ysfx_read_vmem(fx.get(), 200000, &values[1], 1);
+        REQUIRE(values[1] == 2);
+    }
+
+    SECTION("clones share the memory")
+    {
+        ysfx_u clone{ysfx_clone(fx.get())};
+        REQUIRE(clone);
+        ysfx_read_vmem(clone.get(), 200000, &values[1], 1);
+        REQUIRE(values[1] == 2);
+        run_block(fx.get());
+        ysfx_read_vmem(fx.get(), 0, &values[0], 1);
+        REQUIRE(values[0] == 1);
+    }
+}
+
+TEST_CASE("memory usage", "[ram]")
+{
+    const char *text =
+        "desc:example" "\n"
+        "out_pin:output" "\n"
+        "@init" "\n"
+        "buf[0]=1;" "\n"
+        "buf[100000]=1;" "\n"
+        "strcpy(#str, \"hello\");" "\n"
+        "@block" "\n"
+        "strcat(#str, \" world\");" "\n";
+
+    scoped_new_dir dir_fx("${root}/Effects");
+    scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+
+    ysfx_config_u config{ysfx_config_new()};
+    ysfx_u fx{ysfx_new(config.get())};
+    REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+    REQUIRE(ysfx_compile(fx.get(), 0));
+    ysfx_init(fx.get());
+
+    ysfx_memory_stats_t stats{};
+    ysfx_get_memory_usage(fx.get(), &stats);
+    REQUIRE(stats.ram == 2 * 65536 * sizeof(ysfx_real));
+    REQUIRE(stats.strings >= 6);
+    REQUIRE(stats.code > 0);
+    REQUIRE(stats.num_files == 0);
+    REQUIRE(stats.total == stats.ram + stats.strings + stats.code + stats.gfx_images + stats.midi);
+
+    SECTION("strings are measured by the processing")
+    {
+        uint64_t strings = stats.strings;
+        ysfx_real out[1] = {};
+        ysfx_real *outs[] = {out};
+        ysfx_process_double(fx.get(), nullptr, outs, 0, 1, 1);
+        ysfx_get_memory_usage(fx.get(), &stats);
+        REQUIRE(stats.strings == strings + 6);
+        ysfx_process_double(fx.get(), nullptr, outs, 0, 1, 1);
+        ysfx_get_memory_usage(fx.get(), &stats);
+        REQUIRE(stats.strings == strings + 12);
+    }
+}
+
+TEST_CASE("memory access", "[ram]")
+{
+    const char *text =
+        "desc:example" "\n"
+        "out_pin:output" "\n"
+        "@init" "\n"
+        "buf[65530]=1;" "\n"
+        "buf[65540]=2;" "\n";
+
+    scoped_new_dir dir_fx("${root}/Effects");
+    scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+
+    ysfx_config_u config{ysfx_config_new()};
+    ysfx_u fx{ysfx_new(config.get())};
+    REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+    REQUIRE(ysfx_compile(fx.get(), 0));
+    ysfx_init(fx.get());
+
+    SECTION("read across blocks")
+    {
+        std::vector<ysfx_real> values(20, -1);
+        ysfx_read_vmem(fx.get(), 65530, values.data(), 20);
+        REQUIRE(values[0] == 1);
+        REQUIRE(values[10] == 2);
+        REQUIRE(values[1] == 0);
+        REQUIRE(values[19] == 0);
+    }
+
+    SECTION("read across unallocated blocks")
+    {
+        // allocated, two unallocated, allocated
+        ysfx_real value = 3;
+        ysfx_write_vmem(fx.get(), 4 * 65536 + 5, &value, 1);
+
+        std::vector<ysfx_real> values(3 * 65536 + 20, -1);
+        ysfx_read_vmem(fx.get(), 65530, values.data(), (uint32_t)values.size());
+        REQUIRE(values[0] == 1);
+        REQUIRE(values[10] == 2);
+        REQUIRE(values[3 * 65536 + 11] == 3);
+        values[0] = values[10] = values[3 * 65536 + 11] = 0;
+        REQUIRE(std::all_of(values.begin(), values.end(), [](ysfx_real x) { return x == 0; }));
+
+        // starting in the middle of an unallocated block, and past the end
+        std::vector<ysfx_real> result(100, -1);
+        ysfx_read_vmem(fx.get(), 4 * 65536 - 50, result.data(), 100);
+        REQUIRE(result[55] == 3);
+        ysfx_read_vmem(fx.get(), 0xfffffff0u, result.data(), 100);
+        REQUIRE(std::all_of(result.begin(), result.end(), [](ysfx_real x) { return x == 0; }));
+    }
+
+    SECTION("write across blocks")
+    {
+        std::vector<ysfx_real> values(100);
+        for (size_t i = 0; i < values.size(); ++i)
+            values[i] = (ysfx_real)i;
+        REQUIRE(ysfx_write_vmem(fx.get(), 65500, values.data(), 100) == 100);
+        REQUIRE(ysfx_write_vmem(fx.get(), 200000, values.data(), 100) == 100);
+
+        std::vector<ysfx_real> result(100);
+        ysfx_read_vmem(fx.get(), 65500, result.data(), 100);
+        REQUIRE(result == values);
+        ysfx_read_vmem(fx.get(), 200000, result.data(), 100);
+        REQUIRE(result == values);
+
+        uint32_t end = 8 * 1024 * 1024;
+        REQUIRE(ysfx_write_vmem(fx.get(), end - 10, values.data(), 100) == 10);
+    }
+
+    SECTION("map a range")
+    {
+        // allocated, unallocated, allocated
+        ysfx_real value = 3;
+        ysfx_write_vmem(fx.get(), 3 * 65536, &value, 1);
+
+        uint32_t count = ysfx_map_vmem_range(fx.get(), 65530, 3 * 65536, nullptr, 0);
+        REQUIRE(count >= 3);
+
+        std::vector<ysfx_vmem_span_t> spans(count);
+        REQUIRE(ysfx_map_vmem_range(fx.get(), 65530, 3 * 65536, spans.data(), count) == count);
+
+        uint32_t total = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            REQUIRE(spans[i].addr == 65530 + total);
+            total += spans[i].count;
+        }
+        REQUIRE(total == 3 * 65536);
+
+        REQUIRE(spans[0].data != nullptr);
+        REQUIRE(spans[0].data[0] == 1);
+        REQUIRE(spans.back().addr <= 3 * 65536);
+        REQUIRE(spans.back().data != nullptr);
+        REQUIRE(spans.back().data[3 * 65536 - spans.back().addr] == 3);
+    }
+
+    SECTION("map a range at the end of the address space")
+    {
+        ysfx_vmem_span_t spans[4] = {};
+        uint32_t count = ysfx_map_vmem_range(fx.get(), 0xfffffff0u, 256, spans, 4);
+        REQUIRE(count == 1);
+        REQUIRE(spans[0].addr == 0xfffffff0u);
+        REQUIRE(spans[0].count == 16);
+        REQUIRE(spans[0].data == nullptr);
+    }
+}
@@ -16,9 +16,12 @@
 //
 
 #include "ysfx.h"
+#include "ysfx.hpp"
 #include "ysfx_utils.hpp"
 #include "ysfx_test_utils.hpp"
 #include <catch.hpp>
+#include <vector>
+#include <cstring>
 
 TEST_CASE("save and load", "[serialization]")
 {
@@ -108,4 +111,278 @@ TEST_CASE("save and load", "[serialization]")
         REQUIRE(ysfx::unpack_f32le(&state->data[3 * sizeof(float)]) == 300);
         REQUIRE(ysfx::unpack_f32le(&state->data[4 * sizeof(float)]) == 400);
     };
+    SECTION("large memory")
+    {
+        // a range across several blocks, of which one is not allocated
+        const char *text =
+            "desc:example" "\n"
+            "out_pin:output" "\n"
+            "@init" "\n"
+            "i=0;" "\n"
+            "loop(20, 65530[i]=i+0.5; i+=1);" "\n"
+            "196613[0]=7;" "\n"
+            "@serialize" "\n"
+            "file_mem(0, 65530, 196608);" "\n"
+            "@sample" "\n"
+            "spl0=0.0;" "\n";
+
+        scoped_new_dir dir_fx("${root}/Effects");
+        scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+
+        ysfx_config_u config{ysfx_config_new()};
+        ysfx_u fx{ysfx_new(config.get())};
+
+        REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(fx.get(), 0));
+        ysfx_init(fx.get());
+
+        const uint32_t count = 196608;
+        ysfx_state_u state{ysfx_save_state(fx.get())};
+        REQUIRE(state);
+        REQUIRE(state->data_size == count * sizeof(float));
+
+        uint32_t mismatches = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            float expected = (i < 20) ? (i + 0.5f) : (i == 196613 - 65530) ? 7.0f : 0.0f;
+            mismatches += ysfx::unpack_f32le(&state->data[i * sizeof(float)]) != expected;
+        }
+        REQUIRE(mismatches == 0);
+
+        // load a state which is cut short, in the middle of a value
+        for (uint32_t i = 0; i < count; ++i)
+            ysfx::pack_f32le((float)(i + 1), &state->data[i * sizeof(float)]);
+        state->data_size = 100000 * sizeof(float) + 2;
+        REQUIRE(ysfx_load_state(fx.get(), state.get()));
+
+        std::vector<ysfx_real> values(count);
+        ysfx_read_vmem(fx.get(), 65530, values.data(), count);
+        mismatches = 0;
+        for (uint32_t i = 0; i < 100000; ++i)
+            mismatches += values[i] != (ysfx_real)(i + 1);
+        REQUIRE(mismatches == 0);
+        REQUIRE(values[100000] == 0);
+        REQUIRE(values[196613 - 65530] == 7);
+    };
+}
+
+TEST_CASE("state delta", "[serialization]")
+{
+    const char *text =
+        "desc:example" "\n"
+        "out_pin:output" "\n"
+        "slider1:1<1,3,0.1>the slider 1" "\n"
+        "@init" "\n"
+        "size=10000;" "\n"
+        "@serialize" "\n"
+        "file_var(0, size);" "\n"
+        "file_mem(0, 0, size);" "\n"
+        "@sample" "\n"
+        "spl0=0.0;" "\n";
+
+    scoped_new_dir dir_fx("${root}/Effects");
+    scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+
+    ysfx_config_u config{ysfx_config_new()};
+    ysfx_u fx{ysfx_new(config.get())};
+
+    REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+    REQUIRE(ysfx_compile(fx.get(), 0));
+    ysfx_init(fx.get());
+
+    ysfx_state_u base{ysfx_save_state(fx.get())};
+    REQUIRE(base);
+
+    auto require_same = [](ysfx_state_t *a, ysfx_state_t *b) {
+        REQUIRE(a->slider_count == b->slider_count);
+        for (uint32_t i = 0; i < a->slider_count; ++i) {
+            REQUIRE(a->sliders[i].index == b->sliders[i].index);
+            REQUIRE(a->sliders[i].value == b->sliders[i].value);
+        }
+        REQUIRE(a->data_size == b->data_size);
+        REQUIRE(memcmp(a->data, b->data, a->data_size) == 0);
+    };
+
+    SECTION("unchanged")
+    {
+        ysfx_state_u state{ysfx_save_state(fx.get())};
+        ysfx_state_delta_u delta{ysfx_state_diff(base.get(), state.get(), 0)};
+        REQUIRE(delta);
+        REQUIRE(delta->range_count == 0);
+        ysfx_state_u applied{ysfx_state_apply_delta(base.get(), delta.get())};
+        REQUIRE(applied);
+        require_same(applied.get(), state.get());
+    }
+
+    SECTION("changed in places")
+    {
+        // 4 bytes for `size`, then the memory; chunks of 1024 bytes hold 256 values
+        ysfx_real value = 1;
+        ysfx_write_vmem(fx.get(), 10, &value, 1);
+        ysfx_write_vmem(fx.get(), 300, &value, 1);
+        ysfx_write_vmem(fx.get(), 5000, &value, 1);
+        ysfx_slider_set_value(fx.get(), 0, 2);
+
+        ysfx_state_u state{ysfx_save_state(fx.get())};
+        ysfx_state_delta_u delta{ysfx_state_diff(base.get(), state.get(), 1024)};
+        REQUIRE(delta);
+        REQUIRE(delta->range_count == 2);
+        REQUIRE(delta->ranges[0].offset == 0);
+        REQUIRE(delta->ranges[0].size == 2048);
+        REQUIRE(delta->ranges[1].offset == 19 * 1024);
+        REQUIRE(delta->ranges[1].size == 1024);
+        REQUIRE(delta->sliders[0].value == 2);
+
+        ysfx_state_u applied{ysfx_state_apply_delta(base.get(), delta.get())};
+        REQUIRE(applied);
+        require_same(applied.get(), state.get());
+    }
+
+    SECTION("resized")
+    {
+        *ysfx_find_var(fx.get(), "size") = 20000;
+        ysfx_state_u larger{ysfx_save_state(fx.get())};
+        ysfx_state_delta_u delta{ysfx_state_diff(base.get(), larger.get(), 0)};
+        REQUIRE(delta);
+        ysfx_state_u applied{ysfx_state_apply_delta(base.get(), delta.get())};
+        REQUIRE(applied);
+        require_same(applied.get(), larger.get());
+
+        delta.reset(ysfx_state_diff(larger.get(), base.get(), 0));
+        REQUIRE(delta);
+        applied.reset(ysfx_state_apply_delta(larger.get(), delta.get()));
+        REQUIRE(applied);
+        require_same(applied.get(), base.get());
+
+        // a delta which does not fit is refused
+        delta->data_size = 10;
+        REQUIRE(!ysfx_state_apply_delta(larger.get(), delta.get()));
+    }
+
+    SECTION("another base")
+    {
+        ysfx_real value = 1;
+        ysfx_write_vmem(fx.get(), 10, &value, 1);
+        ysfx_state_u state{ysfx_save_state(fx.get())};
+        ysfx_state_delta_u delta{ysfx_state_diff(base.get(), state.get(), 0)};
+        REQUIRE(delta);
+
+        // a base of the same size, but other contents
+        ysfx_write_vmem(fx.get(), 9000, &value, 1);
+        ysfx_state_u other{ysfx_save_state(fx.get())};
+        REQUIRE(other->data_size == base->data_size);
+        REQUIRE(!ysfx_state_apply_delta(other.get(), delta.get()));
+
+        // a base of another size
+        *ysfx_find_var(fx.get(), "size") = 20000;
+        other.reset(ysfx_save_state(fx.get()));
+        REQUIRE(!ysfx_state_apply_delta(other.get(), delta.get()));
+
+        // the base of the diff is still accepted
+        ysfx_state_u applied{ysfx_state_apply_delta(base.get(), delta.get())};
+        REQUIRE(applied);
+        require_same(applied.get(), state.get());
+    }
+}
+
+TEST_CASE("state reuse", "[serialization]")
+{
+    const char *text =
+        "desc:example" "\n"
+        "out_pin:output" "\n"
+        "slider1:1<1,3,0.1>the slider 1" "\n"
+        "slider3:3<1,3,0.1>the slider 3" "\n"
+        "@init" "\n"
+        "size=100;" "\n"
+        "@serialize" "\n"
+        "file_var(0, size);" "\n"
+        "file_mem(0, 0, size);" "\n"
+        "@sample" "\n"
+        "spl0=0.0;" "\n";
+
+    scoped_new_dir dir_fx("${root}/Effects");
+    scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+
+    ysfx_config_u config{ysfx_config_new()};
+    ysfx_u fx{ysfx_new(config.get())};
+
+    REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+    REQUIRE(ysfx_compile(fx.get(), 0));
+    ysfx_init(fx.get());
+
+    SECTION("save into")
+    {
+        ysfx_state_u state{ysfx_save_state(fx.get())};
+        REQUIRE(state);
+        REQUIRE(state->slider_count == 2);
+        REQUIRE(state->sliders[0].index == 0);
+        REQUIRE(state->sliders[1].index == 2);
+        REQUIRE(state->sliders[1].value == 3);
+        REQUIRE(state->data_size == 101 * sizeof(float));
+
+        // a smaller state reuses the memory
+        uint8_t *data = state->data;
+        *ysfx_find_var(fx.get(), "size") = 50;
+        REQUIRE(ysfx_save_state_into(fx.get(), state.get()));
+        REQUIRE(state->data == data);
+        REQUIRE(state->data_size == 51 * sizeof(float));
+        REQUIRE(ysfx::unpack_f32le(&state->data[0]) == 50);
+
+        // a larger state grows it
+        *ysfx_find_var(fx.get(), "size") = 200;
+        REQUIRE(ysfx_save_state_into(fx.get(), state.get()));
+        REQUIRE(state->data_size == 201 * sizeof(float));
+
+        ysfx_state_u copy{ysfx_state_dup(state.get())};
+        REQUIRE(copy->data_size == state->data_size);
+        REQUIRE(memcmp(copy->data, state->data, state->data_size) == 0);
+    }
+
+    SECTION("pool")
+    {
+        ysfx_state_pool_u pool{ysfx_state_pool_new(1)};
+
+        ysfx_state_u state1{ysfx_state_pool_acquire(pool.get())};
+        ysfx_state_u state2{ysfx_state_pool_acquire(pool.get())};
+        REQUIRE(state1->data_size == 0);
+        REQUIRE(ysfx_save_state_into(fx.get(), state1.get()));
+        REQUIRE(ysfx_save_state_into(fx.get(), state2.get()));
+        ysfx_state_t *kept = state1.get();
+        uint8_t *data = state1->data;
+
+        // the pool keeps one of them, with its memory
+        state1.reset();
+        state2.reset();
+        state1.reset(ysfx_state_pool_acquire(pool.get()));
+        REQUIRE(state1.get() == kept);
+        REQUIRE(state1->slider_count == 0);
+        REQUIRE(state1->data_size == 0);
+        REQUIRE(ysfx_save_state_into(fx.get(), state1.get()));
+        REQUIRE(state1->data == data);
+
+        // the states outlive the pool
+        pool.reset();
+        ysfx_state_copy(state1.get(), state1.get());
+        REQUIRE(state1->data_size == 101 * sizeof(float));
+    }
+
+    SECTION("the buffer does not keep the peak size")
+    {
+        *ysfx_find_var(fx.get(), "size") = 100000;
+        ysfx_state_u state{ysfx_save_state(fx.get())};
+        REQUIRE(state);
+        REQUIRE(fx->serialization_buffer.capacity() >= 100001 * sizeof(float));
+
+        *ysfx_find_var(fx.get(), "size") = 100;
+        REQUIRE(ysfx_save_state_into(fx.get(), state.get()));
+        REQUIRE(fx->serialization_buffer.capacity() < 100001 * sizeof(float));
+
+        // neither after a load
+        *ysfx_find_var(fx.get(), "size") = 100000;
+        REQUIRE(ysfx_save_state_into(fx.get(), state.get()));
+        *ysfx_find_var(fx.get(), "size") = 100;
+        ysfx_state_u small{ysfx_save_state(fx.get())};
+        REQUIRE(ysfx_load_state(fx.get(), state.get()));
+        REQUIRE(ysfx_load_state(fx.get(), small.get()));
+        REQUIRE(fx->serialization_buffer.capacity() < 100001 * sizeof(float));
+    }
 }
@@ -50,6 +50,47 @@ TEST_CASE("slider manipulation", "[sliders]")
         REQUIRE(ysfx_slider_get_value(fx.get(), 1) == 3);
     }
 
+    SECTION("slider variables")
+    {
+        const char *text =
+            "desc:example" "\n"
+            "out_pin:output" "\n"
+            "slider1:foo=1<1,3,0.1>the slider 1" "\n"
+            "slider2:2<1,3,0.1>the slider 2" "\n"
+            "@init" "\n"
+            "Slider2=3;" "\n"
+            "slider64=4;" "\n"
+            "slider01=5;" "\n"
+            "slider65=6;" "\n"
+            "@block" "\n"
+            "sliderchange(foo);" "\n"
+            "sliderchange(slider2);" "\n";
+
+        scoped_new_dir dir_fx("${root}/Effects");
+        scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+
+        ysfx_config_u config{ysfx_config_new()};
+        ysfx_u fx{ysfx_new(config.get())};
+
+        REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(fx.get(), 0));
+        ysfx_init(fx.get());
+
+        REQUIRE(ysfx_slider_get_value(fx.get(), 1) == 3);
+        REQUIRE(ysfx_slider_get_value(fx.get(), 63) == 4);
+        REQUIRE(ysfx_find_var(fx.get(), "slider1") != nullptr);
+        REQUIRE(*ysfx_find_var(fx.get(), "slider2") == 3);
+        REQUIRE(*ysfx_find_var(fx.get(), "slider01") == 5);
+        REQUIRE(*ysfx_find_var(fx.get(), "slider65") == 6);
+
+        ysfx_real out[1] = {};
+        ysfx_real *outs[] = {out};
+        ysfx_process_double(fx.get(), nullptr, outs, 0, 1, 1);
+        REQUIRE(ysfx_get_slider_change_type(fx.get(), 0) == ysfx_slider_change_display);
+        REQUIRE(ysfx_get_slider_change_type(fx.get(), 1) == ysfx_slider_change_display);
+        REQUIRE(ysfx_get_slider_change_type(fx.get(), 2) == ysfx_slider_change_none);
+    }
+
     SECTION("slider visibility")
     {
         const char *text =
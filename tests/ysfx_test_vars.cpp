@@ -0,0 +1,80 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "ysfx.h"
+#include "ysfx_test_utils.hpp"
+#include <catch.hpp>
+
+TEST_CASE("variable lookup", "[vars]")
+{
+    const char *text =
+        "desc:example" "\n"
+        "out_pin:output" "\n"
+        "@init" "\n"
+        "peak_l=1;" "\n"
+        "peak_r=2;" "\n";
+
+    scoped_new_dir dir_fx("${root}/Effects");
+    scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+
+    ysfx_config_u config{ysfx_config_new()};
+    ysfx_u fx{ysfx_new(config.get())};
+    REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+
+    SECTION("before compilation")
+    {
+        REQUIRE(ysfx_find_var(fx.get(), "srate") != nullptr);
+        REQUIRE(ysfx_find_var(fx.get(), "peak_l") == nullptr);
+    }
+
+    SECTION("after compilation")
+    {
+        REQUIRE(ysfx_compile(fx.get(), 0));
+        ysfx_init(fx.get());
+
+        REQUIRE(ysfx_find_var(fx.get(), "srate") != nullptr);
+        REQUIRE(*ysfx_find_var(fx.get(), "peak_l") == 1);
+        REQUIRE(ysfx_find_var(fx.get(), "nonexistent") == nullptr);
+
+        const char *names[] = {"peak_l", "nonexistent", "peak_r"};
+        ysfx_real *vars[3] = {};
+        REQUIRE(ysfx_find_vars(fx.get(), names, vars, 3) == 2);
+        REQUIRE(vars[0] != nullptr);
+        REQUIRE(*vars[0] == 1);
+        REQUIRE(vars[1] == nullptr);
+        REQUIRE(vars[2] != nullptr);
+        REQUIRE(*vars[2] == 2);
+
+        // every variable is in the index
+        auto check_var = [](const char *name, ysfx_real *var, void *userdata) -> int {
+            ysfx_t *fx = (ysfx_t *)userdata;
+            REQUIRE(ysfx_find_var(fx, name) == var);
+            return 1;
+        };
+        ysfx_enum_vars(fx.get(), +check_var, fx.get());
+    }
+
+    SECTION("after recompilation")
+    {
+        REQUIRE(ysfx_compile(fx.get(), 0));
+        ysfx_unload(fx.get());
+        REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(fx.get(), 0));
+        ysfx_init(fx.get());
+        REQUIRE(*ysfx_find_var(fx.get(), "peak_r") == 2);
+    }
+}
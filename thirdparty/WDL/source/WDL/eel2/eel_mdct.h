@@ -729,10 +729,10 @@ static EEL_F * NSEEL_CGEN_CALL mdct_func(int dir, EEL_F **blocks, EEL_F *start,
 
     if (!mdct_ctxs[bidx])
     {
-      NSEEL_HOSTSTUB_EnterMutex();
+      NSEEL_HOSTSTUB_EnterRAMMutex();
       if (!mdct_ctxs[bidx])
         mdct_ctxs[bidx] = megabuf_mdct_init(ilen);
-      NSEEL_HOSTSTUB_LeaveMutex();
+      NSEEL_HOSTSTUB_LeaveRAMMutex();
     }
 
     if (mdct_ctxs[bidx])
@@ -178,6 +178,14 @@ typedef struct
 #define EEL_GROWBUF_GET(gb) ((gb)->_tval)
 #define EEL_GROWBUF_GET_SIZE(gb) ((gb)->_growbuf.size/(int)sizeof((gb)->_tval[0]))
 
+// ysfx: if func is set, it provides the RAM blocks in place of calloc(), called with the RAM mutex held;
+// it returns a zeroed block, or NULL on failure, and it does its own accounting of NSEEL_RAM_memused
+typedef struct
+{
+  EEL_F *(*func)(void *userctx, unsigned int whichblock);
+  void *userctx;
+} eel_ram_alloc_hook;
+
 typedef struct _compileContext
 {
   eel_function_table *registered_func_tab;
@@ -232,7 +240,7 @@ typedef struct _compileContext
 
   codeHandleType *tmpCodeHandle;
   
-  struct
+  struct eel_ram_state // ysfx: named, so __NSEEL_RAMAlloc can find it from the blocks
   {
     WDL_UINT64 sign_mask[2];
     WDL_UINT64 abs_mask[2];
@@ -240,6 +248,7 @@ typedef struct _compileContext
     int maxblocks;
     double closefact;
     EEL_F *blocks[NSEEL_RAM_BLOCKS];
+    eel_ram_alloc_hook alloc_hook; // ysfx
   } *ram_state; // allocated from blocks with 16 byte alignment
 
   void *gram_blocks;
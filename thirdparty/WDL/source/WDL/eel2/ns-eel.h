@@ -66,6 +66,11 @@ extern "C" {
 void NSEEL_HOSTSTUB_EnterMutex();
 void NSEEL_HOSTSTUB_LeaveMutex();
 
+  // ysfx: the allocations which code makes as it runs (RAM blocks, gmem, MDCT tables) take
+  // this one instead, so that running code never waits for a compilation holding the above
+void NSEEL_HOSTSTUB_EnterRAMMutex();
+void NSEEL_HOSTSTUB_LeaveRAMMutex();
+
 
 int NSEEL_init(); // returns nonzero on failure (only if EEL_VALIDATE_FSTUBS defined), otherwise the same as NSEEL_quit(), and completely optional
 void NSEEL_quit(); // clears any added functions
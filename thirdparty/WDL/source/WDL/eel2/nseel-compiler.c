@@ -5246,11 +5246,13 @@ had_error:
     handle->compile_flags = compile_flags;
     handle->ramPtr = ctx->ram_state->blocks;
     memcpy(handle->code_stats,ctx->l_stats,sizeof(ctx->l_stats));
+    NSEEL_HOSTSTUB_EnterMutex(); // ysfx: compilations can run in parallel
     nseel_evallib_stats[0]+=ctx->l_stats[0];
     nseel_evallib_stats[1]+=ctx->l_stats[1];
     nseel_evallib_stats[2]+=ctx->l_stats[2];
     nseel_evallib_stats[3]+=ctx->l_stats[3];
     nseel_evallib_stats[4]++;
+    NSEEL_HOSTSTUB_LeaveMutex();
   }
   else
   {
@@ -5338,11 +5340,13 @@ void NSEEL_code_free(NSEEL_CODEHANDLE code)
     }
 #endif
 
+    NSEEL_HOSTSTUB_EnterMutex(); // ysfx
     nseel_evallib_stats[0]-=h->code_stats[0];
     nseel_evallib_stats[1]-=h->code_stats[1];
     nseel_evallib_stats[2]-=h->code_stats[2];
     nseel_evallib_stats[3]-=h->code_stats[3];
     nseel_evallib_stats[4]--;
+    NSEEL_HOSTSTUB_LeaveMutex();
 
     freeBlocks(&h->blocks_code,1);
     freeBlocks(&h->blocks_data,0);
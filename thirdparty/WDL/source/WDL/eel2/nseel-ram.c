@@ -26,6 +26,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
 
 
 #ifdef _WIN32
@@ -60,7 +61,7 @@ void NSEEL_VM_freeRAMIfCodeRequested(NSEEL_VMCTX ctx) // check to see if our fre
     compileContext *c=(compileContext*)ctx;
     if (c->ram_state->needfree) 
     {
-      NSEEL_HOSTSTUB_EnterMutex();
+      NSEEL_HOSTSTUB_EnterRAMMutex();
       {
         INT_PTR startpos=((INT_PTR)c->ram_state->needfree)-1;
          EEL_F **blocks = c->ram_state->blocks;
@@ -83,7 +84,7 @@ void NSEEL_VM_freeRAMIfCodeRequested(NSEEL_VMCTX ctx) // check to see if our fre
          }
         c->ram_state->needfree=0;
       }
-      NSEEL_HOSTSTUB_LeaveMutex();
+      NSEEL_HOSTSTUB_LeaveRAMMutex();
     }
 
   }
@@ -107,7 +108,7 @@ EEL_F * NSEEL_CGEN_CALL __NSEEL_RAMAllocGMEM(EEL_F ***blocks, unsigned int w)
       EEL_F *p=NULL;
       if (!pblocks || !(p=pblocks[whichblock]))
       {
-        NSEEL_HOSTSTUB_EnterMutex();
+        NSEEL_HOSTSTUB_EnterRAMMutex();
         if (!nseel_gmem_calloc) nseel_gmem_calloc=calloc;
 
         if (!(pblocks=*blocks)) pblocks = *blocks = (EEL_F **)nseel_gmem_calloc(sizeof(EEL_F *),NSEEL_RAM_BLOCKS);
@@ -117,7 +118,7 @@ EEL_F * NSEEL_CGEN_CALL __NSEEL_RAMAllocGMEM(EEL_F ***blocks, unsigned int w)
         {
           p=pblocks[whichblock]=(EEL_F *)nseel_gmem_calloc(sizeof(EEL_F),NSEEL_RAM_ITEMSPERBLOCK);
         }
-        NSEEL_HOSTSTUB_LeaveMutex();
+        NSEEL_HOSTSTUB_LeaveRAMMutex();
       }
       if (p) return p + (w&(NSEEL_RAM_ITEMSPERBLOCK-1));
     }
@@ -126,9 +127,9 @@ EEL_F * NSEEL_CGEN_CALL __NSEEL_RAMAllocGMEM(EEL_F ***blocks, unsigned int w)
 
   if (!nseel_gmembuf_default)
   {
-    NSEEL_HOSTSTUB_EnterMutex(); 
+    NSEEL_HOSTSTUB_EnterRAMMutex(); 
     if (!nseel_gmembuf_default) nseel_gmembuf_default=(EEL_F*)calloc(sizeof(EEL_F),NSEEL_SHARED_GRAM_SIZE);
-    NSEEL_HOSTSTUB_LeaveMutex();
+    NSEEL_HOSTSTUB_LeaveRAMMutex();
     if (!nseel_gmembuf_default) return &nseel_ramalloc_onfail;
   }
 
@@ -145,19 +146,24 @@ EEL_F * NSEEL_CGEN_CALL  __NSEEL_RAMAlloc(EEL_F **pblocks, unsigned int w)
     EEL_F *p=pblocks[whichblock];
     if (!p && whichblock < ((unsigned int *)pblocks)[-3]) // pblocks -1/-2 are closefact, -3 is maxblocks
     {
-      NSEEL_HOSTSTUB_EnterMutex();
+      NSEEL_HOSTSTUB_EnterRAMMutex();
 
       if (!(p=pblocks[whichblock]))
       {
-
+        // ysfx: pblocks points to ram_state->blocks, which has the allocation hook
+        const eel_ram_alloc_hook *hook = &((struct eel_ram_state *)((char *)pblocks - offsetof(struct eel_ram_state, blocks)))->alloc_hook;
         const int msize=sizeof(EEL_F) * NSEEL_RAM_ITEMSPERBLOCK;
-        if (!NSEEL_RAM_limitmem || NSEEL_RAM_memused+msize < NSEEL_RAM_limitmem) 
+        if (hook->func)
+        {
+          p=pblocks[whichblock]=hook->func(hook->userctx,whichblock);
+        }
+        else if (!NSEEL_RAM_limitmem || NSEEL_RAM_memused+msize < NSEEL_RAM_limitmem) 
         {
           p=pblocks[whichblock]=(EEL_F *)calloc(sizeof(EEL_F),NSEEL_RAM_ITEMSPERBLOCK);
           if (p) NSEEL_RAM_memused+=msize;
         }
       }
-      NSEEL_HOSTSTUB_LeaveMutex();
+      NSEEL_HOSTSTUB_LeaveRAMMutex();
     }    
     if (p) return p + (w&(NSEEL_RAM_ITEMSPERBLOCK-1));
   }
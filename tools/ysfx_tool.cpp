@@ -161,6 +161,38 @@ void dump_header_info(ysfx_t *fx)
     }
 }
 
+void dump_memory_usage(ysfx_t *fx)
+{
+    printf("\n" "--- memory usage ---" "\n\n");
+
+    ysfx_memory_stats_t stats{};
+    ysfx_get_memory_usage(fx, &stats);
+
+    printf("RAM: %llu bytes\n", (unsigned long long)stats.ram);
+    printf("Strings: %llu bytes\n", (unsigned long long)stats.strings);
+    printf("Code: %llu bytes\n", (unsigned long long)stats.code);
+    printf("Images: %llu bytes\n", (unsigned long long)stats.gfx_images);
+    printf("MIDI: %llu bytes\n", (unsigned long long)stats.midi);
+    printf("Files: %u\n", stats.num_files);
+    printf("Total: %llu bytes\n", (unsigned long long)stats.total);
+}
+
+void dump_counters(ysfx_t *fx)
+{
+    printf("\n" "--- counters ---" "\n\n");
+
+    ysfx_counters_t counters{};
+    ysfx_get_counters(fx, &counters);
+
+    printf("@init: %llu\n", (unsigned long long)counters.init);
+    printf("Transport restarts: %llu\n", (unsigned long long)counters.transport_restarts);
+    printf("@slider: %llu\n", (unsigned long long)counters.slider);
+    printf("Blocks: %llu\n", (unsigned long long)counters.blocks);
+    printf("MIDI in: %llu (peak %u/block, dropped %llu)\n", (unsigned long long)counters.midi_in, counters.midi_in_peak, (unsigned long long)counters.midi_in_dropped);
+    printf("MIDI out: %llu (peak %u/block, dropped %llu)\n", (unsigned long long)counters.midi_out, counters.midi_out_peak, (unsigned long long)counters.midi_out_dropped);
+    printf("Open files: %u (peak %u/%u, failed %llu)\n", counters.open_files, counters.open_files_peak, counters.open_files_limit, (unsigned long long)counters.file_handle_failures);
+}
+
 bool process_jsfx()
 {
     ysfx_config_u config{ysfx_config_new()};
@@ -200,6 +232,16 @@ bool process_jsfx()
     t2 = kro::steady_clock::now();
     printf("Elapsed: %.3f ms\n", 1e3 * kro::duration<double>(t2 - t1).count());
 
+    printf("\n" "--- initialization ---" "\n\n");
+
+    t1 = kro::steady_clock::now();
+    ysfx_init(fx.get());
+    t2 = kro::steady_clock::now();
+    printf("Elapsed: %.3f ms\n", 1e3 * kro::duration<double>(t2 - t1).count());
+
+    dump_memory_usage(fx.get());
+    dump_counters(fx.get());
+
     printf("\n" "--- success ---" "\n");
     return true;
 }